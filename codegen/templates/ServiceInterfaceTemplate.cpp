@@ -32,12 +32,21 @@ void ServiceTemplateInterfaceBase::OnData(uint16_t service_id, uint64_t timestam
                     cog.outl("    spdlog::error(\"Invalid data size\");");
                     cog.outl("    return;");
                     cog.outl("}");
+                    cog.outl("{")
+                    cog.outl("    std::unique_lock lk{last_values_mutex_};")
+                    cog.outl(f"    const auto data = static_cast<const {o['type']}*>(payload);")
+                    cog.outl(f"    Last{o['name']}.emplace(data, data + length/sizeof({o['type']}));")
+                    cog.outl("}")
                     cog.outl(f"{o['callback_name']}(static_cast<const {o['type']}*>(payload), length/sizeof({o['type']}));");
                 else:
                     cog.outl(f"if(length != sizeof({o['type']})) {{");
                     cog.outl("    spdlog::error(\"Invalid data size\");");
                     cog.outl("    return;");
                     cog.outl("}");
+                    cog.outl("{")
+                    cog.outl("    std::unique_lock lk{last_values_mutex_};")
+                    cog.outl(f"    Last{o['name']} = *static_cast<const {o['type']}*>(payload);")
+                    cog.outl("}")
                     cog.outl(f"{o['callback_name']}(*static_cast<const {o['type']}*>(payload));");
                 cog.outl(f"break;");
             ]]]*/
@@ -46,6 +55,11 @@ void ServiceTemplateInterfaceBase::OnData(uint16_t service_id, uint64_t timestam
                 spdlog::error("Invalid data size");
                 return;
             }
+            {
+                std::unique_lock lk{last_values_mutex_};
+                const auto data = static_cast<const char*>(payload);
+                LastExampleOutput1.emplace(data, data + length/sizeof(char));
+            }
             OnExampleOutput1Changed(static_cast<const char*>(payload), length/sizeof(char));
             break;
             case 1:
@@ -53,6 +67,10 @@ void ServiceTemplateInterfaceBase::OnData(uint16_t service_id, uint64_t timestam
                 spdlog::error("Invalid data size");
                 return;
             }
+            {
+                std::unique_lock lk{last_values_mutex_};
+                LastExampleOutput2 = *static_cast<const uint32_t*>(payload);
+            }
             OnExampleOutput2Changed(*static_cast<const uint32_t*>(payload));
             break;
             //[[[end]]]
@@ -64,21 +82,51 @@ void ServiceTemplateInterfaceBase::OnData(uint16_t service_id, uint64_t timestam
 
 /*[[[cog
 # Generate send function implementations.
+# Configuration updates skip registers which did not change.
 for register in service["registers"]:
+    sent = f"Sent{register['name']}"
     if register['is_array']:
         cog.outl(f"bool {service['interface_class_name']}::{register['method_name']}(const {register['type']}* data, uint32_t length) {{")
-        cog.outl(f"    return SendData({register['id']}, data, length*sizeof({register['type']}), true);")
+        cog.outl(f"    if (IsConfigurationUpdate() && {sent} && std::equal(data, data + length, {sent}->begin(), {sent}->end())) {{")
+        cog.outl("        return true;")
+        cog.outl("    }")
+        cog.outl(f"    if (!SendData({register['id']}, data, length*sizeof({register['type']}), true)) {{")
+        cog.outl("        return false;")
+        cog.outl("    }")
+        cog.outl(f"    {sent}.emplace(data, data + length);")
+        cog.outl("    return true;")
         cog.outl("}")
     else:
         cog.outl(f"bool {service['interface_class_name']}::{register['method_name']}(const {register['type']} &data) {{")
-        cog.outl(f"    return SendData({register['id']}, &data, sizeof({register['type']}), true);")
+        cog.outl(f"    if (IsConfigurationUpdate() && {sent} == data) {{")
+        cog.outl("        return true;")
+        cog.outl("    }")
+        cog.outl(f"    if (!SendData({register['id']}, &data, sizeof({register['type']}), true)) {{")
+        cog.outl("        return false;")
+        cog.outl("    }")
+        cog.outl(f"    {sent} = data;")
+        cog.outl("    return true;")
         cog.outl("}")
 ]]]*/
 bool ServiceTemplateInterfaceBase::SetRegisterRegister1(const char* data, uint32_t length) {
-    return SendData(0, data, length*sizeof(char), true);
+    if (IsConfigurationUpdate() && SentRegister1 && std::equal(data, data + length, SentRegister1->begin(), SentRegister1->end())) {
+        return true;
+    }
+    if (!SendData(0, data, length*sizeof(char), true)) {
+        return false;
+    }
+    SentRegister1.emplace(data, data + length);
+    return true;
 }
 bool ServiceTemplateInterfaceBase::SetRegisterRegister2(const uint32_t &data) {
-    return SendData(1, &data, sizeof(uint32_t), true);
+    if (IsConfigurationUpdate() && SentRegister2 == data) {
+        return true;
+    }
+    if (!SendData(1, &data, sizeof(uint32_t), true)) {
+        return false;
+    }
+    SentRegister2 = data;
+    return true;
 }
 //[[[end]]]
 
@@ -103,12 +151,58 @@ bool ServiceTemplateInterfaceBase::SendExampleInput2(const uint32_t &data) {
 //[[[end]]]
 
 /*[[[cog
-cog.outl(f"void {service['interface_class_name']}::OnServiceConnected(uint16_t service_id) {{}};")
+# Generate getters for the last values.
+for output in service["outputs"]:
+    if output['is_array']:
+        cog.outl(f"bool {service['interface_class_name']}::GetLast{output['name']}(std::vector<{output['type']}> &value) const {{")
+    else:
+        cog.outl(f"bool {service['interface_class_name']}::GetLast{output['name']}({output['type']} &value) const {{")
+    cog.outl("    std::unique_lock lk{last_values_mutex_};")
+    cog.outl(f"    if (!Last{output['name']}) {{")
+    cog.outl("        return false;")
+    cog.outl("    }")
+    cog.outl(f"    value = *Last{output['name']};")
+    cog.outl("    return true;")
+    cog.outl("}")
+]]]*/
+bool ServiceTemplateInterfaceBase::GetLastExampleOutput1(std::vector<char> &value) const {
+    std::unique_lock lk{last_values_mutex_};
+    if (!LastExampleOutput1) {
+        return false;
+    }
+    value = *LastExampleOutput1;
+    return true;
+}
+bool ServiceTemplateInterfaceBase::GetLastExampleOutput2(uint32_t &value) const {
+    std::unique_lock lk{last_values_mutex_};
+    if (!LastExampleOutput2) {
+        return false;
+    }
+    value = *LastExampleOutput2;
+    return true;
+}
+//[[[end]]]
+
+/*[[[cog
+# A (re)connected service might not have the registers sent last.
+cog.outl(f"void {service['interface_class_name']}::ClearSentRegisters() {{")
+for register in service["registers"]:
+    cog.outl(f"    Sent{register['name']}.reset();")
+cog.outl("}")
+]]]*/
+void ServiceTemplateInterfaceBase::ClearSentRegisters() {
+    SentRegister1.reset();
+    SentRegister2.reset();
+}
+//[[[end]]]
+
+/*[[[cog
+cog.outl(f"void {service['interface_class_name']}::OnServiceConnected(uint16_t service_id) {{ InvalidateSentRegisters(); }};")
 cog.outl(f"void {service['interface_class_name']}::OnTransactionStart(uint64_t timestamp) {{}};")
 cog.outl(f"void {service['interface_class_name']}::OnTransactionEnd() {{}};")
 cog.outl(f"void {service['interface_class_name']}::OnServiceDisconnected(uint16_t service_id) {{}};")
 ]]]*/
-void ServiceTemplateInterfaceBase::OnServiceConnected(uint16_t service_id) {};
+void ServiceTemplateInterfaceBase::OnServiceConnected(uint16_t service_id) { InvalidateSentRegisters(); };
 void ServiceTemplateInterfaceBase::OnTransactionStart(uint64_t timestamp) {};
 void ServiceTemplateInterfaceBase::OnTransactionEnd() {};
 void ServiceTemplateInterfaceBase::OnServiceDisconnected(uint16_t service_id) {};
@@ -19,6 +19,10 @@ cog.outl(f"#define {service['interface_class_name'].upper()}_HPP")
 #define SERVICETEMPLATEINTERFACEBASE_HPP
 //[[[end]]]
 
+#include <algorithm>
+#include <mutex>
+#include <optional>
+#include <vector>
 #include <xbot-service-interface/ServiceInterfaceBase.hpp>
 #include <xbot-service-interface/XbotServiceInterface.hpp>
 
@@ -65,6 +69,19 @@ public:
     bool SetRegisterRegister2(const uint32_t &data);
     //[[[end]]]
 
+    /*[[[cog
+    # Generate getters for the last value received of each output.
+    # Outputs sent only on change ("on_change") keep their value in between.
+    for output in service["outputs"]:
+        if output['is_array']:
+            cog.outl(f"bool GetLast{output['name']}(std::vector<{output['type']}> &value) const;")
+        else:
+            cog.outl(f"bool GetLast{output['name']}({output['type']} &value) const;")
+    ]]]*/
+    bool GetLastExampleOutput1(std::vector<char> &value) const;
+    bool GetLastExampleOutput2(uint32_t &value) const;
+    //[[[end]]]
+
 protected:
     /*[[[cog
     # Generate callback functions for each service output.
@@ -81,7 +98,34 @@ protected:
 
 
 private:
+    /*[[[cog
+    # Last register values sent to the service, so that configuration updates
+    # only contain changed registers. Only used within a transaction.
+    for register in service["registers"]:
+        if register['is_array']:
+            cog.outl(f"std::optional<std::vector<{register['type']}>> Sent{register['name']}{{}};")
+        else:
+            cog.outl(f"std::optional<{register['type']}> Sent{register['name']}{{}};")
+    ]]]*/
+    std::optional<std::vector<char>> SentRegister1{};
+    std::optional<uint32_t> SentRegister2{};
+    //[[[end]]]
+
+    // Protects the last values, they are read from any thread
+    mutable std::mutex last_values_mutex_{};
+    /*[[[cog
+    for output in service["outputs"]:
+        if output['is_array']:
+            cog.outl(f"std::optional<std::vector<{output['type']}>> Last{output['name']}{{}};")
+        else:
+            cog.outl(f"std::optional<{output['type']}> Last{output['name']}{{}};")
+    ]]]*/
+    std::optional<std::vector<char>> LastExampleOutput1{};
+    std::optional<uint32_t> LastExampleOutput2{};
+    //[[[end]]]
+
 	void OnData(uint16_t service_id, uint64_t timestamp, uint16_t target_id, const void *payload, size_t buflen) final;
+  void ClearSentRegisters() final;
   void OnServiceConnected(uint16_t service_id) override;
   void OnTransactionStart(uint64_t timestamp) override;
   void OnTransactionEnd() override;
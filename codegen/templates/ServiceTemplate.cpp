@@ -6,9 +6,10 @@
 
 /*[[[cog
 import cog
-from xbot_codegen import toCamelCase, loadService
+from xbot_codegen import toCamelCase, loadService, input_dispatch_body, input_dispatch_table, input_size_checks, output_send_body
 
 service = loadService(service_file)
+static_dispatch = globals().get('dispatch', 'virtual') == 'static'
 
 cog.outl(f'#include "{service["class_name"]}.hpp"')
 
@@ -29,68 +30,81 @@ cog.outl(f"constexpr unsigned char {service['class_name']}::SERVICE_DESCRIPTION_
 
 
 /*[[[cog
-cog.outl(f"bool {service['class_name']}::handleData(uint16_t target_id, const void *payload, size_t length) {{")
+# With static dispatch, the CRTP base class in the header handles the inputs.
+if not static_dispatch:
+    class_name = service['class_name']
+    for input in service['inputs']:
+        cog.outl(f"bool {class_name}::dispatch{input['name']}(const void *payload, size_t length) {{")
+        for line in input_dispatch_body(input, ""):
+            cog.outl(f"    {line}")
+        cog.outl("}")
+    cog.outl("")
+    cog.outl(f"bool {class_name}::handleData(uint16_t target_id, const void *payload, size_t length) {{")
+    if len(service['inputs']) == 0:
+        cog.outl("    // Avoid unused parameter warnings.")
+        cog.outl("    (void)target_id;")
+        cog.outl("    (void)payload;")
+        cog.outl("    (void)length;")
+        cog.outl("    return false;")
+    else:
+        for line in input_size_checks(service['inputs']):
+            cog.outl(f"    {line}")
+        cog.outl("    // Indexed by input id, the callback is only called with a valid size.")
+        cog.outl(f"    static constexpr xbot::service::InputHandler<{class_name}> INPUT_HANDLERS[] = {{")
+        for line in input_dispatch_table(service['inputs'], class_name):
+            cog.outl(f"        {line}")
+        cog.outl("    };")
+        cog.outl("    if (target_id >= sizeof(INPUT_HANDLERS) / sizeof(INPUT_HANDLERS[0]) ||")
+        cog.outl("        INPUT_HANDLERS[target_id].handler == nullptr) {")
+        cog.outl("        return false;")
+        cog.outl("    }")
+        cog.outl("    const auto &input = INPUT_HANDLERS[target_id];")
+        cog.outl("    if (!input.isValidLength(length)) {")
+        cog.outl("        ULOG_ARG_ERROR(&service_id_, \"Invalid data size\");")
+        cog.outl("        return false;")
+        cog.outl("    }")
+        cog.outl("    return (this->*input.handler)(payload, length);")
+    cog.outl("}")
 ]]]*/
-bool ServiceTemplateBase::handleData(uint16_t target_id, const void *payload, size_t length) {
-//[[[end]]]
+bool ServiceTemplateBase::dispatchExampleInput1(const void *payload, size_t length) {
+    return OnExampleInput1Changed(static_cast<const char*>(payload), length/sizeof(char));
+}
+bool ServiceTemplateBase::dispatchExampleInput2(const void *payload, size_t length) {
+    (void)length;
+    return OnExampleInput2Changed(*static_cast<const uint32_t*>(payload));
+}
 
-        /*[[[cog
-        if len(service['inputs']) == 0:
-            cog.outl("// Avoid unused parameter warnings.")
-            cog.outl("(void)payload;")
-            cog.outl("(void)length;")
-        ]]]*/
-        //[[[end]]]
-
-        // Call the callback for this input
-        switch (target_id) {
-            /*[[[cog
-            for i in service['inputs']:
-                cog.outl(f"case {i['id']}:");
-                if i['is_array']:
-                    cog.outl(f"if(length % sizeof({i['type']}) != 0) {{");
-                    cog.outl("    ULOG_ARG_ERROR(&service_id_, \"Invalid data size\");");
-                    cog.outl("    return false;");
-                    cog.outl("}");
-                    cog.outl(f"return {i['callback_name']}(static_cast<const {i['type']}*>(payload), length/sizeof({i['type']}));");
-                else:
-                    if i['custom_decoder_code']:
-                        cog.outl(i['custom_decoder_code'])
-                    else:
-                        cog.outl(f"if(length != sizeof({i['type']})) {{");
-                        cog.outl("    ULOG_ARG_ERROR(&service_id_, \"Invalid data size\");");
-                        cog.outl("    return false;");
-                        cog.outl("}");
-                        cog.outl(f"return {i['callback_name']}(*static_cast<const {i['type']}*>(payload));");
-            ]]]*/
-            case 0:
-            if(length % sizeof(char) != 0) {
-                ULOG_ARG_ERROR(&service_id_, "Invalid data size");
-                return false;
-            }
-            return OnExampleInput1Changed(static_cast<const char*>(payload), length/sizeof(char));
-            case 1:
-            if(length != sizeof(uint32_t)) {
-                ULOG_ARG_ERROR(&service_id_, "Invalid data size");
-                return false;
-            }
-            return OnExampleInput2Changed(*static_cast<const uint32_t*>(payload));
-            //[[[end]]]
-            default:
-                return false;
-        }
+bool ServiceTemplateBase::handleData(uint16_t target_id, const void *payload, size_t length) {
+    static_assert(xbot::service::inputFitsPacket(sizeof(char) * 100), "Input ExampleInput1 does not fit into a packet");
+    static_assert(xbot::service::inputFitsPacket(sizeof(uint32_t)), "Input ExampleInput2 does not fit into a packet");
+    // Indexed by input id, the callback is only called with a valid size.
+    static constexpr xbot::service::InputHandler<ServiceTemplateBase> INPUT_HANDLERS[] = {
+        {&ServiceTemplateBase::dispatchExampleInput1, sizeof(char), true},
+        {&ServiceTemplateBase::dispatchExampleInput2, sizeof(uint32_t), false},
+    };
+    if (target_id >= sizeof(INPUT_HANDLERS) / sizeof(INPUT_HANDLERS[0]) ||
+        INPUT_HANDLERS[target_id].handler == nullptr) {
         return false;
+    }
+    const auto &input = INPUT_HANDLERS[target_id];
+    if (!input.isValidLength(length)) {
+        ULOG_ARG_ERROR(&service_id_, "Invalid data size");
+        return false;
+    }
+    return (this->*input.handler)(payload, length);
 }
+//[[[end]]]
+
 /*[[[cog
 cog.outl(f"bool {service['class_name']}::advertiseService() {{")
 ]]]*/
 bool ServiceTemplateBase::advertiseService() {
 //[[[end]]]
-    static_assert(sizeof(scratch_buffer)>80+sizeof(SERVICE_DESCRIPTION_CBOR), "scratch_buffer too small for service description. increase size");
+    static_assert(sizeof(scratch_buffer)>80, "scratch_buffer too small for service advertisement. increase size");
 
     size_t index = 0;
     // Build CBOR payload
-    // 0xA4 = object with 3 entries
+    // 0xA3 = object with 3 entries
     scratch_buffer[index++] = 0xA3;
     // Key1
     // 0x62 = text(3)
@@ -150,16 +164,20 @@ bool ServiceTemplateBase::advertiseService() {
     scratch_buffer[index++] = (port>>8) & 0xFF;
     scratch_buffer[index++] = port & 0xFF;
 
-    // Key3
+    // Key3, only the hash of the description. Interfaces which don't know it
+    // yet, query the full description.
     // 0x64 = text(4)
     scratch_buffer[index++] = 0x64;
-    scratch_buffer[index++] = 'd';
-    scratch_buffer[index++] = 'e';
+    scratch_buffer[index++] = 'h';
+    scratch_buffer[index++] = 'a';
     scratch_buffer[index++] = 's';
-    scratch_buffer[index++] = 'c';
-
-    memcpy(scratch_buffer+index, SERVICE_DESCRIPTION_CBOR, sizeof(SERVICE_DESCRIPTION_CBOR));
-    index+=sizeof(SERVICE_DESCRIPTION_CBOR);
+    scratch_buffer[index++] = 'h';
+    // 0x1A == 32 bit unsigned, positive
+    scratch_buffer[index++] = 0x1A;
+    scratch_buffer[index++] = (SERVICE_DESCRIPTION_HASH>>24) & 0xFF;
+    scratch_buffer[index++] = (SERVICE_DESCRIPTION_HASH>>16) & 0xFF;
+    scratch_buffer[index++] = (SERVICE_DESCRIPTION_HASH>>8) & 0xFF;
+    scratch_buffer[index++] = SERVICE_DESCRIPTION_HASH & 0xFF;
 
 
     xbot::datatypes::XbotHeader header{};
@@ -174,7 +192,7 @@ bool ServiceTemplateBase::advertiseService() {
     header.arg1 = 0;
     header.arg2 = 0;
     header.sequence_no = sd_sequence_++;
-    header.timestamp = xbot::service::system::getTimeMicros();
+    header.timestamp = GetTimestamp();
 
     // Reset reboot on rollover
     if(sd_sequence_==0) {
@@ -187,28 +205,112 @@ bool ServiceTemplateBase::advertiseService() {
     return xbot::service::Io::transmitPacket(ptr, xbot::config::sd_multicast_address, xbot::config::multicast_port);
 }
 
+/*[[[cog
+cog.outl(f"bool {service['class_name']}::sendServiceDescription() {{")
+]]]*/
+bool ServiceTemplateBase::sendServiceDescription() {
+//[[[end]]]
+    static_assert(sizeof(xbot::datatypes::XbotHeader)+sizeof(SERVICE_DESCRIPTION_CBOR) <= xbot::config::max_packet_size, "service description does not fit into a single packet");
+
+    xbot::datatypes::XbotHeader header{};
+    header.message_type = xbot::datatypes::MessageType::SERVICE_QUERY;
+    header.payload_size = sizeof(SERVICE_DESCRIPTION_CBOR);
+    header.protocol_version = 1;
+    header.service_id = service_id_;
+    // 1 = response
+    header.arg1 = 1;
+    header.timestamp = GetTimestamp();
+
+    // Multicast, so that all interfaces which don't know the hash yet can pick it up.
+    xbot::service::packet::PacketPtr ptr = xbot::service::packet::allocatePacket();
+    xbot::service::packet::packetAppendData(ptr, &header, sizeof(header));
+    xbot::service::packet::packetAppendData(ptr, SERVICE_DESCRIPTION_CBOR, sizeof(SERVICE_DESCRIPTION_CBOR));
+    return xbot::service::Io::transmitPacket(ptr, xbot::config::sd_multicast_address, xbot::config::multicast_port);
+}
+
 /*[[[cog
 # Generate send function implementations.
 for output in service["outputs"]:
     if output['is_array']:
         cog.outl(f"bool {service['class_name']}::{output['method_name']}(const {output['type']}* data, uint32_t length) {{")
-        cog.outl(f"    return SendData({output['id']}, data, length*sizeof({output['type']}));")
-        cog.outl("}")
     else:
-        if output['custom_encoder_code']:
-            cog.outl(f"bool {service['class_name']}::{output['method_name']}(const {output['type']} &data) {{")
-            cog.outl(output['custom_encoder_code'])
-            cog.outl("}")
-        else:
-            cog.outl(f"bool {service['class_name']}::{output['method_name']}(const {output['type']} &data) {{")
-            cog.outl(f"    return SendData({output['id']}, &data, sizeof({output['type']}));")
-            cog.outl("}")
+        cog.outl(f"bool {service['class_name']}::{output['method_name']}(const {output['type']} &data) {{")
+    for line in output_send_body(output):
+        cog.outl(f"    {line}")
+    cog.outl("}")
 ]]]*/
 bool ServiceTemplateBase::SendExampleOutput1(const char* data, uint32_t length) {
+    xbot::service::Lock lk(&state_mutex_);
+    const uint32_t now_micros = xbot::service::system::getTimeMicros();
+    if (!ExampleOutput1Filter.accept(now_micros)) {
+        // Dropped by the output policy
+        return true;
+    }
     return SendData(0, data, length*sizeof(char));
 }
 bool ServiceTemplateBase::SendExampleOutput2(const uint32_t &data) {
-    return SendData(1, &data, sizeof(uint32_t));
+    uint32_t value = data;
+    xbot::service::Lock lk(&state_mutex_);
+    const uint32_t now_micros = xbot::service::system::getTimeMicros();
+    if (!ExampleOutput2Filter.filter(&value, now_micros)) {
+        // Dropped or aggregated by the output policy
+        return true;
+    }
+    if (!ExampleOutput2LastSent.needsSend(&value, sizeof(uint32_t), now_micros, xbot::config::default_keyframe_interval_micros)) {
+        // Unchanged and no keyframe due
+        return true;
+    }
+    if (!SendData(1, &value, sizeof(uint32_t))) {
+        return false;
+    }
+    ExampleOutput2LastSent.markSent(&value, sizeof(uint32_t), now_micros);
+    return true;
+}
+//[[[end]]]
+
+/*[[[cog
+cog.outl(f"void {service['class_name']}::clearOutputPolicies() {{")
+for output in service["outputs"]:
+    cog.outl(f"    {output['name']}Filter.reset();")
+cog.outl("}")
+cog.outl("")
+cog.outl(f"bool {service['class_name']}::setOutputPolicy(const xbot::datatypes::OutputPolicy &policy) {{")
+cog.outl("    switch (policy.output_id) {")
+for output in service["outputs"]:
+    cog.outl(f"        case {output['id']}:")
+    cog.outl(f"            {output['name']}Filter.setPolicy(policy.mode, policy.param);")
+    cog.outl("            return true;")
+cog.outl("        default:")
+cog.outl("            return false;")
+cog.outl("    }")
+cog.outl("}")
+cog.outl("")
+cog.outl(f"void {service['class_name']}::invalidateSentOutputs() {{")
+for output in service["outputs"]:
+    if output['on_change']:
+        cog.outl(f"    {output['name']}LastSent.invalidate();")
+cog.outl("}")
+]]]*/
+void ServiceTemplateBase::clearOutputPolicies() {
+    ExampleOutput1Filter.reset();
+    ExampleOutput2Filter.reset();
+}
+
+bool ServiceTemplateBase::setOutputPolicy(const xbot::datatypes::OutputPolicy &policy) {
+    switch (policy.output_id) {
+        case 0:
+            ExampleOutput1Filter.setPolicy(policy.mode, policy.param);
+            return true;
+        case 1:
+            ExampleOutput2Filter.setPolicy(policy.mode, policy.param);
+            return true;
+        default:
+            return false;
+    }
+}
+
+void ServiceTemplateBase::invalidateSentOutputs() {
+    ExampleOutput2LastSent.invalidate();
 }
 //[[[end]]]
 
@@ -302,6 +404,100 @@ bool ServiceTemplateBase::setRegister(uint16_t target_id, const void *payload, s
   return false;
 }
 
+/*[[[cog
+# Generate the double buffered register updates
+cog.outl(f"bool {service['class_name']}::stageRegister(uint16_t target_id, const void *payload, size_t length) {{")
+if len(service['registers']) == 0:
+    cog.outl("    // Avoid unused parameter warnings.")
+    cog.outl("    (void)payload;")
+    cog.outl("    (void)length;")
+cog.outl("    switch (target_id) {")
+for r in service['registers']:
+    cog.outl(f"        case {r['id']}:")
+    if r['is_array']:
+        cog.outl(f"            if(length % sizeof({r['type']}) != 0 || length > sizeof({r['name']}.staged_value)) {{")
+    else:
+        cog.outl(f"            if(length != sizeof({r['name']}.staged_value)) {{")
+    cog.outl("                ULOG_ARG_ERROR(&service_id_, \"Invalid data size\");")
+    cog.outl("                return false;")
+    cog.outl("            }")
+    if r['is_array']:
+        cog.outl(f"            {r['name']}.staged_length = length/sizeof({r['type']});")
+    cog.outl(f"            memcpy(&{r['name']}.staged_value, payload, length);")
+    cog.outl(f"            {r['name']}.staged = true;")
+    cog.outl("            return true;")
+cog.outl("        default:")
+cog.outl("            return false;")
+cog.outl("    }")
+cog.outl("}")
+cog.outl("")
+cog.outl(f"bool {service['class_name']}::commitStagedRegisters() {{")
+cog.outl("    bool applied = true;")
+for r in service['registers']:
+    cog.outl(f"    if ({r['name']}.staged) {{")
+    cog.outl(f"        {r['name']}.staged = false;")
+    if r['is_array']:
+        cog.outl(f"        {r['name']}.length = {r['name']}.staged_length;")
+        cog.outl(f"        memcpy(&{r['name']}.value, &{r['name']}.staged_value, sizeof({r['name']}.value));")
+        cog.outl(f"        applied &= OnRegister{r['name']}Changed({r['name']}.value, {r['name']}.length);")
+    else:
+        cog.outl(f"        {r['name']}.value = {r['name']}.staged_value;")
+        cog.outl(f"        applied &= OnRegister{r['name']}Changed({r['name']}.value);")
+    cog.outl("    }")
+cog.outl("    return applied;")
+cog.outl("}")
+cog.outl("")
+cog.outl(f"void {service['class_name']}::discardStagedRegisters() {{")
+for r in service['registers']:
+    cog.outl(f"    {r['name']}.staged = false;")
+cog.outl("}")
+]]]*/
+bool ServiceTemplateBase::stageRegister(uint16_t target_id, const void *payload, size_t length) {
+    switch (target_id) {
+        case 0:
+            if(length % sizeof(char) != 0 || length > sizeof(Register1.staged_value)) {
+                ULOG_ARG_ERROR(&service_id_, "Invalid data size");
+                return false;
+            }
+            Register1.staged_length = length/sizeof(char);
+            memcpy(&Register1.staged_value, payload, length);
+            Register1.staged = true;
+            return true;
+        case 1:
+            if(length != sizeof(Register2.staged_value)) {
+                ULOG_ARG_ERROR(&service_id_, "Invalid data size");
+                return false;
+            }
+            memcpy(&Register2.staged_value, payload, length);
+            Register2.staged = true;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool ServiceTemplateBase::commitStagedRegisters() {
+    bool applied = true;
+    if (Register1.staged) {
+        Register1.staged = false;
+        Register1.length = Register1.staged_length;
+        memcpy(&Register1.value, &Register1.staged_value, sizeof(Register1.value));
+        applied &= OnRegisterRegister1Changed(Register1.value, Register1.length);
+    }
+    if (Register2.staged) {
+        Register2.staged = false;
+        Register2.value = Register2.staged_value;
+        applied &= OnRegisterRegister2Changed(Register2.value);
+    }
+    return applied;
+}
+
+void ServiceTemplateBase::discardStagedRegisters() {
+    Register1.staged = false;
+    Register2.staged = false;
+}
+//[[[end]]]
+
 /*[[[cog
 cog.outl(f"constexpr unsigned char {service['class_name']}::SERVICE_NAME[];")
 cog.outl(f"const char* {service['class_name']}::GetName() {{")
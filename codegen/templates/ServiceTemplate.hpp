@@ -9,6 +9,9 @@ import cog
 import xbot_codegen
 
 service = xbot_codegen.loadService(service_file)
+# "static" generates an additional CRTP base class, which calls the input
+# callbacks without virtual dispatch.
+static_dispatch = globals().get('dispatch', 'virtual') == 'static'
 
 #Generate include guard
 cog.outl(f"#ifndef {service['class_name'].upper()}_HPP")
@@ -19,7 +22,12 @@ cog.outl(f"#define {service['class_name'].upper()}_HPP")
 #define SERVICETEMPLATEBASE_HPP
 //[[[end]]]
 
+#include <ulog.h>
+#include <xbot-service/ChangeDetector.hpp>
+#include <xbot-service/InputHandler.hpp>
+#include <xbot-service/OutputFilter.hpp>
 #include <xbot-service/Service.hpp>
+#include <xbot/datatypes/ServiceDescriptionHash.hpp>
 
 /*[[[cog
 for include in service['additional_includes']:
@@ -91,7 +99,8 @@ public:
         {
           "id": 1,
           "name": "ExampleOutput2",
-          "type": "uint32_t"
+          "type": "uint32_t",
+          "on_change": true
         }
       ],
       "registers": [
@@ -129,40 +138,79 @@ public:
       0x45, 0x78, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x4F, 
       0x75, 0x74, 0x70, 0x75, 0x74, 0x31, 0x64, 0x74, 
       0x79, 0x70, 0x65, 0x69, 0x63, 0x68, 0x61, 0x72, 
-      0x5B, 0x31, 0x30, 0x30, 0x5D, 0xA3, 0x62, 0x69, 
+      0x5B, 0x31, 0x30, 0x30, 0x5D, 0xA4, 0x62, 0x69, 
       0x64, 0x01, 0x64, 0x6E, 0x61, 0x6D, 0x65, 0x6E, 
       0x45, 0x78, 0x61, 0x6D, 0x70, 0x6C, 0x65, 0x4F, 
       0x75, 0x74, 0x70, 0x75, 0x74, 0x32, 0x64, 0x74, 
       0x79, 0x70, 0x65, 0x68, 0x75, 0x69, 0x6E, 0x74, 
-      0x33, 0x32, 0x5F, 0x74, 0x69, 0x72, 0x65, 0x67, 
-      0x69, 0x73, 0x74, 0x65, 0x72, 0x73, 0x82, 0xA3, 
-      0x62, 0x69, 0x64, 0x00, 0x64, 0x6E, 0x61, 0x6D, 
-      0x65, 0x69, 0x52, 0x65, 0x67, 0x69, 0x73, 0x74, 
-      0x65, 0x72, 0x31, 0x64, 0x74, 0x79, 0x70, 0x65, 
-      0x68, 0x63, 0x68, 0x61, 0x72, 0x5B, 0x34, 0x32, 
-      0x5D, 0xA3, 0x62, 0x69, 0x64, 0x01, 0x64, 0x6E, 
-      0x61, 0x6D, 0x65, 0x69, 0x52, 0x65, 0x67, 0x69, 
-      0x73, 0x74, 0x65, 0x72, 0x32, 0x64, 0x74, 0x79, 
-      0x70, 0x65, 0x68, 0x75, 0x69, 0x6E, 0x74, 0x33, 
-      0x32, 0x5F, 0x74
+      0x33, 0x32, 0x5F, 0x74, 0x69, 0x6F, 0x6E, 0x5F, 
+      0x63, 0x68, 0x61, 0x6E, 0x67, 0x65, 0xF5, 0x69, 
+      0x72, 0x65, 0x67, 0x69, 0x73, 0x74, 0x65, 0x72, 
+      0x73, 0x82, 0xA3, 0x62, 0x69, 0x64, 0x00, 0x64, 
+      0x6E, 0x61, 0x6D, 0x65, 0x69, 0x52, 0x65, 0x67, 
+      0x69, 0x73, 0x74, 0x65, 0x72, 0x31, 0x64, 0x74, 
+      0x79, 0x70, 0x65, 0x68, 0x63, 0x68, 0x61, 0x72, 
+      0x5B, 0x34, 0x32, 0x5D, 0xA3, 0x62, 0x69, 0x64, 
+      0x01, 0x64, 0x6E, 0x61, 0x6D, 0x65, 0x69, 0x52, 
+      0x65, 0x67, 0x69, 0x73, 0x74, 0x65, 0x72, 0x32, 
+      0x64, 0x74, 0x79, 0x70, 0x65, 0x68, 0x75, 0x69, 
+      0x6E, 0x74, 0x33, 0x32, 0x5F, 0x74
     };
     //[[[end]]]
+    static constexpr uint32_t SERVICE_DESCRIPTION_HASH =
+        xbot::datatypes::ServiceDescriptionHash(SERVICE_DESCRIPTION_CBOR, sizeof(SERVICE_DESCRIPTION_CBOR));
 
 
 private:
     uint32_t sd_sequence_ = 0;
     bool reboot = true;
+    /*[[[cog
+    if not static_dispatch:
+        cog.outl("bool handleData(uint16_t target_id, const void *payload, size_t length) override final;")
+        for input in service["inputs"]:
+            cog.outl(f"bool dispatch{input['name']}(const void *payload, size_t length);")
+    ]]]*/
     bool handleData(uint16_t target_id, const void *payload, size_t length) override final;
+    bool dispatchExampleInput1(const void *payload, size_t length);
+    bool dispatchExampleInput2(const void *payload, size_t length);
+    //[[[end]]]
     bool advertiseService() override final;
+    bool sendServiceDescription() override final;
     bool isConfigured() override final;
     void clearConfiguration() override final;
     bool setRegister(uint16_t target_id, const void *payload,
                           size_t length)override final;
+    bool stageRegister(uint16_t target_id, const void *payload, size_t length) override final;
+    bool commitStagedRegisters() override final;
+    void discardStagedRegisters() override final;
+    void clearOutputPolicies() override final;
+    bool setOutputPolicy(const xbot::datatypes::OutputPolicy &policy) override final;
+    void invalidateSentOutputs() override final;
+
+    /*[[[cog
+    # Publish policy of each output, protected by the state_mutex_
+    for output in service["outputs"]:
+        cog.outl(f"xbot::service::OutputFilter {output['name']}Filter{{}};")
+    ]]]*/
+    xbot::service::OutputFilter ExampleOutput1Filter{};
+    xbot::service::OutputFilter ExampleOutput2Filter{};
+    //[[[end]]]
+
+    /*[[[cog
+    # Last value sent of outputs which are only sent on change, protected by the state_mutex_
+    for output in service["outputs"]:
+        if output['on_change']:
+            size = f"sizeof({output['type']}) * {output['max_length']}" if output['is_array'] else f"sizeof({output['type']})"
+            cog.outl(f"xbot::service::ChangeDetector<{size}> {output['name']}LastSent{{}};")
+    ]]]*/
+    xbot::service::ChangeDetector<sizeof(uint32_t)> ExampleOutput2LastSent{};
+    //[[[end]]]
 
 protected:
     /*[[[cog
     # Generate callback functions for each input.
-    for input in service["inputs"]:
+    # With static dispatch, the derived class implements them without virtual.
+    for input in service["inputs"] if not static_dispatch else []:
         if input['is_array']:
             cog.outl(f"virtual bool {input['callback_name']}(const {input['type']}* new_value, uint32_t length) = 0;")
         else:
@@ -172,6 +220,20 @@ protected:
     virtual bool OnExampleInput2Changed(const uint32_t &new_value) = 0;
     //[[[end]]]
 
+    /*[[[cog
+    # Generate hooks for register changes while the service is running.
+    # Returning false (the default) restarts the service with the new
+    # configuration instead.
+    for register in service["registers"]:
+        if register['is_array']:
+            cog.outl(f"virtual bool OnRegister{register['name']}Changed(const {register['type']}*, uint32_t) {{ return false; }}")
+        else:
+            cog.outl(f"virtual bool OnRegister{register['name']}Changed(const {register['type']} &) {{ return false; }}")
+    ]]]*/
+    virtual bool OnRegisterRegister1Changed(const char*, uint32_t) { return false; }
+    virtual bool OnRegisterRegister2Changed(const uint32_t &) { return false; }
+    //[[[end]]]
+
     /*[[[cog
     # Generate send functions for each output.
     for output in service["outputs"]:
@@ -195,20 +257,72 @@ protected:
       else:
           cog.outl(f"{register['type']} value;")
       cog.outl("bool valid = false;")
+      # Second buffer for configuration updates, applied between two ticks
+      if register['is_array']:
+          cog.outl(f"{register['type']} staged_value[{register ['max_length']}];")
+          cog.outl("size_t staged_length = 0;")
+      else:
+          cog.outl(f"{register['type']} staged_value;")
+      cog.outl("bool staged = false;")
       cog.outl(f"}} {register['name']};");
     ]]]*/
     struct {
     char value[42];
     size_t length = 0;
     bool valid = false;
+    char staged_value[42];
+    size_t staged_length = 0;
+    bool staged = false;
     } Register1;
     struct {
     uint32_t value;
     bool valid = false;
+    uint32_t staged_value;
+    bool staged = false;
     } Register2;
     //[[[end]]]
 };
 
+/*[[[cog
+if static_dispatch:
+    base = service['class_name']
+    static_base = service['class_name'].removesuffix("Base") + "StaticBase"
+    cog.outl("\u002f**")
+    cog.outl(f" * Inherit as class MyService : public {static_base}<MyService> to call the")
+    cog.outl(" * input callbacks without virtual dispatch, so that they can be inlined.")
+    cog.outl(f" * The callbacks need to be public or {static_base}<MyService> needs to be a friend.")
+    cog.outl(" *\u002f")
+    cog.outl("template <typename Derived>")
+    cog.outl(f"class {static_base} : public {base} {{")
+    cog.outl("public:")
+    cog.outl(f"    using {base}::{base};")
+    cog.outl("")
+    cog.outl("private:")
+    for input in service["inputs"]:
+        cog.outl(f"    bool dispatch{input['name']}(const void *payload, size_t length) {{")
+        for line in xbot_codegen.input_dispatch_body(input, "static_cast<Derived*>(this)->"):
+            cog.outl(f"        {line}")
+        cog.outl("    }")
+    cog.outl("")
+    cog.outl("    bool handleData(uint16_t target_id, const void *payload, size_t length) override final {")
+    if len(service['inputs']) == 0:
+        cog.outl("        // Avoid unused parameter warnings.")
+        cog.outl("        (void)target_id;")
+        cog.outl("        (void)payload;")
+        cog.outl("        (void)length;")
+        cog.outl("        return false;")
+    else:
+        for line in xbot_codegen.input_size_checks(service['inputs']):
+            cog.outl(f"        {line}")
+        cog.outl("        // The input ids are constant, so no table of member function pointers is needed.")
+        for line in xbot_codegen.input_dispatch_switch(service['inputs']):
+            cog.outl(f"        {line}")
+        cog.outl("        ULOG_ARG_ERROR(&this->service_id_, \"Invalid data size\");")
+        cog.outl("        return false;")
+    cog.outl("    }")
+    cog.outl("};")
+]]]*/
+//[[[end]]]
 
 
 #endif
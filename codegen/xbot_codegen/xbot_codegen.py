@@ -35,6 +35,101 @@ def binary2c_array(data):
 def toCamelCase(name):
     return ''.join(x for x in name if not x.isspace())
 
+# Generate the body of an input's dispatch method, which converts the
+# (already validated) payload and calls the callback on the receiver.
+def input_dispatch_body(input, receiver):
+    if input['is_array']:
+        return [f"return {receiver}{input['callback_name']}(static_cast<const {input['type']}*>(payload), length/sizeof({input['type']}));"]
+    if input['custom_decoder_code']:
+        return [input['custom_decoder_code']]
+    # The length was already checked against the type's size.
+    return ["(void)length;",
+            f"return {receiver}{input['callback_name']}(*static_cast<const {input['type']}*>(payload));"]
+
+
+# Generate the body of an output's send method. The output policy and the
+# change detection are applied before the data is serialized.
+def output_send_body(output):
+    custom_encoder_code = output.get('custom_encoder_code')
+    aggregate = not output['is_array'] and not custom_encoder_code
+    lines = []
+    if aggregate:
+        lines.append(f"{output['type']} value = data;")
+    lines.append("xbot::service::Lock lk(&state_mutex_);")
+    lines.append("const uint32_t now_micros = xbot::service::system::getTimeMicros();")
+    if aggregate:
+        lines.append(f"if (!{output['name']}Filter.filter(&value, now_micros)) {{")
+        lines.append("    // Dropped or aggregated by the output policy")
+    else:
+        lines.append(f"if (!{output['name']}Filter.accept(now_micros)) {{")
+        lines.append("    // Dropped by the output policy")
+    lines.append("    return true;")
+    lines.append("}")
+    if custom_encoder_code:
+        lines.append(custom_encoder_code)
+        return lines
+
+    data = "data" if output['is_array'] else "&value"
+    size = f"length*sizeof({output['type']})" if output['is_array'] else f"sizeof({output['type']})"
+    send_args = f"{output['id']}, {data}, {size}, true" if output['reliable'] else f"{output['id']}, {data}, {size}"
+    if not output['on_change']:
+        lines.append(f"return SendData({send_args});")
+        return lines
+    keyframe = output['keyframe_interval_micros']
+    if keyframe is None:
+        keyframe = "xbot::config::default_keyframe_interval_micros"
+    lines.append(f"if (!{output['name']}LastSent.needsSend({data}, {size}, now_micros, {keyframe})) {{")
+    lines.append("    // Unchanged and no keyframe due")
+    lines.append("    return true;")
+    lines.append("}")
+    lines.append(f"if (!SendData({send_args})) {{")
+    lines.append("    return false;")
+    lines.append("}")
+    lines.append(f"{output['name']}LastSent.markSent({data}, {size}, now_micros);")
+    lines.append("return true;")
+    return lines
+
+
+# Generate the entries of the input dispatch table, indexed by input id.
+def input_dispatch_table(inputs, class_name):
+    by_id = {i['id']: i for i in inputs}
+    lines = []
+    for id in range(max(by_id.keys()) + 1 if by_id else 0):
+        if id in by_id:
+            i = by_id[id]
+            is_array = "true" if i['is_array'] else "false"
+            lines.append(f"{{&{class_name}::dispatch{i['name']}, sizeof({i['type']}), {is_array}}},")
+        else:
+            lines.append("{nullptr, 0, false},")
+    return lines
+
+
+# Generate a switch over the input ids, which calls the dispatch methods
+# directly, so that the compiler can inline them (used for static dispatch).
+def input_dispatch_switch(inputs):
+    lines = ["switch (target_id) {"]
+    for i in sorted(inputs, key=lambda i: i['id']):
+        is_array = "true" if i['is_array'] else "false"
+        lines.append(f"    case {i['id']}:")
+        lines.append(f"        if (!xbot::service::isValidInputLength(length, sizeof({i['type']}), {is_array})) {{")
+        lines.append("            break;")
+        lines.append("        }")
+        lines.append(f"        return dispatch{i['name']}(payload, length);")
+    lines.append("    default:")
+    lines.append("        return false;")
+    lines.append("}")
+    return lines
+
+
+# Generate compile time checks for the input sizes.
+def input_size_checks(inputs):
+    lines = []
+    for i in inputs:
+        size = f"sizeof({i['type']}) * {i['max_length']}" if i['is_array'] else f"sizeof({i['type']})"
+        lines.append(f"static_assert(xbot::service::inputFitsPacket({size}), \"Input {i['name']} does not fit into a packet\");")
+    return lines
+
+
 def check_unique_ids(l):
     id_set = set()
     for dict in l:
@@ -116,6 +211,15 @@ def loadService(path: str) -> dict:
         method_name = f"Send{output_name}"
         callback_name = f"On{output_name}Changed"
         custom_encoder_code = None
+        # Only send the output, if its value changed or the keyframe is due
+        on_change = bool(json_output.get("on_change", False))
+        keyframe_interval_micros = json_output.get("keyframe_interval_micros")
+        if keyframe_interval_micros is not None:
+            keyframe_interval_micros = int(keyframe_interval_micros)
+            if not on_change or keyframe_interval_micros < 0 or keyframe_interval_micros >= 2 ** 31:
+                raise Exception(f"Illegal keyframe interval for {output_name}!")
+        # Retransmit the output until the interface acknowledges it
+        reliable = bool(json_output.get("reliable", False))
         # Handle array types (type[length])
         if "[" in json_output["type"] and "]" in json_output["type"]:
             # Split the type definition at the [, validate and get max length
@@ -131,7 +235,10 @@ def loadService(path: str) -> dict:
                 "is_array": True,
                 "max_length": max_length,
                 "method_name": method_name,
-                "callback_name": callback_name
+                "callback_name": callback_name,
+                "on_change": on_change,
+                "keyframe_interval_micros": keyframe_interval_micros,
+                "reliable": reliable
             }
         else:
             # Not an array type
@@ -145,7 +252,10 @@ def loadService(path: str) -> dict:
                 "is_array": False,
                 "method_name": method_name,
                 "custom_encoder_code": custom_encoder_code,
-                "callback_name": callback_name
+                "callback_name": callback_name,
+                "on_change": on_change,
+                "keyframe_interval_micros": keyframe_interval_micros,
+                "reliable": reliable
             }
 
         outputs.append(output)
@@ -20,6 +20,15 @@ bool EchoService::OnInputTextChanged(const char *new_value, uint32_t length) {
   SendMessageCount(echo_count++);
   return true;
 }
+bool EchoService::OnRegisterPrefixChanged(const char *new_value,
+                                          uint32_t length) {
+  std::cout << "New prefix: " << std::string{new_value, length} << std::endl;
+  return true;
+}
+bool EchoService::OnRegisterEchoCountChanged(const uint32_t &new_value) {
+  std::cout << "New echo count: " << new_value << std::endl;
+  return true;
+}
 bool EchoService::Configure() {
   // Nothing to do on configure hook
   std::cout << "Service Configured" << std::endl;
@@ -19,6 +19,9 @@ class EchoService : public EchoServiceBase {
 
  protected:
   bool OnInputTextChanged(const char *new_value, uint32_t length) override;
+  // The registers are read on every message, so they can change at runtime
+  bool OnRegisterPrefixChanged(const char *new_value, uint32_t length) override;
+  bool OnRegisterEchoCountChanged(const uint32_t &new_value) override;
 
   bool Configure() override;
   void OnStart() override;
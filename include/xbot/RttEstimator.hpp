@@ -0,0 +1,63 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef RTTESTIMATOR_HPP
+#define RTTESTIMATOR_HPP
+
+#include <cstdint>
+#include <xbot/config.hpp>
+
+namespace xbot {
+/**
+ * Estimates the retransmit timeout of reliable packets from measured round
+ * trips (RFC 6298). Only round trips of packets which were not retransmitted
+ * may be added, otherwise it is unknown which transmission was acknowledged.
+ */
+class RttEstimator {
+ public:
+  void addSample(uint32_t rtt_micros) {
+    if (!valid_) {
+      valid_ = true;
+      srtt_micros_ = rtt_micros;
+      rttvar_micros_ = rtt_micros / 2;
+      return;
+    }
+    const uint32_t error = srtt_micros_ > rtt_micros ? srtt_micros_ - rtt_micros : rtt_micros - srtt_micros_;
+    rttvar_micros_ = static_cast<uint32_t>((3ULL * rttvar_micros_ + error) / 4);
+    srtt_micros_ = static_cast<uint32_t>((7ULL * srtt_micros_ + rtt_micros) / 8);
+  }
+
+  /**
+   * @param retransmits number of times the packet was retransmitted already,
+   * the timeout doubles with each one.
+   * @return time to wait for an ACK
+   */
+  uint32_t getTimeoutMicros(uint32_t retransmits = 0) const {
+    uint64_t timeout = config::reliable_initial_timeout_micros;
+    if (valid_) {
+      timeout = static_cast<uint64_t>(srtt_micros_) + 4ULL * rttvar_micros_;
+    }
+    if (timeout < config::reliable_min_timeout_micros) {
+      timeout = config::reliable_min_timeout_micros;
+    }
+    for (uint32_t i = 0; i < retransmits && timeout < config::reliable_max_timeout_micros; i++) {
+      timeout *= 2;
+    }
+    return timeout > config::reliable_max_timeout_micros ? config::reliable_max_timeout_micros
+                                                         : static_cast<uint32_t>(timeout);
+  }
+
+  // Smoothed round trip, 0 until the first sample
+  uint32_t getRttMicros() const { return srtt_micros_; }
+
+  void reset() { *this = RttEstimator{}; }
+
+ private:
+  bool valid_ = false;
+  uint32_t srtt_micros_ = 0;
+  uint32_t rttvar_micros_ = 0;
+};
+}  // namespace xbot
+
+#endif  // RTTESTIMATOR_HPP
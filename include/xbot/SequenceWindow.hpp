@@ -0,0 +1,87 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef SEQUENCEWINDOW_HPP
+#define SEQUENCEWINDOW_HPP
+
+#include <cstdint>
+
+namespace xbot {
+/**
+ * Remembers which of the last 64 sequence numbers were received from a peer,
+ * in order to drop duplicates (e.g. retransmissions of reliable packets whose
+ * ACK was lost) and to tell lost packets from reordered ones. Handles the
+ * roll over of XbotHeader::sequence_no.
+ */
+class SequenceWindow {
+ public:
+  static constexpr uint16_t size = 64;
+
+  enum class Arrival : uint8_t {
+    // Newer than everything received so far, possibly skipping some
+    IN_ORDER,
+    // Older than the newest one, but not received before
+    LATE,
+    DUPLICATE,
+    // Older than the window, unknown whether it was received before
+    TOO_OLD
+  };
+
+  /**
+   * Marks the sequence number as received.
+   * @param skipped if not null, set to the number of sequence numbers an
+   * IN_ORDER one skipped, 0 otherwise
+   */
+  Arrival receive(uint16_t sequence_no, uint16_t *skipped = nullptr) {
+    if (skipped != nullptr) {
+      *skipped = 0;
+    }
+    if (!valid_) {
+      valid_ = true;
+      highest_ = sequence_no;
+      received_ = 1;
+      return Arrival::IN_ORDER;
+    }
+    const auto diff = static_cast<int16_t>(sequence_no - highest_);
+    if (diff > 0) {
+      received_ = diff >= size ? 0 : received_ << diff;
+      received_ |= 1;
+      highest_ = sequence_no;
+      if (skipped != nullptr) {
+        *skipped = static_cast<uint16_t>(diff - 1);
+      }
+      return Arrival::IN_ORDER;
+    }
+    const int age = -static_cast<int>(diff);
+    if (age >= size) {
+      return Arrival::TOO_OLD;
+    }
+    const uint64_t bit = 1ULL << age;
+    if (received_ & bit) {
+      return Arrival::DUPLICATE;
+    }
+    received_ |= bit;
+    return Arrival::LATE;
+  }
+
+  /**
+   * Marks the sequence number as received.
+   * @return false, if it was received before or is too old to tell
+   */
+  bool accept(uint16_t sequence_no) {
+    const Arrival arrival = receive(sequence_no);
+    return arrival == Arrival::IN_ORDER || arrival == Arrival::LATE;
+  }
+
+  void reset() { *this = SequenceWindow{}; }
+
+ private:
+  bool valid_ = false;
+  uint16_t highest_ = 0;
+  // Bit i is set, if highest_ - i was received
+  uint64_t received_ = 0;
+};
+}  // namespace xbot
+
+#endif  // SEQUENCEWINDOW_HPP
@@ -22,6 +22,18 @@ static constexpr uint16_t max_service_count = 25;
  */
 [[maybe_unused ]]static const char *remote_log_multicast_address = "233.255.255.1";
 static constexpr uint16_t max_log_length = 255;
+// Number of log records buffered until the sender picks them up, needs to be
+// a power of two. Records logged while the buffer is full are dropped.
+static constexpr uint32_t remote_log_buffer_size = 64;
+// Max. bytes for the encoded arguments of a single record, longer string
+// arguments are cut off.
+static constexpr uint16_t remote_log_max_args_size = 96;
+// How often the sender sends buffered records
+static constexpr uint32_t remote_log_flush_interval_micros = 20000;
+// Nice value of the sender thread, so that it does not compete with the
+// services and the IO thread
+static constexpr int remote_log_thread_nice = 10;
+static_assert((remote_log_buffer_size & (remote_log_buffer_size - 1)) == 0);
 
 /**
  * Settings for Services
@@ -45,6 +57,9 @@ static constexpr uint32_t sd_advertisement_interval_micros = 10000000;
 // the fast sd advertisement time is used as long as the service is not yet
 // claimed.
 static constexpr uint32_t sd_advertisement_interval_micros_fast = 1000000;
+// Min. time before an interface queries the same unknown description hash
+// again, if the previous query was not answered.
+static constexpr uint32_t sd_query_retry_micros = 1000000;
 
 // Time between request_configuration messages
 static constexpr uint32_t request_configuration_interval_micros = 1000000;
@@ -60,11 +75,91 @@ static constexpr uint32_t default_heartbeat_micros = 1000000;
  */
 static constexpr uint32_t heartbeat_jitter = 100000;
 
+/**
+ * Settings for time synchronization between services and their interface
+ */
+// Time between two exchanges, once synchronized
+static constexpr uint32_t time_sync_interval_micros = 1000000;
+// Time between two exchanges until synchronized
+static constexpr uint32_t time_sync_interval_micros_fast = 100000;
+// The exchange with the shortest round trip out of this many is used
+static constexpr uint32_t time_sync_window = 8;
+// Exchanges needed before the estimate is used
+static constexpr uint32_t time_sync_min_samples = 4;
+// Min. time between the exchanges used to estimate the drift, shorter
+// baselines make the estimate too noisy.
+static constexpr uint64_t time_sync_drift_baseline_nanos = 5000000000ULL;
+
+/**
+ * Settings for reliable delivery (configuration transactions and outputs
+ * marked "reliable" in service.json)
+ */
+// Retransmit timeout until the first round trip was measured
+static constexpr uint32_t reliable_initial_timeout_micros = 100000;
+// Bounds for the retransmit timeout estimated from the round trips
+static constexpr uint32_t reliable_min_timeout_micros = 2000;
+static constexpr uint32_t reliable_max_timeout_micros = 1000000;
+// Retransmissions before a packet is given up
+static constexpr uint32_t reliable_max_retransmits = 8;
+
+// Max. time between two sends of an output which is only sent on change
+// ("on_change" in service.json), unless it sets its own keyframe interval.
+static constexpr uint32_t default_keyframe_interval_micros = 1000000;
+
+// Max. number of output policies in a claim
+static constexpr uint32_t max_output_policies = 64;
+
 static_assert(max_log_length > 100);
 
 namespace service {
 static constexpr uint32_t io_thread_stack_size = 5000;
+// Number of packets preallocated by the packet pool. Every packet in flight
+// (received and queued for a service, or built for transmission) holds one
+// pool entry until it is freed.
+static constexpr uint32_t packet_pool_size = 512;
+// Max. received packets waiting in each service's queue.
+static constexpr uint32_t packet_queue_length = 10;
+// Max. number of packets received or transmitted with a single syscall.
+static constexpr uint32_t io_batch_size = 16;
+// Max. time a packet may be delayed to send it together with others.
+// 0 disables batched transmission.
+static constexpr uint32_t tx_batch_max_latency_micros = 200;
+// Packets of at least this size are sent straight from the caller's buffers
+// (scatter-gather), smaller ones are copied so that they can be batched.
+static constexpr uint32_t scatter_gather_min_size = 256;
+// Max. number of segments in a scatter-gather transmission.
+static constexpr uint32_t max_packet_segments = 4;
+static_assert(io_batch_size < packet_pool_size);
+// Max. number of periodic tasks per service, including the 6 used by the
+// Service itself (tick, heartbeat, advertisement, configuration request,
+// telemetry and time sync).
+static constexpr uint32_t max_scheduled_tasks = 12;
+// Max. reliable packets waiting for their ACK, further ones are sent
+// unreliably.
+static constexpr uint32_t reliable_max_in_flight = 8;
+// Full queues and in-flight reliable packets of all services must not take
+// the last packets, the IO thread needs some to receive.
+static_assert(packet_pool_size >=
+              max_service_count * (packet_queue_length + reliable_max_in_flight) + io_batch_size);
 }
+
+namespace serviceif {
+// Max. LOG messages waiting to be processed, newer ones are dropped.
+static constexpr uint32_t remote_log_queue_length = 256;
+// Max. log records per second and service, excess records are dropped.
+static constexpr uint32_t remote_log_max_records_per_second = 200;
+// Records a service may log at once, before the rate limit applies.
+static constexpr uint32_t remote_log_burst = 400;
+// Max. reliable packets per service waiting for their ACK, further ones are
+// sent unreliably.
+static constexpr uint32_t reliable_max_in_flight = 64;
+// Max. received packets waiting for each IO worker thread, newer ones are
+// dropped.
+static constexpr uint32_t io_worker_queue_length = 4096;
+// Default max. callbacks waiting for a subscriber with its own thread, see
+// ServiceIO::RegisterCallbacks().
+static constexpr uint32_t callback_queue_length = 1024;
+}  // namespace serviceif
 }  // namespace xbot::config
 
 #endif  // CONFIG_HPP
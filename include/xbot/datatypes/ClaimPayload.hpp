@@ -2,8 +2,8 @@
 // Created by clemens on 3/25/24.
 //
 
-#ifndef LOGPAYLOAD_HPP
-#define LOGPAYLOAD_HPP
+#ifndef CLAIMPAYLOAD_HPP
+#define CLAIMPAYLOAD_HPP
 
 #include <cstdint>
 #include <xbot/config.hpp>
@@ -20,8 +20,13 @@ struct ClaimPayload {
   uint16_t target_port{};
   // Heartbeat in micros
   uint32_t heartbeat_micros{};
+  // Interval for telemetry messages in micros, 0 to disable them.
+  // Optional, claims without this field are accepted as well.
+  uint32_t telemetry_interval_micros{};
+  // Followed by up to config::max_output_policies OutputPolicy entries.
+  // Outputs without an entry are sent at full rate.
 } __attribute__((packed));
 #pragma pack(pop)
 }  // namespace xbot::datatypes
 
-#endif  // LOGPAYLOAD_HPP
+#endif  // CLAIMPAYLOAD_HPP
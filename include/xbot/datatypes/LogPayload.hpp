@@ -20,6 +20,60 @@ enum class LogLevel : uint8_t {
   CRITICAL_LEVEL,
   ALWAYS_LEVEL,
 };
-}
+
+// Payload encoding of LOG messages, stored in XbotHeader::arg2
+enum class LogEncoding : uint16_t {
+  // Payload is a 0 terminated string, arg1 is the LogLevel.
+  TEXT = 0,
+  // Payload is a sequence of LogEntryHeader entries, arg1 is the highest
+  // LogLevel in the batch. Formatting happens on the receiving side.
+  RECORDS = 1,
+};
+
+enum class LogEntryType : uint8_t {
+  // Defines a printf style format string for the following records of the
+  // same message. Data: the format string (not 0 terminated).
+  FORMAT = 0,
+  // A log record. Data: LogRecordHeader followed by the arguments.
+  RECORD = 1,
+  // Records were dropped on the sender side, because the log buffer was
+  // full. Data: uint32_t number of dropped records since the last message.
+  DROPPED = 2,
+};
+
+// Type tags for record arguments. Each argument is the tag followed by its
+// value.
+enum class LogArgType : uint8_t {
+  // int64_t
+  INT = 0,
+  // uint64_t
+  UINT = 1,
+  // double
+  DOUBLE = 2,
+  // uint8_t length followed by the characters (not 0 terminated)
+  STRING = 3,
+  // uint64_t
+  POINTER = 4,
+};
+
+#pragma pack(push, 1)
+struct LogEntryHeader {
+  LogEntryType type{};
+  // FORMAT and RECORD: ID of the format string, only valid within a message.
+  uint8_t format_id{};
+  // Length of the data following this header
+  uint16_t length{};
+} __attribute__((packed));
+
+struct LogRecordHeader {
+  LogLevel level{};
+  uint8_t arg_count{};
+  uint16_t service_id{};
+  // Time when the record was logged, nanoseconds of the service's monotonic
+  // clock
+  uint64_t timestamp{};
+} __attribute__((packed));
+#pragma pack(pop)
+}  // namespace xbot::datatypes
 
 #endif  // LOGPAYLOAD_HPP
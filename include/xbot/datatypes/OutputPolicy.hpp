@@ -0,0 +1,42 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef OUTPUTPOLICY_HPP
+#define OUTPUTPOLICY_HPP
+
+#include <cstdint>
+
+namespace xbot::datatypes {
+
+enum class OutputPolicyMode : uint8_t {
+  // Send every sample (default)
+  FULL_RATE = 0,
+  // Send the first and then every param-th sample
+  EVERY_NTH = 1,
+  // Send at most one sample every param micros
+  MAX_RATE = 2,
+  // Send the min / max / mean of all samples within a window of param
+  // micros. Outputs which can't be aggregated (arrays) are limited to one
+  // sample per window instead.
+  WINDOW_MIN = 3,
+  WINDOW_MAX = 4,
+  WINDOW_MEAN = 5,
+};
+
+#pragma pack(push, 1)
+/**
+ * Publish policy for a single output, requested by the interface with the
+ * claim. Appended to the ClaimPayload.
+ */
+struct OutputPolicy {
+  uint16_t output_id{};
+  OutputPolicyMode mode{OutputPolicyMode::FULL_RATE};
+  uint8_t reserved{};
+  // Meaning depends on the mode, see OutputPolicyMode
+  uint32_t param{};
+} __attribute__((packed));
+#pragma pack(pop)
+}  // namespace xbot::datatypes
+
+#endif  // OUTPUTPOLICY_HPP
@@ -0,0 +1,27 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef SERVICEDESCRIPTIONHASH_HPP
+#define SERVICEDESCRIPTIONHASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xbot::datatypes {
+/**
+ * 32 bit FNV-1a hash of the CBOR encoded service description.
+ * Advertisements only carry this hash, interfaces fetch the description
+ * with a SERVICE_QUERY whenever they see an unknown one.
+ */
+constexpr uint32_t ServiceDescriptionHash(const uint8_t *data, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+}  // namespace xbot::datatypes
+
+#endif  // SERVICEDESCRIPTIONHASH_HPP
@@ -0,0 +1,55 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef TELEMETRYPAYLOAD_HPP
+#define TELEMETRYPAYLOAD_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xbot::datatypes {
+// Histogram bucket i counts values in [2^(i-1), 2^i) micros, bucket 0 counts
+// 0 micros and the last bucket everything from 2^(count-2) micros upwards.
+static constexpr size_t telemetry_histogram_buckets = 16;
+
+#pragma pack(push, 1)
+struct TelemetryPayload {
+  // Deviation of the time between two ticks from the tick rate
+  uint32_t tick_jitter_histogram[telemetry_histogram_buckets]{};
+  // Time spent in tick()
+  uint32_t tick_duration_histogram[telemetry_histogram_buckets]{};
+  uint32_t max_tick_duration_micros{};
+  // Number of ticks which were late by more than a whole tick period
+  uint32_t tick_overruns{};
+  // CPU time used by the processing thread
+  uint64_t cpu_time_micros{};
+  // Max. number of packets waiting in the processing queue
+  uint16_t queue_high_water_mark{};
+  uint16_t queue_length{};
+  // Received packets dropped, because the processing queue was full
+  uint32_t queue_drops{};
+  // Packets which could not be transmitted, including the failed TX batches
+  // of all services in the same process
+  uint32_t tx_failures{};
+  // Retransmissions of reliable packets and reliable packets which were
+  // given up without an ACK
+  uint32_t retransmits{};
+  uint32_t reliable_failures{};
+} __attribute__((packed));
+#pragma pack(pop)
+
+/**
+ * @return the histogram bucket for the value
+ */
+inline size_t telemetryHistogramBucket(uint32_t value_micros) {
+  size_t bucket = 0;
+  while (value_micros > 0 && bucket < telemetry_histogram_buckets - 1) {
+    value_micros >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+}  // namespace xbot::datatypes
+
+#endif  // TELEMETRYPAYLOAD_HPP
@@ -0,0 +1,23 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef TIMESYNCPAYLOAD_HPP
+#define TIMESYNCPAYLOAD_HPP
+
+#include <cstdint>
+
+namespace xbot::datatypes {
+#pragma pack(push, 1)
+struct TimeSyncPayload {
+  // Service time when the request was sent, echoed by the interface
+  uint64_t request_sent{};
+  // Interface time when the request was received
+  uint64_t request_received{};
+  // Interface time when the response was sent
+  uint64_t response_sent{};
+} __attribute__((packed));
+#pragma pack(pop)
+}  // namespace xbot::datatypes
+
+#endif  // TIMESYNCPAYLOAD_HPP
@@ -20,18 +20,36 @@ namespace xbot::datatypes {
     CONFIGURATION_REQUEST = 0x02,
     // User CLAIM in order to claim a service. Payload is IP (uint32_t) and
     // port(uint16_t). Service will reply with CLAM with arg1 == true for ack
+    // arg2 == 1 only updates the telemetry interval and output policies of
+    // an existing claim.
     CLAIM = 0x03,
     // Heartbeat is sent regularly by service to show that its alive
     HEARTBEAT = 0x04,
     // Transaction bundles multiple data IOs separated with
     // DataDescriptor headers.
+    // arg1 == 0 for data, 1 for a full configuration and 2 for an update of
+    // some registers of a running service.
     TRANSACTION = 0x05,
+    // Telemetry is sent periodically by the service, if the claim requested
+    // it. Payload is TelemetryPayload.
+    TELEMETRY = 0x06,
+    // Time synchronization, sent by the service to its claiming interface.
+    // arg1 == 0 for the request, the interface replies with arg1 == 1.
+    // Payload is TimeSyncPayload.
+    TIME_SYNC = 0x07,
+    // Acknowledges a packet sent with FLAG_RELIABLE. sequence_no is the one
+    // of the acknowledged packet, no payload.
+    ACK = 0x08,
     // For remote debug logging
     LOG = 0x7F,
     // First bit 1, the payload is JSON encoded.
     // Use for complex, infrequent, non-realtime critical messages (e.g. service
     // discovery).
+    // Advertisements only contain the hash of the service description.
     SERVICE_ADVERTISEMENT = 0x80,
+    // Sent by an interface with arg1 == 0 to the service's endpoint for an
+    // unknown description hash. The service multicasts the CBOR encoded
+    // description with arg1 == 1 to the service discovery group.
     SERVICE_QUERY = 0x81
   };
 
@@ -45,6 +63,13 @@ namespace xbot::datatypes {
     // Flags.
     // Bit 0: Reboot (1 after service started, 0 after sequence_no rolled over at
     // least once)
+    // Bit 1: More fragments (Transaction only). The transaction did not fit
+    // into a single packet and continues in the next one. All fragments share
+    // the same timestamp, arg2 holds the index of the fragment.
+    // Bit 2: Time synced. The timestamp is in the receiver's time base.
+    // Bit 3: Reliable. The receiver answers with an ACK, the sender
+    // retransmits the unchanged packet until it is acknowledged. Receivers
+    // drop duplicates by their sequence_no.
     uint8_t flags{};
     uint8_t reserved1{};
     uint16_t service_id{};
@@ -54,11 +79,15 @@ namespace xbot::datatypes {
     uint8_t arg1{};
     uint8_t reserved2{};
     // Reserved for message specific payload (e.g. target_id for data message)
+    // Transaction: Index of the fragment
+    // Log Message: LogEncoding of the payload
     uint16_t arg2{};
     // Sequence number, increment on each message. Clear "reboot" flag on roll
     // over
     uint16_t sequence_no{};
-    // Message timestamp. Unix timestamp in nanoseconds.
+    // Message timestamp in nanoseconds. Interfaces use Unix time. Services
+    // use their monotonic clock until they are synchronized to the claiming
+    // interface, then the interface's time (see FLAG_TIME_SYNCED).
     // Nanoseconds because we need 64 bit anyways and even with nanoseconds we
     // have until year 2554 before it rolls over.
     uint64_t timestamp{};
@@ -69,6 +98,12 @@ namespace xbot::datatypes {
   } __attribute__((packed));
 #pragma pack(pop)
 
+  // Bits for XbotHeader::flags
+  static constexpr uint8_t FLAG_REBOOT = 0x01;
+  static constexpr uint8_t FLAG_MORE_FRAGMENTS = 0x02;
+  static constexpr uint8_t FLAG_TIME_SYNCED = 0x04;
+  static constexpr uint8_t FLAG_RELIABLE = 0x08;
+
 #pragma pack(push, 1)
   struct DataDescriptor {
     // Target ID for the next piece of data
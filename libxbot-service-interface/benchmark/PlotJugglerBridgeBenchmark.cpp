@@ -0,0 +1,128 @@
+//
+// Measures how many samples per second the PlotJugglerBridge forwards to
+// PlotJuggler (UDP to localhost, including the send).
+//
+// A fake service with a few typical outputs sends them all in one transaction,
+// like a service publishing its state. Single samples are sent outside of
+// transactions, each one needs a message of its own.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <xbot-service-interface/ServiceDiscovery.hpp>
+#include <xbot-service-interface/ServiceIO.hpp>
+
+#include "PlotJugglerBridge.hpp"
+
+using namespace xbot::serviceif;
+using Clock = std::chrono::steady_clock;
+
+static constexpr uint16_t service_id = 42;
+static constexpr size_t transactions = 50000;
+static constexpr size_t single_samples = 200000;
+
+namespace {
+ServiceIOInfo MakeOutput(uint16_t id, std::string name, std::string type,
+                         uint32_t maxlen = 0) {
+  ServiceIOInfo info{};
+  info.id = id;
+  info.name = std::move(name);
+  info.type = std::move(type);
+  info.is_array = maxlen > 0;
+  info.maxlen = maxlen;
+  return info;
+}
+
+class FakeDiscovery : public ServiceDiscovery {
+ public:
+  void RegisterCallbacks(ServiceDiscoveryCallbacks *) override {}
+  void UnregisterCallbacks(ServiceDiscoveryCallbacks *) override {}
+  std::unique_ptr<ServiceInfo> GetServiceInfo(uint16_t id) override {
+    auto info = std::make_unique<ServiceInfo>();
+    info->service_id_ = id;
+    info->description.outputs = {
+        MakeOutput(0, "Speed", "float"),
+        MakeOutput(1, "Counter", "uint32_t"),
+        MakeOutput(2, "Imu", "float", 9),
+        MakeOutput(3, "Status", "char", 32),
+        MakeOutput(4, "Samples", "int16_t", 16),
+        MakeOutput(5, "Position", "double", 3),
+    };
+    return info;
+  }
+};
+
+class FakeIO : public ServiceIO {
+ public:
+  void RegisterCallbacks(uint16_t, ServiceIOCallbacks *) override {}
+  void RegisterCallbacks(uint16_t, ServiceIOCallbacks *, const CallbackExecutorOptions &) override {}
+  bool GetCallbackStats(ServiceIOCallbacks *, CallbackStats &) override { return false; }
+  void UnregisterCallbacks(ServiceIOCallbacks *) override {}
+  bool SendData(uint16_t, const std::vector<uint8_t> &) override { return true; }
+  bool SendReliable(uint16_t, const std::vector<uint8_t> &) override { return true; }
+  void SetTelemetryInterval(uint16_t, uint32_t) override {}
+  bool SetOutputPolicy(uint16_t, const xbot::datatypes::OutputPolicy &) override { return true; }
+  bool GetLatencyStats(uint16_t, LatencyStats &) override { return false; }
+  bool GetReliableStats(uint16_t, ReliableStats &) override { return false; }
+  bool GetSequenceStats(uint16_t, SequenceStats &) override { return false; }
+  void SetDropOutOfOrder(uint16_t, bool) override {}
+  bool OK() override { return true; }
+};
+
+struct Payloads {
+  float speed = 1.5f;
+  uint32_t counter = 123456;
+  float imu[9] = {0.1f, 0.2f, 9.81f, 0.01f, 0.02f, 0.03f, 20.0f, 30.0f, 40.0f};
+  char status[32] = "running";
+  int16_t samples[16] = {1, -2, 3, -4, 5, -6, 7, -8, 9, -10, 11, -12, 13, -14, 15, -16};
+  double position[3] = {12.345, -6.789, 0.5};
+
+  void Send(PlotJugglerBridge &pjb, uint64_t timestamp) {
+    pjb.OnData(service_id, timestamp, 0, &speed, sizeof(speed));
+    pjb.OnData(service_id, timestamp, 1, &counter, sizeof(counter));
+    pjb.OnData(service_id, timestamp, 2, imu, sizeof(imu));
+    pjb.OnData(service_id, timestamp, 3, status, strlen(status));
+    pjb.OnData(service_id, timestamp, 4, samples, sizeof(samples));
+    pjb.OnData(service_id, timestamp, 5, position, sizeof(position));
+  }
+};
+constexpr size_t samples_per_transaction = 6;
+}  // namespace
+
+void RunBenchmark(const char *name, PlotJugglerEncoding encoding) {
+  FakeIO io{};
+  FakeDiscovery discovery{};
+  PlotJugglerBridge pjb{{.io = &io, .serviceDiscovery = &discovery}, encoding};
+  if (!pjb.Start()) {
+    printf("Could not start the PlotJugglerBridge\n");
+    return;
+  }
+  pjb.OnServiceDiscovered(service_id);
+  Payloads payloads{};
+
+  auto start = Clock::now();
+  for (size_t i = 0; i < transactions; i++) {
+    pjb.OnTransactionStart(service_id, i);
+    payloads.Send(pjb, i);
+    pjb.OnTransactionEnd(service_id);
+  }
+  const std::chrono::duration<double> transaction_time = Clock::now() - start;
+
+  start = Clock::now();
+  for (size_t i = 0; i < single_samples; i++) {
+    pjb.OnData(service_id, i, 2, payloads.imu, sizeof(payloads.imu));
+  }
+  const std::chrono::duration<double> single_time = Clock::now() - start;
+
+  printf("%-14s transactions: %10.0f samples/s, single samples: %10.0f samples/s\n", name,
+         transactions * samples_per_transaction / transaction_time.count(),
+         single_samples / single_time.count());
+}
+
+int main() {
+  RunBenchmark("JSON", PlotJugglerEncoding::JSON);
+  RunBenchmark("CBOR", PlotJugglerEncoding::CBOR);
+  RunBenchmark("MessagePack", PlotJugglerEncoding::MESSAGE_PACK);
+  return 0;
+}
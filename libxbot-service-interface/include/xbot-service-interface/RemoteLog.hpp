@@ -0,0 +1,70 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef REMOTELOG_HPP
+#define REMOTELOG_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <xbot/datatypes/LogPayload.hpp>
+
+namespace xbot::serviceif {
+ /**
+  * A formatted log record received from a service.
+  */
+ struct RemoteLogRecord {
+  uint16_t service_id{};
+  datatypes::LogLevel level{};
+  // Timestamp set by the service when logging
+  uint64_t timestamp{};
+  std::string message{};
+ };
+
+ struct RemoteLogStats {
+  // LOG messages received
+  uint64_t received_messages{};
+  // LOG messages dropped, because processing could not keep up
+  uint64_t dropped_messages{};
+  // LOG messages which could not be parsed
+  uint64_t invalid_messages{};
+  // Records delivered to the log and the subscribers
+  uint64_t records{};
+  // Records dropped by the per-service rate limit
+  uint64_t rate_limited_records{};
+  std::map<uint16_t, uint64_t> rate_limited_records_per_service{};
+  // Records the services reported as dropped, because their log buffer was
+  // full
+  uint64_t sender_dropped_records{};
+ };
+
+ class RemoteLogCallbacks {
+ public:
+  virtual ~RemoteLogCallbacks() = default;
+
+  /**
+   * Called for every log record which passed the rate limit.
+   * This is called from the log processing thread, not the IO thread.
+   */
+  virtual void OnLogRecord(const RemoteLogRecord &record) = 0;
+ };
+
+ /**
+  * Receives LOG messages from services and writes them to the "remote"
+  * spdlog logger. Messages are processed on their own thread, so that noisy
+  * services can't slow down the data IO.
+  */
+ class RemoteLog {
+ public:
+  virtual ~RemoteLog() = default;
+
+  virtual void RegisterCallbacks(RemoteLogCallbacks *callbacks) = 0;
+
+  virtual void UnregisterCallbacks(RemoteLogCallbacks *callbacks) = 0;
+
+  virtual RemoteLogStats GetStats() = 0;
+ };
+} // namespace xbot::serviceif
+
+#endif  // REMOTELOG_HPP
@@ -7,9 +7,107 @@
 
 #include <string>
 #include <xbot-service-interface/ServiceDiscovery.hpp>
+#include <xbot/config.hpp>
+#include <xbot/datatypes/OutputPolicy.hpp>
+#include <xbot/datatypes/TelemetryPayload.hpp>
 #include <xbot/datatypes/XbotHeader.hpp>
 
 namespace xbot::serviceif {
+ /**
+  * One-way latency of the messages received from a service, measured from
+  * the header timestamp to the time of reception. Only messages with a
+  * synchronized timestamp (datatypes::FLAG_TIME_SYNCED) that was taken when
+  * sending (data, heartbeat and telemetry) are counted.
+  */
+ struct LatencyStats {
+  // Bucket i counts latencies in [2^(i-1), 2^i) micros, see
+  // datatypes::telemetryHistogramBucket()
+  uint32_t histogram[datatypes::telemetry_histogram_buckets]{};
+  uint64_t count{};
+  uint64_t sum_micros{};
+  uint64_t max_micros{};
+  // Messages which arrived before their timestamp, i.e. the clock
+  // synchronization is off by more than the latency. Not in the histogram.
+  uint64_t negative_count{};
+ };
+
+ /**
+  * Delivery statistics of the reliable packets (datatypes::FLAG_RELIABLE)
+  * exchanged with a service. The service reports its own retransmissions
+  * with its telemetry.
+  */
+ struct ReliableStats {
+  // Reliable packets sent to the service (e.g. configuration transactions)
+  uint64_t sent{};
+  uint64_t acknowledged{};
+  uint64_t retransmits{};
+  // Packets given up after config::reliable_max_retransmits
+  uint64_t failures{};
+  // Reliable packets received from the service twice, because our ACK was
+  // lost. They are only delivered once.
+  uint64_t duplicates_received{};
+  // Smoothed round trip to the service, 0 until measured
+  uint32_t rtt_micros{};
+ };
+
+ /**
+  * Arrival statistics of the messages received from a service, from the
+  * sequence numbers in their headers.
+  */
+ struct SequenceStats {
+  uint64_t received{};
+  // Sequence numbers which were skipped and did not arrive late (yet)
+  uint64_t lost{};
+  // Messages which arrived after a newer one
+  uint64_t reordered{};
+  uint64_t duplicates{};
+  // Late and duplicate data dropped, see ServiceIO::SetDropOutOfOrder()
+  uint64_t dropped{};
+  // Restarts of the service which were noticed from the sequence numbers,
+  // before the service timed out
+  uint64_t restarts{};
+ };
+
+ /**
+  * What to do with new callbacks, when a subscriber's queue is full.
+  */
+ enum class OverflowPolicy {
+  // Drop the oldest queued data, i.e. deliver the latest values
+  DROP_OLDEST,
+  // Drop the new data
+  DROP_NEWEST,
+  // Wait for the subscriber. This stalls receiving for the service (and all
+  // other services handled by the same thread), use with care.
+  BLOCK,
+ };
+
+ /**
+  * Options for subscribers which are called from a thread of their own, see
+  * ServiceIO::RegisterCallbacks().
+  */
+ struct CallbackExecutorOptions {
+  // Max. queued callbacks, further data is handled by overflow_policy
+  size_t queue_length = config::serviceif::callback_queue_length;
+  OverflowPolicy overflow_policy = OverflowPolicy::DROP_OLDEST;
+ };
+
+ /**
+  * Delivery statistics of a subscriber with its own thread.
+  */
+ struct CallbackStats {
+  uint64_t queued{};
+  uint64_t delivered{};
+  // Data and telemetry dropped due to a full queue
+  uint64_t dropped{};
+  // Times the receiving thread waited for a full queue (OverflowPolicy::BLOCK)
+  uint64_t blocked{};
+  // Callbacks waiting for delivery right now
+  size_t pending{};
+  // Time the last delivered callback spent in the queue, and the maximum
+  uint64_t lag_micros{};
+  uint64_t max_lag_micros{};
+ };
+
  class ServiceIOCallbacks {
  public:
   virtual ~ServiceIOCallbacks() = default;
@@ -30,6 +128,27 @@ namespace xbot::serviceif {
    */
   virtual void OnTransactionEnd() = 0;
 
+  /**
+   * Like OnTransactionStart(uint64_t), with the service sending the
+   * transaction. Transactions of different services can interleave, if the
+   * services are handled by different threads.
+   * @param service_id the service's id
+   * @param timestamp the transaction's timestamp
+   */
+  virtual void OnTransactionStart(uint16_t service_id, uint64_t timestamp) {
+   (void)service_id;
+   OnTransactionStart(timestamp);
+  }
+
+  /**
+   * Like OnTransactionEnd(), with the service sending the transaction.
+   * @param service_id the service's id
+   */
+  virtual void OnTransactionEnd(uint16_t service_id) {
+   (void)service_id;
+   OnTransactionEnd();
+  }
+
   /**
    * Called whenever a packet is received from the specified service.
    * @param service_id service id
@@ -57,6 +176,19 @@ namespace xbot::serviceif {
    * @param service_id the service's id
    */
   virtual void OnServiceDisconnected(uint16_t service_id) = 0;
+
+  /**
+   * Called whenever a service sends telemetry, see
+   * ServiceIO::SetTelemetryInterval(). Counters and histograms accumulate
+   * since the service started.
+   * @param service_id the service's id
+   * @param telemetry the received telemetry
+   */
+  virtual void OnTelemetry(uint16_t service_id,
+                           const datatypes::TelemetryPayload &telemetry) {
+   (void)service_id;
+   (void)telemetry;
+  }
  };
 
  /**
@@ -75,7 +207,42 @@ namespace xbot::serviceif {
                                  ServiceIOCallbacks *callbacks) = 0;
 
   /**
-   * Unregister callbacks for all uids
+   * Register callbacks for a specific uid, which are called from a thread of
+   * their own, so that a slow subscriber does not delay receiving (and
+   * heartbeats, which can cause false timeouts).
+   *
+   * Callbacks are queued and delivered in order. Only data and telemetry are
+   * dropped on overflow, connects, disconnects, transaction brackets and
+   * configuration requests are always delivered.
+   * Other subscribers are asked for the configuration as well, the result of
+   * OnConfigurationRequested() only tells whether anyone handled it.
+   *
+   * A subscriber has one thread for all services, the options of its first
+   * registration apply. Later registrations without options use it as well.
+   * @param service_id the service ID to listen for
+   * @param callbacks pointer to the callbacks
+   * @param options queue options
+   */
+  virtual void RegisterCallbacks(uint16_t service_id,
+                                 ServiceIOCallbacks *callbacks,
+                                 const CallbackExecutorOptions &options) = 0;
+
+  /**
+   * Get the delivery statistics of a subscriber with its own thread.
+   * @param callbacks callback pointer
+   * @param stats the statistics since the callbacks were registered
+   * @return false, if the callbacks don't have their own thread
+   */
+  virtual bool GetCallbackStats(ServiceIOCallbacks *callbacks,
+                                CallbackStats &stats) = 0;
+
+  /**
+   * Unregister callbacks for all uids. The callbacks won't be called anymore,
+   * once this returns, so they can be destroyed. Queued ones of callbacks
+   * with their own thread are dropped.
+   * Called from any callback (including the ones with their own thread), this
+   * does not wait for other threads, which might still be calling them. They
+   * must not be destroyed right away then.
    * @param callbacks callback pointer
    */
   virtual void UnregisterCallbacks(ServiceIOCallbacks *callbacks) = 0;
@@ -86,6 +253,73 @@ namespace xbot::serviceif {
   virtual bool SendData(uint16_t service_id,
                         const std::vector<uint8_t> &data) = 0;
 
+  /**
+   * Send data to a given service target and retransmit it, until the service
+   * acknowledges it. The packet is identified by the sequence_no in its
+   * header, which must not be reused while it is in flight.
+   * Services which were not discovered yet get the data unreliably.
+   */
+  virtual bool SendReliable(uint16_t service_id,
+                            const std::vector<uint8_t> &data) = 0;
+
+  /**
+   * Ask a service to send telemetry. Takes effect with the next claim, a
+   * claimed service gets a claim update right away.
+   * @param service_id the service ID
+   * @param interval_micros interval between telemetry messages, 0 to disable
+   */
+  virtual void SetTelemetryInterval(uint16_t service_id,
+                                    uint32_t interval_micros) = 0;
+
+  /**
+   * Ask a service to apply a publish policy to one of its outputs, e.g. to
+   * only send it at 10 Hz. The service drops the other samples before
+   * sending them. Takes effect with the next claim, a claimed service is
+   * updated right away, without claiming it again.
+   * @param service_id the service ID
+   * @param policy the policy, FULL_RATE removes it
+   * @return false, if the service already has config::max_output_policies
+   * policies
+   */
+  virtual bool SetOutputPolicy(uint16_t service_id,
+                               const datatypes::OutputPolicy &policy) = 0;
+
+  /**
+   * Get the latency statistics of a connected service.
+   * @param service_id the service ID
+   * @param stats the statistics since the service was connected
+   * @return false, if the service is not connected
+   */
+  virtual bool GetLatencyStats(uint16_t service_id, LatencyStats &stats) = 0;
+
+  /**
+   * Get the reliable delivery statistics of a connected service.
+   * @param service_id the service ID
+   * @param stats the statistics since the service was connected
+   * @return false, if the service is not connected
+   */
+  virtual bool GetReliableStats(uint16_t service_id, ReliableStats &stats) = 0;
+
+  /**
+   * Get the arrival statistics of a connected service, e.g. to tell packet
+   * loss from a slow service.
+   * @param service_id the service ID
+   * @param stats the statistics since the service was discovered
+   * @return false, if the service is not connected
+   */
+  virtual bool GetSequenceStats(uint16_t service_id, SequenceStats &stats) = 0;
+
+  /**
+   * Drop data which arrives after newer data from the same service, or
+   * twice, instead of delivering it. Use this, if the consumers only care
+   * about the latest value, so that a delayed packet doesn't overwrite newer
+   * state. Reliable data is delivered once, even if it arrives late.
+   * Disabled by default.
+   * @param service_id the service ID
+   * @param enabled true to drop out of order data
+   */
+  virtual void SetDropOutOfOrder(uint16_t service_id, bool enabled) = 0;
+
   /**
    * Call this to check if IO is still running.
    * On shutdown this will return false, stop your interface then
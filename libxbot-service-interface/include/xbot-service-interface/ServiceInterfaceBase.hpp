@@ -21,6 +21,27 @@ namespace xbot::serviceif {
 
   void Start();
 
+  /**
+   * Asks the service to apply a publish policy to one of its outputs, see
+   * ServiceIO::SetOutputPolicy(). Works before the service was discovered.
+   * @param output_id the output's id
+   * @param mode the policy, FULL_RATE to send every sample again
+   * @param param depends on the mode, see datatypes::OutputPolicyMode
+   */
+  bool SetOutputPolicy(uint16_t output_id, datatypes::OutputPolicyMode mode,
+                       uint32_t param = 0);
+
+  /**
+   * Limits an output to the given rate.
+   */
+  bool SetOutputMaxRate(uint16_t output_id, float rate_hz);
+
+  /**
+   * Drops data which arrives late or twice, see
+   * ServiceIO::SetDropOutOfOrder().
+   */
+  void SetDropOutOfOrder(bool enabled);
+
  protected:
   const uint16_t service_id_;
   // Type of the service (e.g. IMU Service)
@@ -31,8 +52,35 @@ namespace xbot::serviceif {
 
   bool StartTransaction(bool is_configuration = false);
 
+  /**
+   * Starts a transaction which updates registers of the running service
+   * without restarting it (as long as its OnRegister<Name>Changed() hooks
+   * accept the change). The generated SetRegister<Name>() methods only send
+   * registers which differ from the last configuration sent. Nothing is sent,
+   * if no register changed.
+   */
+  bool StartConfigurationUpdate();
+
+  /**
+   * @return true, within a transaction started by StartConfigurationUpdate()
+   */
+  bool IsConfigurationUpdate();
+
   bool CommitTransaction();
 
+  /**
+   * Forgets the register values sent last, so that the next configuration
+   * update contains all registers again. Called when the service connects,
+   * when a full configuration starts and after a reliable send failed.
+   */
+  void InvalidateSentRegisters();
+
+  /**
+   * Implemented by the generated interfaces, which remember the register
+   * values sent last. Called with the state locked.
+   */
+  virtual void ClearSentRegisters() {}
+
   bool SendData(uint16_t target_id, const void *data, size_t size,
                 bool is_configuration);
 
@@ -45,11 +93,17 @@ namespace xbot::serviceif {
  private:
   void FillHeader();
 
+  bool StartTransaction(bool is_configuration, bool is_update);
+
   // Scratch space for the header.
   xbot::datatypes::XbotHeader header_{};
   std::vector<uint8_t> buffer_{};
   bool transaction_started_{false};
   bool is_configuration_transaction_{false};
+  bool is_configuration_update_{false};
+  // Reliable send failures seen by the last configuration update, see
+  // ServiceIO::GetReliableStats()
+  uint64_t reliable_failures_seen_{0};
 
   std::recursive_mutex state_mutex_{};
 
@@ -5,6 +5,7 @@
 #ifndef XBOT_FRAMEWORK_XBOTSERVICEINTERFACE_HPP
 #define XBOT_FRAMEWORK_XBOTSERVICEINTERFACE_HPP
 
+#include <xbot-service-interface/RemoteLog.hpp>
 #include <xbot-service-interface/ServiceDiscovery.hpp>
 #include <xbot-service-interface/ServiceIO.hpp>
 
@@ -12,16 +13,28 @@ namespace xbot::serviceif {
 struct Context {
   ServiceIO *io = nullptr;
   ServiceDiscovery *serviceDiscovery = nullptr;
+  RemoteLog *remoteLog = nullptr;
 };
 
+/**
+ * Encoding of the messages sent to PlotJuggler's UDP server. The binary ones
+ * are smaller and faster to encode, select the same one in PlotJuggler.
+ */
+enum class PlotJugglerEncoding { JSON, CBOR, MESSAGE_PACK };
+
 /**
  * Call this method to start xbot_framework.
  *
  * @param register_signal_handlers true to handle signals (CTRL+C), false to
  * manually stop using Stop()
+ * @param io_worker_threads number of threads handling received packets, 0 to
+ * handle them on the IO thread. Each service is handled by a single thread.
+ * @param plotjuggler_encoding encoding of the data forwarded to PlotJuggler
  * @return The context
  */
-Context Start(bool register_signal_handlers = true, std::string bind_ip = "0.0.0.0");
+Context Start(bool register_signal_handlers = true, std::string bind_ip = "0.0.0.0",
+              size_t io_worker_threads = 0,
+              PlotJugglerEncoding plotjuggler_encoding = PlotJugglerEncoding::JSON);
 void Stop();
 }  // namespace xbot::serviceif
 
@@ -22,6 +22,9 @@ namespace xbot::serviceif {
         uint32_t ip{};
         uint16_t port{};
 
+        // Hash of the CBOR encoded description, as advertised by the service
+        uint32_t description_hash{};
+
         ServiceDescription description{};
     };
 
@@ -32,6 +35,7 @@ namespace xbot::serviceif {
                 "endpoint",
                 {{"ip", IpIntToString(si.ip)}, {"port", si.port}},
             },
+            {"hash", si.description_hash},
             {"desc", si.description}
         };
     }
@@ -40,7 +44,13 @@ namespace xbot::serviceif {
         j.at("sid").get_to(p.service_id_);
         p.ip = IpStringToInt(j.at("endpoint").at("ip").get<std::string>());
         j.at("endpoint").at("port").get_to(p.port);
-        j.at("desc").get_to(p.description);
+        // Services only advertise the hash, older ones the whole description.
+        if (j.contains("hash")) {
+            j.at("hash").get_to(p.description_hash);
+        }
+        if (j.contains("desc")) {
+            j.at("desc").get_to(p.description);
+        }
     }
 } // namespace xbot::serviceif
 
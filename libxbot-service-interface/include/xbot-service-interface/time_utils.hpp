@@ -0,0 +1,23 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef TIME_UTILS_HPP
+#define TIME_UTILS_HPP
+
+#include <chrono>
+#include <cstdint>
+
+namespace xbot::serviceif {
+/**
+ * @return the current Unix time in nanoseconds. This is the time base for
+ * header timestamps, services synchronize to it.
+ */
+inline uint64_t GetTimestampNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+}  // namespace xbot::serviceif
+
+#endif  // TIME_UTILS_HPP
@@ -0,0 +1,236 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include "CallbackExecutor.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+using namespace xbot::serviceif;
+
+namespace {
+// Set on the threads of all executors
+thread_local bool executor_thread_ = false;
+}  // namespace
+
+CallbackExecutor::CallbackExecutor(ServiceIOCallbacks *callbacks,
+                                   const CallbackExecutorOptions &options,
+                                   ConfigurationAnswered configuration_answered)
+  : callbacks_(callbacks),
+    options_(options),
+    configuration_answered_(std::move(configuration_answered)) {
+}
+
+CallbackExecutor::~CallbackExecutor() {
+  if (thread_.joinable()) {
+    // The thread dropped the last reference when it finished, after being
+    // stopped from within a callback
+    thread_.detach();
+  }
+}
+
+void CallbackExecutor::Start() {
+  thread_ = std::thread{[self = shared_from_this()] { self->Run(); }};
+}
+
+void CallbackExecutor::Stop() {
+  {
+    std::unique_lock lk{queue_mutex_};
+    stopped_ = true;
+    queue_.clear();
+  }
+  delivering_ = false;
+  queue_cv_.notify_all();
+  space_cv_.notify_all();
+  if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id()) {
+    thread_.join();
+  }
+}
+
+CallbackStats CallbackExecutor::GetStats() {
+  std::unique_lock lk{queue_mutex_};
+  CallbackStats stats = stats_;
+  stats.pending = queue_.size() + taken_;
+  return stats;
+}
+
+void CallbackExecutor::SetBlocking(bool blocking) {
+  {
+    std::unique_lock lk{queue_mutex_};
+    blocking_ = blocking;
+  }
+  space_cv_.notify_all();
+}
+
+bool CallbackExecutor::IsExecutorThread() { return executor_thread_; }
+
+void CallbackExecutor::OnServiceConnected(uint16_t service_id) {
+  Enqueue({Call::Type::SERVICE_CONNECTED, service_id, 0, 0, {}, {}});
+}
+
+void CallbackExecutor::OnTransactionStart(uint64_t timestamp) {
+  Enqueue({Call::Type::TRANSACTION_START, 0, 0, timestamp, {}, {}});
+}
+
+void CallbackExecutor::OnTransactionEnd() {
+  Enqueue({Call::Type::TRANSACTION_END, 0, 0, 0, {}, {}});
+}
+
+void CallbackExecutor::OnTransactionStart(uint16_t service_id,
+                                          uint64_t timestamp) {
+  Enqueue({Call::Type::TRANSACTION_START, service_id, 0, timestamp, {}, {}});
+}
+
+void CallbackExecutor::OnTransactionEnd(uint16_t service_id) {
+  Enqueue({Call::Type::TRANSACTION_END, service_id, 0, 0, {}, {}});
+}
+
+void CallbackExecutor::OnData(uint16_t service_id, uint64_t timestamp,
+                              uint16_t target_id, const void *payload,
+                              size_t buflen) {
+  const auto data = static_cast<const uint8_t *>(payload);
+  Enqueue({Call::Type::DATA, service_id, target_id, timestamp,
+           std::vector<uint8_t>(data, data + buflen), {}});
+}
+
+bool CallbackExecutor::OnConfigurationRequested(uint16_t service_id) {
+  Enqueue({Call::Type::CONFIGURATION_REQUESTED, service_id, 0, 0, {}, {}});
+  // The subscriber answers later, see configuration_answered_. Let the others
+  // answer as well.
+  return false;
+}
+
+void CallbackExecutor::OnServiceDisconnected(uint16_t service_id) {
+  Enqueue({Call::Type::SERVICE_DISCONNECTED, service_id, 0, 0, {}, {}});
+}
+
+void CallbackExecutor::OnTelemetry(uint16_t service_id,
+                                   const datatypes::TelemetryPayload &telemetry) {
+  const auto data = reinterpret_cast<const uint8_t *>(&telemetry);
+  Enqueue({Call::Type::TELEMETRY, service_id, 0, 0,
+           std::vector<uint8_t>(data, data + sizeof(telemetry)), {}});
+}
+
+void CallbackExecutor::Enqueue(Call call) {
+  {
+    std::unique_lock lk{queue_mutex_};
+    if (stopped_) {
+      return;
+    }
+    // Only queued calls can be dropped. Blocking also waits for the calls
+    // taken by the executor, so that no more than queue_length are waiting
+    // for delivery.
+    const size_t backlog = options_.overflow_policy == OverflowPolicy::BLOCK
+                               ? queue_.size() + taken_
+                               : queue_.size();
+    if (call.IsDroppable() && backlog >= options_.queue_length) {
+      switch (options_.overflow_policy) {
+        case OverflowPolicy::DROP_OLDEST: {
+          const auto oldest = std::find_if(
+            queue_.begin(), queue_.end(),
+            [](const Call &queued) { return queued.IsDroppable(); });
+          if (oldest == queue_.end()) {
+            // Only calls which can't be dropped, drop the new one
+            stats_.dropped++;
+            return;
+          }
+          queue_.erase(oldest);
+          stats_.dropped++;
+          break;
+        }
+        case OverflowPolicy::DROP_NEWEST:
+          stats_.dropped++;
+          return;
+        case OverflowPolicy::BLOCK:
+          if (!blocking_) {
+            break;
+          }
+          stats_.blocked++;
+          space_cv_.wait(lk, [this] {
+            return stopped_ || !blocking_ ||
+                   queue_.size() + taken_ < options_.queue_length;
+          });
+          if (stopped_) {
+            return;
+          }
+          break;
+      }
+    }
+    call.queued = std::chrono::steady_clock::now();
+    queue_.push_back(std::move(call));
+    stats_.queued++;
+  }
+  queue_cv_.notify_one();
+}
+
+void CallbackExecutor::Run() {
+  executor_thread_ = true;
+  std::deque<Call> calls{};
+  while (true) {
+    {
+      std::unique_lock lk{queue_mutex_};
+      queue_cv_.wait(lk, [this] { return stopped_ || !queue_.empty(); });
+      if (stopped_) {
+        break;
+      }
+      // Take all calls at once, so that Enqueue() does not wait for us
+      std::swap(calls, queue_);
+      taken_ = calls.size();
+    }
+    for (const auto &call: calls) {
+      if (!delivering_) {
+        break;
+      }
+      const uint64_t lag_micros =
+          std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - call.queued)
+          .count();
+      Deliver(call);
+      {
+        std::unique_lock lk{queue_mutex_};
+        taken_--;
+        stats_.delivered++;
+        stats_.lag_micros = lag_micros;
+        stats_.max_lag_micros = std::max(stats_.max_lag_micros, lag_micros);
+      }
+      space_cv_.notify_all();
+    }
+    calls.clear();
+  }
+}
+
+void CallbackExecutor::Deliver(const Call &call) {
+  switch (call.type) {
+    case Call::Type::SERVICE_CONNECTED:
+      callbacks_->OnServiceConnected(call.service_id);
+      break;
+    case Call::Type::TRANSACTION_START:
+      callbacks_->OnTransactionStart(call.service_id, call.timestamp);
+      break;
+    case Call::Type::TRANSACTION_END:
+      callbacks_->OnTransactionEnd(call.service_id);
+      break;
+    case Call::Type::DATA:
+      callbacks_->OnData(call.service_id, call.timestamp, call.target_id,
+                         call.payload.data(), call.payload.size());
+      break;
+    case Call::Type::CONFIGURATION_REQUESTED: {
+      const bool handled = callbacks_->OnConfigurationRequested(call.service_id);
+      if (configuration_answered_) {
+        configuration_answered_(call.service_id, handled);
+      }
+      break;
+    }
+    case Call::Type::SERVICE_DISCONNECTED:
+      callbacks_->OnServiceDisconnected(call.service_id);
+      break;
+    case Call::Type::TELEMETRY: {
+      datatypes::TelemetryPayload telemetry{};
+      memcpy(&telemetry, call.payload.data(), sizeof(telemetry));
+      callbacks_->OnTelemetry(call.service_id, telemetry);
+      break;
+    }
+  }
+}
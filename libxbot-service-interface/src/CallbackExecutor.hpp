@@ -0,0 +1,147 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef CALLBACKEXECUTOR_HPP
+#define CALLBACKEXECUTOR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <xbot-service-interface/ServiceIO.hpp>
+
+namespace xbot::serviceif {
+ /**
+  * Calls a subscriber's callbacks from a thread of its own. Registered in its
+  * place, it queues all calls and returns right away.
+  *
+  * Its thread keeps it alive until it is stopped, so it needs to be owned by
+  * a shared_ptr.
+  */
+ class CallbackExecutor : public ServiceIOCallbacks,
+                          public std::enable_shared_from_this<CallbackExecutor> {
+ public:
+  // Called from the executor's thread with the subscriber's answer to a
+  // configuration request
+  using ConfigurationAnswered =
+      std::function<void(uint16_t service_id, bool handled)>;
+
+  CallbackExecutor(ServiceIOCallbacks *callbacks,
+                   const CallbackExecutorOptions &options,
+                   ConfigurationAnswered configuration_answered = {});
+
+  ~CallbackExecutor() override;
+
+  void Start();
+
+  // Deleted copy constructor
+  CallbackExecutor(CallbackExecutor &other) = delete;
+
+  // Deleted assignment operator
+  void operator=(const CallbackExecutor &) = delete;
+
+  /**
+   * Stops delivering, queued callbacks are dropped. Once this returns, the
+   * subscriber is not called anymore, unless it is called from the
+   * subscriber itself.
+   */
+  void Stop();
+
+  CallbackStats GetStats();
+
+  /**
+   * Allow or forbid blocking the receiving threads with
+   * OverflowPolicy::BLOCK. While forbidden, calls are queued beyond
+   * queue_length instead.
+   */
+  void SetBlocking(bool blocking);
+
+  /**
+   * @return true, if called from the thread of any executor
+   */
+  static bool IsExecutorThread();
+
+  void OnServiceConnected(uint16_t service_id) override;
+
+  void OnTransactionStart(uint64_t timestamp) override;
+
+  void OnTransactionEnd() override;
+
+  void OnTransactionStart(uint16_t service_id, uint64_t timestamp) override;
+
+  void OnTransactionEnd(uint16_t service_id) override;
+
+  void OnData(uint16_t service_id, uint64_t timestamp, uint16_t target_id,
+              const void *payload, size_t buflen) override;
+
+  bool OnConfigurationRequested(uint16_t service_id) override;
+
+  void OnServiceDisconnected(uint16_t service_id) override;
+
+  void OnTelemetry(uint16_t service_id,
+                   const datatypes::TelemetryPayload &telemetry) override;
+
+ private:
+  struct Call {
+   enum class Type : uint8_t {
+    SERVICE_CONNECTED,
+    TRANSACTION_START,
+    TRANSACTION_END,
+    DATA,
+    CONFIGURATION_REQUESTED,
+    SERVICE_DISCONNECTED,
+    TELEMETRY,
+   };
+
+   Type type;
+   uint16_t service_id;
+   uint16_t target_id;
+   uint64_t timestamp;
+   // Data payload or the TelemetryPayload
+   std::vector<uint8_t> payload;
+   std::chrono::steady_clock::time_point queued;
+
+   // Data and telemetry may be dropped, the rest keeps the subscriber's
+   // state consistent
+   bool IsDroppable() const {
+    return type == Type::DATA || type == Type::TELEMETRY;
+   }
+  };
+
+  ServiceIOCallbacks *const callbacks_;
+  const CallbackExecutorOptions options_;
+  const ConfigurationAnswered configuration_answered_;
+
+  std::mutex queue_mutex_{};
+  // Signaled when calls are queued
+  std::condition_variable queue_cv_{};
+  // Signaled when the executor takes calls from the queue
+  std::condition_variable space_cv_{};
+  std::deque<Call> queue_{};
+  // Calls taken from the queue, which were not delivered yet
+  size_t taken_{0};
+  bool stopped_{false};
+  // See SetBlocking()
+  bool blocking_{true};
+  // Checked before each delivery, so that Stop() does not wait for the
+  // rest of the taken calls
+  std::atomic<bool> delivering_{true};
+  CallbackStats stats_{};
+
+  std::thread thread_{};
+
+  void Enqueue(Call call);
+
+  void Run();
+
+  void Deliver(const Call &call);
+ };
+}  // namespace xbot::serviceif
+
+#endif  // CALLBACKEXECUTOR_HPP
@@ -4,102 +4,95 @@
 
 #include "PlotJugglerBridge.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 #include "spdlog/spdlog.h"
 
 using namespace xbot::serviceif;
 
-// Function pointer for our raw conversion functions
-typedef nlohmann::json (*ToJson)(const void *, size_t);
-
-nlohmann::json CharToJson(const void *data, size_t len) {
-  auto c_str = static_cast<const char *>(data);
-  size_t effectiveLength = std::min(len, strnlen(c_str, len));
+namespace {
+nlohmann::json DecodeString(const uint8_t *data, size_t len) {
+  auto c_str = reinterpret_cast<const char *>(data);
+  size_t effectiveLength = strnlen(c_str, len);
   return std::string{c_str, effectiveLength};
 }
 
-nlohmann::json UIntToJson(const void *data, size_t len) {
-  switch (len) {
-    case sizeof(uint8_t): {
-      auto ptr = static_cast<const uint8_t *>(data);
-      return *ptr;
-    }
-    case sizeof(uint16_t): {
-      auto ptr = static_cast<const uint16_t *>(data);
-      return *ptr;
-    }
-    case sizeof(uint32_t): {
-      auto ptr = static_cast<const uint32_t *>(data);
-      return *ptr;
-    }
-    default:
-      throw std::runtime_error("Invalid unsigned int size.");
-  }
+nlohmann::json DecodeCbor(const uint8_t *data, size_t len) {
+  return nlohmann::json::from_cbor(data, data + len, false);
 }
 
-nlohmann::json IntToJson(const void *data, size_t len) {
-  switch (len) {
-    case sizeof(int8_t): {
-      auto ptr = static_cast<const int8_t *>(data);
-      return *ptr;
-    }
-    case sizeof(int16_t): {
-      auto ptr = static_cast<const int16_t *>(data);
-      return *ptr;
-    }
-    case sizeof(int32_t): {
-      auto ptr = static_cast<const int32_t *>(data);
-      return *ptr;
-    }
-    default:
-      throw std::runtime_error("Invalid int size.");
-  }
+// Payloads are not aligned, copy the values out
+template <typename T>
+nlohmann::json DecodeScalar(const uint8_t *data, size_t len) {
+  T value;
+  memcpy(&value, data, sizeof(T));
+  return value;
 }
 
-nlohmann::json FloatToJson(const void *data, size_t len) {
-  switch (len) {
-    case sizeof(float): {
-      auto *ptr = static_cast<const float *>(data);
-      return *ptr;
-    }
-    case sizeof(double): {
-      auto *ptr = static_cast<const double *>(data);
-      return *ptr;
-    }
-    default:
-      throw std::runtime_error("Invalid float size.");
+template <typename T>
+nlohmann::json DecodeArray(const uint8_t *data, size_t len) {
+  nlohmann::json::array_t values{};
+  values.reserve(len / sizeof(T));
+  for (size_t offset = 0; offset + sizeof(T) <= len; offset += sizeof(T)) {
+    T value;
+    memcpy(&value, data + offset, sizeof(T));
+    values.emplace_back(value);
   }
+  return values;
+}
+
+struct RawType {
+  const char *name;
+  nlohmann::json (*scalar)(const uint8_t *, size_t);
+  nlohmann::json (*array)(const uint8_t *, size_t);
+  size_t size;
+};
+
+template <typename T>
+constexpr RawType MakeRawType(const char *name) {
+  return {name, DecodeScalar<T>, DecodeArray<T>, sizeof(T)};
 }
 
 /**
- * Supported types for RAW -> JSON translation
+ * Supported types for raw decoding, char is decoded as string
  */
-const std::map<std::string, ToJson> conversion_fn_map{
-  {"char", CharToJson}, {"uint8_t", UIntToJson}, {"uint16_t", UIntToJson},
-  {"uint32_t", UIntToJson}, {"int8_t", IntToJson}, {"int16_t", IntToJson},
-  {"int32_t", IntToJson}, {"float", FloatToJson}, {"double", FloatToJson},
-};
-const std::map<std::string, size_t> type_size_map{
-  {"char", sizeof(char)}, {"uint8_t", sizeof(uint8_t)},
-  {"uint16_t", sizeof(uint16_t)}, {"uint32_t", sizeof(uint32_t)},
-  {"int8_t", sizeof(int8_t)}, {"int16_t", sizeof(int16_t)},
-  {"int32_t", sizeof(int32_t)}, {"float", sizeof(float)},
-  {"double", sizeof(float)},
+constexpr RawType raw_types[]{
+  MakeRawType<uint8_t>("uint8_t"), MakeRawType<uint16_t>("uint16_t"),
+  MakeRawType<uint32_t>("uint32_t"), MakeRawType<int8_t>("int8_t"),
+  MakeRawType<int16_t>("int16_t"), MakeRawType<int32_t>("int32_t"),
+  MakeRawType<float>("float"), MakeRawType<double>("double"),
 };
+}  // namespace
 
 PlotJugglerBridge::~PlotJugglerBridge() { ctx.io->UnregisterCallbacks(this); }
 
 bool PlotJugglerBridge::OnServiceDiscovered(uint16_t service_id) {
-  // Query the service description and add build the map
-  std::unique_lock lk{state_mutex_};
-
+  // Query the service description and compile the decoders
   const auto info = ctx.serviceDiscovery->GetServiceInfo(service_id);
-  for (const auto &output: info->description.outputs) {
-    topic_map_[std::make_pair(service_id, output.id)] = output;
+  if (info == nullptr) {
+    return false;
+  }
+
+  {
+    std::unique_lock lk{state_mutex_};
+    auto &topics = services_[service_id];
+    topics.key = std::to_string(service_id);
+    topics.decoders.clear();
+    topics.pending = nullptr;
+    for (const auto &output: info->description.outputs) {
+      if (output.id >= topics.decoders.size()) {
+        topics.decoders.resize(output.id + 1);
+      }
+      topics.decoders[output.id] = CompileDecoder(output);
+    }
   }
 
   // We are interested in all discovered services, so we register us with the
-  // ServiceIO as soon as a new service is discovered
-  ctx.io->RegisterCallbacks(service_id, this);
+  // ServiceIO as soon as a new service is discovered. Converting to JSON is
+  // slow, do it on a thread of our own so that we don't delay receiving.
+  // Dropping the oldest samples keeps the plots current.
+  ctx.io->RegisterCallbacks(service_id, this, CallbackExecutorOptions{});
   return true;
 }
 
@@ -115,70 +108,83 @@ void PlotJugglerBridge::OnServiceConnected(uint16_t service_id) {
 }
 
 void PlotJugglerBridge::OnTransactionStart(uint64_t timestamp) {
+  // Not called, ServiceIO calls the overload with the service_id
 }
 
 void PlotJugglerBridge::OnTransactionEnd() {
+  // Not called, ServiceIO calls the overload with the service_id
+}
+
+void PlotJugglerBridge::OnTransactionStart(uint16_t service_id,
+                                           uint64_t timestamp) {
+  std::unique_lock lk{state_mutex_};
+  if (const auto it = services_.find(service_id); it != services_.end()) {
+    it->second.open_transactions++;
+  }
+}
+
+void PlotJugglerBridge::OnTransactionEnd(uint16_t service_id) {
+  std::unique_lock lk{state_mutex_};
+  const auto it = services_.find(service_id);
+  if (it == services_.end()) {
+    return;
+  }
+  auto &topics = it->second;
+  if (topics.open_transactions > 0) {
+    topics.open_transactions--;
+  }
+  if (topics.open_transactions == 0) {
+    FlushPending(topics);
+  }
 }
 
 void PlotJugglerBridge::OnData(uint16_t service_id, uint64_t timestamp,
                                uint16_t target_id, const void *payload,
                                size_t buflen) {
   std::unique_lock lk{state_mutex_};
-  // Find the output description
-  const auto &it = topic_map_.find(std::make_pair(service_id, target_id));
-  if (it == topic_map_.end()) {
+  // Find the output's decoder
+  const auto it = services_.find(service_id);
+  if (it == services_.end() || target_id >= it->second.decoders.size() ||
+      it->second.decoders[target_id].name.empty()) {
     spdlog::warn("PJB: Data packet with invalid ID");
     return;
   }
-
-  const auto &output = it->second;
-
-  nlohmann::json data;
-  if (output.encoding == "zcbor") {
-    // Try parse the CBOR and send it
-    try {
-      // Build the JSON and send it
-      data = nlohmann::json::from_cbor(static_cast<const uint8_t *>(payload),
-                                       false);
-    } catch (std::exception &e) {
-      spdlog::warn("Exception parsing CBOR data: {}", e.what());
-    }
-  } else if (output.encoding.empty() || output.encoding == "raw") {
-    // Raw encoding, find conversion function and call it
-    if (!conversion_fn_map.contains(output.type)) {
-      spdlog::error("Error, conversion function for type {}", output.type);
-      return;
-    }
-    const auto &fn = conversion_fn_map.at(output.type);
-    if (!output.is_array) {
-      // convert
-      data = fn(payload, buflen);
-    } else {
-      // Get the itme size
-      if (!type_size_map.contains(output.type)) {
-        spdlog::error("Error, no size info for type {}", output.type);
-        return;
-      }
-      size_t item_size = type_size_map.at(output.type);
-      size_t array_len =
-          std::min(buflen / item_size, static_cast<size_t>(output.maxlen));
-      for (size_t i = 0; i < array_len; i++) {
-        data[i] =
-            fn(static_cast<const uint8_t *>(payload) + i * item_size, item_size);
-      }
-    }
+  auto &topics = it->second;
+  const auto &decoder = topics.decoders[target_id];
+  if (decoder.decode == nullptr) {
+    return;
+  }
+  if (buflen < decoder.min_size) {
+    spdlog::warn("PJB: Data packet for {} too short", decoder.name);
+    return;
+  }
+  if (decoder.max_size > 0) {
+    buflen = std::min(buflen, decoder.max_size);
   }
 
+  nlohmann::json data;
   try {
-    nlohmann::json json = nlohmann::json::object(
-      {{std::to_string(service_id), {{output.name, {{"stamp", timestamp}, {"data", data}}}}}});
-    std::string dump = json.dump(2);
-    socket_.TransmitPacket("127.0.0.1", 9870,
-                           reinterpret_cast<const uint8_t *>(dump.c_str()),
-                           dump.size());
+    data = decoder.decode(static_cast<const uint8_t *>(payload), buflen);
   } catch (std::exception &e) {
-    spdlog::error("PJB: Error encoding JSON: {}", e.what());
+    spdlog::warn("PJB: Exception decoding {}: {}", decoder.name, e.what());
+    return;
   }
+
+  if (topics.open_transactions == 0) {
+    nlohmann::json message = nlohmann::json::object();
+    message[topics.key][decoder.name] = {{"stamp", timestamp},
+                                         {"data", std::move(data)}};
+    Send(message);
+    return;
+  }
+
+  // Collect the outputs of the transaction, a new timestamp is the next one
+  if (!topics.pending.is_null() && topics.pending_timestamp != timestamp) {
+    FlushPending(topics);
+  }
+  topics.pending_timestamp = timestamp;
+  topics.pending[decoder.name] = {{"stamp", timestamp},
+                                  {"data", std::move(data)}};
 }
 
 void PlotJugglerBridge::OnServiceDisconnected(uint16_t service_id) {
@@ -189,7 +195,9 @@ bool PlotJugglerBridge::OnConfigurationRequested(uint16_t service_id) {
   return false;
 }
 
-PlotJugglerBridge::PlotJugglerBridge(xbot::serviceif::Context ctx) : ctx(ctx) {
+PlotJugglerBridge::PlotJugglerBridge(xbot::serviceif::Context ctx,
+                                     PlotJugglerEncoding encoding)
+  : encoding_(encoding), ctx(ctx) {
 }
 
 bool PlotJugglerBridge::Start() {
@@ -197,3 +205,71 @@ bool PlotJugglerBridge::Start() {
   ctx.serviceDiscovery->RegisterCallbacks(this);
   return true;
 }
+
+PlotJugglerBridge::TopicDecoder PlotJugglerBridge::CompileDecoder(
+  const ServiceIOInfo &output) {
+  TopicDecoder decoder{.name = output.name};
+  if (output.encoding == "zcbor") {
+    decoder.decode = DecodeCbor;
+    return decoder;
+  }
+  if (!output.encoding.empty() && output.encoding != "raw") {
+    spdlog::error("PJB: Unsupported encoding {} for {}", output.encoding,
+                  output.name);
+    return decoder;
+  }
+  if (output.type == "char") {
+    decoder.decode = DecodeString;
+    decoder.max_size = output.is_array ? output.maxlen : 0;
+    return decoder;
+  }
+  for (const auto &type: raw_types) {
+    if (output.type != type.name) {
+      continue;
+    }
+    if (output.is_array) {
+      decoder.decode = type.array;
+      decoder.max_size = type.size * output.maxlen;
+    } else {
+      decoder.decode = type.scalar;
+      decoder.min_size = type.size;
+      decoder.max_size = type.size;
+    }
+    return decoder;
+  }
+  spdlog::error("PJB: No conversion function for type {}", output.type);
+  return decoder;
+}
+
+void PlotJugglerBridge::FlushPending(ServiceTopics &topics) {
+  if (topics.pending.is_null()) {
+    return;
+  }
+  nlohmann::json message = nlohmann::json::object();
+  message[topics.key] = std::move(topics.pending);
+  topics.pending = nullptr;
+  Send(message);
+}
+
+void PlotJugglerBridge::Send(const nlohmann::json &message) {
+  try {
+    send_buffer_.clear();
+    switch (encoding_) {
+      case PlotJugglerEncoding::JSON: {
+        const std::string dump = message.dump();
+        send_buffer_.assign(dump.begin(), dump.end());
+        break;
+      }
+      case PlotJugglerEncoding::CBOR:
+        nlohmann::json::to_cbor(message, send_buffer_);
+        break;
+      case PlotJugglerEncoding::MESSAGE_PACK:
+        nlohmann::json::to_msgpack(message, send_buffer_);
+        break;
+    }
+  } catch (std::exception &e) {
+    spdlog::error("PJB: Error encoding message: {}", e.what());
+    return;
+  }
+  socket_.TransmitPacket("127.0.0.1", 9870, send_buffer_);
+}
@@ -5,6 +5,8 @@
 #ifndef PLOTJUGGLERBRIDGE_HPP
 #define PLOTJUGGLERBRIDGE_HPP
 
+#include <unordered_map>
+#include <vector>
 #include <xbot-service-interface/ServiceDiscovery.hpp>
 #include <xbot-service-interface/ServiceIO.hpp>
 #include <xbot-service-interface/Socket.hpp>
@@ -18,19 +20,22 @@ using namespace xbot;
  *
  * It will listen for any nodes detected and redirect the data.
  *
- * Output data is UDP as JSON.
+ * Output data is UDP as JSON, CBOR or MessagePack (see PlotJugglerEncoding).
+ * The outputs of a transaction are sent in a single message.
  *
- * The JSON has the following format:
+ * The message has the following format:
  * {
  *  "service_id": {
- *    "input_name": { "the": "actual data" }
+ *    "output_name": { "stamp": timestamp, "data": "the actual data" }
  *  }
  * }
  */
 class PlotJugglerBridge : public serviceif::ServiceDiscoveryCallbacks,
                           public serviceif::ServiceIOCallbacks {
 public:
- explicit PlotJugglerBridge(xbot::serviceif::Context ctx);
+ explicit PlotJugglerBridge(
+  xbot::serviceif::Context ctx,
+  serviceif::PlotJugglerEncoding encoding = serviceif::PlotJugglerEncoding::JSON);
 
  ~PlotJugglerBridge() override;
 
@@ -47,6 +52,10 @@ public:
 
  void OnTransactionEnd() override;
 
+ void OnTransactionStart(uint16_t service_id, uint64_t timestamp) override;
+
+ void OnTransactionEnd(uint16_t service_id) override;
+
  void OnData(uint16_t service_id, uint64_t timestamp, uint16_t target_id,
              const void *payload, size_t buflen) override;
 
@@ -55,11 +64,47 @@ public:
  bool OnConfigurationRequested(uint16_t service_id) override;
 
 private:
+ // Converts the raw payload of an output
+ typedef nlohmann::json (*DecodeFn)(const uint8_t *data, size_t len);
+
+ /**
+  * How to decode an output, compiled once when its service is discovered.
+  */
+ struct TopicDecoder {
+  std::string name{};
+  // nullptr, if the output can't be decoded
+  DecodeFn decode{nullptr};
+  // Payloads shorter than this are invalid
+  size_t min_size{};
+  // Longer payloads are cut, 0 for no limit
+  size_t max_size{};
+ };
+
+ struct ServiceTopics {
+  // The service_id as string, our key in the message
+  std::string key{};
+  // Indexed by output id
+  std::vector<TopicDecoder> decoders{};
+  // The outputs are collected while a transaction of the service is open.
+  // Transactions of other services don't delay them.
+  uint32_t open_transactions{0};
+  // Outputs of the open transaction, not sent yet
+  nlohmann::json pending{};
+  uint64_t pending_timestamp{};
+ };
+
  std::mutex state_mutex_{};
- // Stores a map of <uid, output> pairs to quickly find the ServiceIOInfo
- std::map<std::pair<uint16_t, uint16_t>, ServiceIOInfo> topic_map_{};
+ std::unordered_map<uint16_t, ServiceTopics> services_{};
  serviceif::Socket socket_{"0.0.0.0"};
+ const serviceif::PlotJugglerEncoding encoding_;
+ std::vector<uint8_t> send_buffer_{};
 
  const serviceif::Context ctx;
+
+ static TopicDecoder CompileDecoder(const ServiceIOInfo &output);
+
+ void FlushPending(ServiceTopics &topics);
+
+ void Send(const nlohmann::json &message);
 };
 #endif  // PLOTJUGGLERBRIDGE_HPP
@@ -0,0 +1,381 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include "RemoteLogImpl.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <xbot/config.hpp>
+
+using namespace xbot::serviceif;
+using namespace xbot::datatypes;
+
+namespace {
+RemoteLogImpl *remote_log_instance_ = nullptr;
+std::mutex remote_log_instance_mutex_{};
+
+spdlog::level::level_enum ToSpdlogLevel(LogLevel level) {
+  switch (level) {
+    case LogLevel::TRACE_LEVEL:
+      return spdlog::level::trace;
+    case LogLevel::DEBUG_LEVEL:
+      return spdlog::level::debug;
+    case LogLevel::WARNING_LEVEL:
+      return spdlog::level::warn;
+    case LogLevel::ERROR_LEVEL:
+      return spdlog::level::err;
+    case LogLevel::CRITICAL_LEVEL:
+      return spdlog::level::critical;
+    default:
+      return spdlog::level::info;
+  }
+}
+
+template <typename T>
+void AppendFormatted(std::string &out, const std::string &spec, T value) {
+  const int length = snprintf(nullptr, 0, spec.c_str(), value);
+  if (length <= 0) {
+    return;
+  }
+  const size_t old_size = out.size();
+  out.resize(old_size + length + 1);
+  snprintf(out.data() + old_size, length + 1, spec.c_str(), value);
+  out.resize(old_size + length);
+}
+
+/**
+ * Reads the encoded record arguments one by one.
+ */
+class ArgReader {
+ public:
+  ArgReader(const uint8_t *args, size_t args_len) : args_(args), end_(args + args_len) {}
+
+  bool Next(LogArgType &type, uint64_t &value, std::string_view &str) {
+    if (args_ >= end_) return false;
+    type = static_cast<LogArgType>(*args_++);
+    if (type == LogArgType::STRING) {
+      if (args_ >= end_) return false;
+      const uint8_t length = *args_++;
+      if (end_ - args_ < length) return false;
+      str = std::string_view(reinterpret_cast<const char *>(args_), length);
+      args_ += length;
+      return true;
+    }
+    if (end_ - args_ < static_cast<ptrdiff_t>(sizeof(value))) return false;
+    memcpy(&value, args_, sizeof(value));
+    args_ += sizeof(value);
+    return true;
+  }
+
+ private:
+  const uint8_t *args_;
+  const uint8_t *const end_;
+};
+
+/**
+ * Formats a record like printf would have on the service. Length modifiers
+ * in the format are ignored, the arguments carry their own types.
+ */
+std::string FormatRecord(std::string_view format, const uint8_t *args, size_t args_len) {
+  ArgReader reader{args, args_len};
+  std::string result{};
+  for (size_t i = 0; i < format.size(); i++) {
+    if (format[i] != '%') {
+      result += format[i];
+      continue;
+    }
+    if (i + 1 < format.size() && format[i + 1] == '%') {
+      result += '%';
+      i++;
+      continue;
+    }
+
+    // Parse flags, width and precision. Limit width and precision to 3
+    // digits, so that a broken format can't make us allocate huge strings.
+    std::string spec = "%";
+    size_t pos = i + 1;
+    while (pos < format.size() && strchr("-+ #0", format[pos]) != nullptr) spec += format[pos++];
+    for (int digits = 0; pos < format.size() && isdigit(format[pos]); digits++, pos++) {
+      if (digits < 3) spec += format[pos];
+    }
+    if (pos < format.size() && format[pos] == '.') {
+      spec += format[pos++];
+      for (int digits = 0; pos < format.size() && isdigit(format[pos]); digits++, pos++) {
+        if (digits < 3) spec += format[pos];
+      }
+    }
+    while (pos < format.size() && strchr("hljztL", format[pos]) != nullptr) pos++;
+    if (pos >= format.size()) {
+      // Incomplete conversion, print as is
+      result.append(format.substr(i));
+      break;
+    }
+    const char conversion = format[pos];
+    i = pos;
+
+    LogArgType type;
+    uint64_t value = 0;
+    std::string_view str{};
+    if (!reader.Next(type, value, str)) {
+      result += "<missing>";
+      continue;
+    }
+    const bool float_conversion = strchr("eEfFgGaA", conversion) != nullptr;
+    const bool int_conversion = strchr("diouxXc", conversion) != nullptr;
+    switch (type) {
+      case LogArgType::INT:
+        if (float_conversion) {
+          AppendFormatted(result, spec + conversion, static_cast<double>(static_cast<int64_t>(value)));
+        } else if (conversion == 'c') {
+          AppendFormatted(result, spec + 'c', static_cast<int>(value));
+        } else {
+          AppendFormatted(result, spec + "ll" + (int_conversion ? conversion : 'd'), static_cast<long long>(value));
+        }
+        break;
+      case LogArgType::UINT:
+        if (float_conversion) {
+          AppendFormatted(result, spec + conversion, static_cast<double>(value));
+        } else if (conversion == 'c') {
+          AppendFormatted(result, spec + 'c', static_cast<int>(value));
+        } else {
+          // Don't print unsigned values as negative numbers
+          const char c = int_conversion && conversion != 'd' && conversion != 'i' ? conversion : 'u';
+          AppendFormatted(result, spec + "ll" + c, static_cast<unsigned long long>(value));
+        }
+        break;
+      case LogArgType::DOUBLE: {
+        double d;
+        memcpy(&d, &value, sizeof(d));
+        AppendFormatted(result, spec + (float_conversion ? conversion : 'g'), d);
+        break;
+      }
+      case LogArgType::STRING:
+        AppendFormatted(result, spec + 's', std::string(str).c_str());
+        break;
+      case LogArgType::POINTER:
+        AppendFormatted(result, spec + 'p', reinterpret_cast<void *>(static_cast<uintptr_t>(value)));
+        break;
+      default:
+        result += "<invalid>";
+        break;
+    }
+  }
+  return result;
+}
+}  // namespace
+
+RemoteLogImpl *RemoteLogImpl::GetInstance() {
+  std::unique_lock lk{remote_log_instance_mutex_};
+  if (remote_log_instance_ == nullptr) {
+    remote_log_instance_ = new RemoteLogImpl();
+  }
+  return remote_log_instance_;
+}
+
+bool RemoteLogImpl::Start() {
+  {
+    std::unique_lock lk{queue_mutex_};
+    if (!stopped_) {
+      return true;
+    }
+    stopped_ = false;
+  }
+  const auto &sinks = spdlog::default_logger()->sinks();
+  logger_ = std::make_shared<spdlog::logger>("remote", sinks.begin(), sinks.end());
+  logger_->set_level(spdlog::level::trace);
+  log_thread_ = std::thread{&RemoteLogImpl::RunLog, this};
+  return true;
+}
+
+bool RemoteLogImpl::Stop() {
+  {
+    std::unique_lock lk{queue_mutex_};
+    if (stopped_) {
+      return true;
+    }
+    stopped_ = true;
+  }
+  queue_cv_.notify_all();
+  log_thread_.join();
+  return true;
+}
+
+void RemoteLogImpl::RegisterCallbacks(RemoteLogCallbacks *callbacks) {
+  std::unique_lock lk{callbacks_mutex_};
+  if (std::find(registered_callbacks_.begin(), registered_callbacks_.end(), callbacks) ==
+      registered_callbacks_.end()) {
+    registered_callbacks_.push_back(callbacks);
+  }
+}
+
+void RemoteLogImpl::UnregisterCallbacks(RemoteLogCallbacks *callbacks) {
+  std::unique_lock lk{callbacks_mutex_};
+  std::erase(registered_callbacks_, callbacks);
+}
+
+RemoteLogStats RemoteLogImpl::GetStats() {
+  std::unique_lock lk{stats_mutex_};
+  return stats_;
+}
+
+bool RemoteLogImpl::Ingest(const XbotHeader *header, const uint8_t *payload) {
+  bool dropped;
+  {
+    std::unique_lock lk{queue_mutex_};
+    dropped = stopped_ || queue_.size() >= config::serviceif::remote_log_queue_length;
+    if (!dropped) {
+      auto &message = queue_.emplace_back(sizeof(XbotHeader) + header->payload_size);
+      memcpy(message.data(), header, sizeof(XbotHeader));
+      memcpy(message.data() + sizeof(XbotHeader), payload, header->payload_size);
+    }
+  }
+  if (!dropped) {
+    queue_cv_.notify_one();
+  }
+  std::unique_lock lk{stats_mutex_};
+  stats_.received_messages++;
+  if (dropped) {
+    stats_.dropped_messages++;
+  }
+  return !dropped;
+}
+
+void RemoteLogImpl::RunLog() {
+  std::deque<std::vector<uint8_t> > messages{};
+  while (true) {
+    {
+      std::unique_lock lk{queue_mutex_};
+      queue_cv_.wait(lk, [this] { return stopped_ || !queue_.empty(); });
+      if (stopped_) {
+        break;
+      }
+      // Take all messages at once, so that Ingest() does not wait for us
+      std::swap(messages, queue_);
+    }
+    for (const auto &message : messages) {
+      ProcessMessage(message);
+    }
+    messages.clear();
+  }
+}
+
+void RemoteLogImpl::ProcessMessage(const std::vector<uint8_t> &message) {
+  const auto header = reinterpret_cast<const XbotHeader *>(message.data());
+  const uint8_t *payload = message.data() + sizeof(XbotHeader);
+  const size_t payload_len = message.size() - sizeof(XbotHeader);
+  switch (static_cast<LogEncoding>(header->arg2)) {
+    case LogEncoding::TEXT: {
+      if (!CheckRateLimit(header->service_id)) {
+        return;
+      }
+      RemoteLogRecord record{};
+      record.service_id = header->service_id;
+      record.level = static_cast<LogLevel>(header->arg1);
+      record.timestamp = header->timestamp;
+      record.message = std::string(reinterpret_cast<const char *>(payload), strnlen(reinterpret_cast<const char *>(payload), payload_len));
+      Deliver(std::move(record));
+      break;
+    }
+    case LogEncoding::RECORDS:
+      ProcessRecords(payload, payload_len);
+      break;
+    default: {
+      std::unique_lock lk{stats_mutex_};
+      stats_.invalid_messages++;
+      break;
+    }
+  }
+}
+
+void RemoteLogImpl::ProcessRecords(const uint8_t *payload, size_t payload_len) {
+  // Format strings are only valid within a single message
+  std::string_view formats[UINT8_MAX + 1]{};
+  size_t pos = 0;
+  while (pos + sizeof(LogEntryHeader) <= payload_len) {
+    LogEntryHeader entry;
+    memcpy(&entry, payload + pos, sizeof(entry));
+    pos += sizeof(entry);
+    if (pos + entry.length > payload_len) {
+      break;
+    }
+    const uint8_t *const data = payload + pos;
+    pos += entry.length;
+
+    switch (entry.type) {
+      case LogEntryType::FORMAT:
+        formats[entry.format_id] = std::string_view(reinterpret_cast<const char *>(data), entry.length);
+        break;
+      case LogEntryType::RECORD: {
+        if (entry.length < sizeof(LogRecordHeader)) {
+          continue;
+        }
+        LogRecordHeader record_header;
+        memcpy(&record_header, data, sizeof(record_header));
+        if (!CheckRateLimit(record_header.service_id)) {
+          continue;
+        }
+        RemoteLogRecord record{};
+        record.service_id = record_header.service_id;
+        record.level = record_header.level;
+        record.timestamp = record_header.timestamp;
+        record.message = FormatRecord(formats[entry.format_id], data + sizeof(LogRecordHeader),
+                                      entry.length - sizeof(LogRecordHeader));
+        Deliver(std::move(record));
+        break;
+      }
+      case LogEntryType::DROPPED:
+        if (entry.length == sizeof(uint32_t)) {
+          uint32_t count;
+          memcpy(&count, data, sizeof(count));
+          std::unique_lock lk{stats_mutex_};
+          stats_.sender_dropped_records += count;
+        }
+        break;
+      default:
+        // Unknown entry, skip it
+        break;
+    }
+  }
+  if (pos != payload_len) {
+    std::unique_lock lk{stats_mutex_};
+    stats_.invalid_messages++;
+  }
+}
+
+void RemoteLogImpl::Deliver(RemoteLogRecord &&record) {
+  logger_->log(ToSpdlogLevel(record.level), "[service {}] {}", record.service_id, record.message);
+  {
+    std::unique_lock lk{callbacks_mutex_};
+    for (const auto &cb : registered_callbacks_) {
+      cb->OnLogRecord(record);
+    }
+  }
+  std::unique_lock lk{stats_mutex_};
+  stats_.records++;
+}
+
+bool RemoteLogImpl::CheckRateLimit(uint16_t service_id) {
+  const auto now = std::chrono::steady_clock::now();
+  auto [it, inserted] =
+      rate_limits_.try_emplace(service_id, RateLimit{config::serviceif::remote_log_burst, now});
+  RateLimit &limit = it->second;
+  if (!inserted) {
+    const double elapsed_seconds = std::chrono::duration<double>(now - limit.last_update).count();
+    limit.tokens = std::min<double>(
+        config::serviceif::remote_log_burst,
+        limit.tokens + elapsed_seconds * config::serviceif::remote_log_max_records_per_second);
+    limit.last_update = now;
+  }
+  if (limit.tokens >= 1.0) {
+    limit.tokens -= 1.0;
+    return true;
+  }
+  std::unique_lock lk{stats_mutex_};
+  stats_.rate_limited_records++;
+  stats_.rate_limited_records_per_service[service_id]++;
+  return false;
+}
@@ -0,0 +1,80 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef REMOTELOGIMPL_HPP
+#define REMOTELOGIMPL_HPP
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <xbot-service-interface/RemoteLog.hpp>
+#include <xbot/datatypes/XbotHeader.hpp>
+
+namespace xbot::serviceif {
+ class RemoteLogImpl : public RemoteLog {
+ public:
+  static RemoteLogImpl *GetInstance();
+
+  bool Start();
+
+  bool Stop();
+
+  void RegisterCallbacks(RemoteLogCallbacks *callbacks) override;
+
+  void UnregisterCallbacks(RemoteLogCallbacks *callbacks) override;
+
+  RemoteLogStats GetStats() override;
+
+  /**
+   * Queues a received LOG message for processing. Never blocks for longer
+   * than it takes to copy the message, drops the message if the queue is
+   * full.
+   * @return false, if the message was dropped
+   */
+  bool Ingest(const datatypes::XbotHeader *header, const uint8_t *payload);
+
+ private:
+  // Per service token bucket for rate limiting
+  struct RateLimit {
+   double tokens;
+   std::chrono::steady_clock::time_point last_update;
+  };
+
+  std::mutex queue_mutex_{};
+  std::condition_variable queue_cv_{};
+  std::deque<std::vector<uint8_t> > queue_{};
+  bool stopped_{true};
+
+  std::thread log_thread_{};
+  std::shared_ptr<spdlog::logger> logger_{};
+
+  std::mutex callbacks_mutex_{};
+  std::vector<RemoteLogCallbacks *> registered_callbacks_{};
+
+  // Protected by stats_mutex_
+  std::mutex stats_mutex_{};
+  RemoteLogStats stats_{};
+
+  // Only used by the log thread
+  std::map<uint16_t, RateLimit> rate_limits_{};
+
+  void RunLog();
+
+  void ProcessMessage(const std::vector<uint8_t> &message);
+
+  void ProcessRecords(const uint8_t *payload, size_t payload_len);
+
+  void Deliver(RemoteLogRecord &&record);
+
+  bool CheckRateLimit(uint16_t service_id);
+ };
+} // namespace xbot::serviceif
+
+#endif  // REMOTELOGIMPL_HPP
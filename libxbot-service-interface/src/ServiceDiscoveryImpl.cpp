@@ -4,13 +4,16 @@
 
 #include "ServiceDiscoveryImpl.hpp"
 
+#include <chrono>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <xbot-service-interface/Socket.hpp>
 #include <xbot-service-interface/data/ServiceInfo.hpp>
 #include <xbot/config.hpp>
+#include <xbot/datatypes/ServiceDescriptionHash.hpp>
 #include <xbot/datatypes/XbotHeader.hpp>
 
+#include "RemoteLogImpl.hpp"
 #include "spdlog/spdlog.h"
 
 namespace xbot::serviceif {
@@ -20,6 +23,12 @@ namespace xbot::serviceif {
   std::recursive_mutex sd_mutex_{};
   // Keep track of discovered servies and their endpoints.
   std::map<uint16_t, ServiceInfo> discovered_services_{};
+  // Descriptions by their hash, so that each one is only fetched and decoded once.
+  std::map<uint32_t, ServiceDescription> description_cache_{};
+  // Services waiting for the description of their hash.
+  std::map<uint16_t, ServiceInfo> pending_services_{};
+  // Time of the last query for each unknown hash.
+  std::map<uint32_t, std::chrono::steady_clock::time_point> pending_queries_{};
 
   std::mutex stopped_mtx_{};
   bool stopped_{false};
@@ -47,6 +56,8 @@ namespace xbot::serviceif {
     if (!sd_socket_.Start()) return false;
 
     if (!sd_socket_.JoinMulticast(config::sd_multicast_address)) return false;
+    // Services send their logs to a separate group on the same port
+    if (!sd_socket_.JoinMulticast(config::remote_log_multicast_address)) return false;
 
     // Start the ServiceDiscovery Thread
     {
@@ -100,6 +111,7 @@ namespace xbot::serviceif {
 
   bool ServiceDiscoveryImpl::DropService(uint16_t service_id) {
     std::unique_lock lk(sd_mutex_);
+    pending_services_.erase(service_id);
     return discovered_services_.erase(service_id) > 0;
   }
 
@@ -125,6 +137,130 @@ namespace xbot::serviceif {
     return true;
   }
 
+  // Adds a service with a known description, sd_mutex_ needs to be held.
+  static void AddService(const ServiceInfo &info) {
+    spdlog::info("Found new service (Type: {}, ID: {}, endpoint: {})", info.description.type, info.service_id_,
+                 EndpointIntToString(info.ip, info.port));
+    discovered_services_.emplace(info.service_id_, info);
+    // Notify callbacks
+    for (const auto &callback: registered_callbacks_) {
+      callback->OnServiceDiscovered(info.service_id_);
+    }
+  }
+
+  // Asks the service for its description, sd_mutex_ needs to be held.
+  static void QueryDescription(const ServiceInfo &info) {
+    const auto now = std::chrono::steady_clock::now();
+    if (const auto it = pending_queries_.find(info.description_hash);
+      it != pending_queries_.end() &&
+      now - it->second < std::chrono::microseconds(config::sd_query_retry_micros)) {
+      // Query is still in flight, the answer is multicast and completes all services with this hash
+      return;
+    }
+    pending_queries_[info.description_hash] = now;
+
+    datatypes::XbotHeader header{};
+    header.protocol_version = 1;
+    header.message_type = datatypes::MessageType::SERVICE_QUERY;
+    header.service_id = info.service_id_;
+    header.arg1 = 0;
+    header.payload_size = 0;
+    spdlog::debug("Querying description (ID: {}, hash: {:08x})", info.service_id_, info.description_hash);
+    sd_socket_.TransmitPacket(info.ip, info.port, reinterpret_cast<const uint8_t *>(&header), sizeof(header));
+  }
+
+  void HandleAdvertisement(const uint8_t *payload, size_t payload_size) {
+    try {
+      const auto json =
+          nlohmann::json::from_cbor(payload, payload + payload_size);
+
+      // Build the ServiceInfo object from the received data.
+      ServiceInfo info = json;
+
+      // Check for valid endpoint, if none is given the service is not
+      // reachable, so we drop it
+      if (info.ip == 0 || info.port == 0) {
+        spdlog::warn(
+          "Service registered with invalid endpoint. Ignoring. (ID: "
+          "{}, endpoint: {})",
+          info.service_id_, EndpointIntToString(info.ip, info.port));
+        return;
+      }
+
+      // Scope for locking the discovered_services_ map
+      {
+        std::unique_lock lk(sd_mutex_);
+        if (discovered_services_.contains(info.service_id_)) {
+          // Check, if service endpoint was updated
+          // (every thing else is constant) and update
+          if (auto &old_service_info = discovered_services_.at(info.service_id_);
+            old_service_info.ip != info.ip || old_service_info.port != info.port) {
+            spdlog::info("Endpoint updated (ID: {}, new endpoint: {})", info.service_id_,
+                         EndpointIntToString(info.ip, info.port));
+            // Backup the old infos, so that we can pass them to the
+            // callback
+            const auto old_ip = old_service_info.ip;
+            const auto old_port = old_service_info.port;
+
+            // Update the entry
+            old_service_info.ip = info.ip;
+            old_service_info.port = info.port;
+
+            // Notify callbacks
+            for (const auto &callback: registered_callbacks_) {
+              callback->OnEndpointChanged(info.service_id_, old_ip, old_port, info.ip, info.port);
+            }
+          }
+        } else if (json.contains("desc")) {
+          // Older service, which advertises the whole description
+          AddService(info);
+        } else if (const auto it = description_cache_.find(info.description_hash); it != description_cache_.end()) {
+          info.description = it->second;
+          pending_services_.erase(info.service_id_);
+          AddService(info);
+        } else {
+          pending_services_[info.service_id_] = info;
+          QueryDescription(info);
+        }
+      }
+    } catch (std::exception &e) {
+      spdlog::error("Got exception during service discovery: {}", e.what());
+    }
+  }
+
+  void HandleDescription(const datatypes::XbotHeader *header, const uint8_t *payload) {
+    if (header->arg1 != 1) {
+      // Not a response
+      return;
+    }
+    const uint32_t hash = datatypes::ServiceDescriptionHash(payload, header->payload_size);
+    std::unique_lock lk(sd_mutex_);
+    if (!pending_queries_.contains(hash)) {
+      // Answer to another interface's query or a duplicate, nothing to decode
+      return;
+    }
+    try {
+      ServiceDescription description = nlohmann::json::from_cbor(payload, payload + header->payload_size);
+      pending_queries_.erase(hash);
+      description_cache_[hash] = description;
+    } catch (std::exception &e) {
+      spdlog::error("Got exception decoding service description: {}", e.what());
+      return;
+    }
+
+    // Complete all services waiting for this description
+    for (auto it = pending_services_.begin(); it != pending_services_.end();) {
+      if (it->second.description_hash != hash) {
+        ++it;
+        continue;
+      }
+      ServiceInfo info = it->second;
+      it = pending_services_.erase(it);
+      info.description = description_cache_.at(hash);
+      AddService(info);
+    }
+  }
+
   void Run() {
     std::vector<uint8_t> packet{};
     uint32_t sender_ip;
@@ -138,72 +274,28 @@ namespace xbot::serviceif {
 
       // Try receive a packet, this will return false on timeout.
       if (sd_socket_.ReceivePacket(sender_ip, sender_port, packet)) {
-        // Check, if packet has at least enough space for our header
-        if (packet.size() >= sizeof(datatypes::XbotHeader)) {
-          const auto header = reinterpret_cast<datatypes::XbotHeader *>(packet.data());
+        // A datagram can contain multiple chained xBot packets.
+        size_t offset = 0;
+        while (packet.size() - offset >= sizeof(datatypes::XbotHeader)) {
+          const auto header = reinterpret_cast<datatypes::XbotHeader *>(packet.data() + offset);
+          const size_t packet_size = header->payload_size + sizeof(datatypes::XbotHeader);
 
-          if (header->message_type != datatypes::MessageType::SERVICE_ADVERTISEMENT) {
-            spdlog::warn("Service Discovery socket got non-service discovery message");
-            continue;
+          // Validate reported length
+          if (packet.size() - offset < packet_size) {
+            break;
           }
 
-          // Validate reported length
-          if (packet.size() == header->payload_size + sizeof(datatypes::XbotHeader)) {
-            try {
-              const auto json =
-                  nlohmann::json::from_cbor(packet.begin() + sizeof(datatypes::XbotHeader), packet.end());
-
-              // Build the ServiceInfo object from the received data.
-              ServiceInfo info = json;
-
-              // Check for valid endpoint, if none is given the service is not
-              // reachable, so we drop it
-              if (info.ip == 0 || info.port == 0) {
-                spdlog::warn(
-                  "Service registered with invalid endpoint. Ignoring. (ID: "
-                  "{}, endpoint: {})",
-                  info.service_id_, EndpointIntToString(info.ip, info.port));
-                continue;
-              }
-
-              // Scope for locking the discovered_services_ map
-              {
-                std::unique_lock lk(sd_mutex_);
-                if (discovered_services_.contains(info.service_id_)) {
-                  // Check, if service endpoint was updated
-                  // (every thing else is constant) and update
-                  if (auto &old_service_info = discovered_services_.at(info.service_id_);
-                    old_service_info.ip != info.ip || old_service_info.port != info.port) {
-                    spdlog::info("Endpoint updated (ID: {}, new endpoint: {})", info.service_id_,
-                                 EndpointIntToString(info.ip, info.port));
-                    // Backup the old infos, so that we can pass them to the
-                    // callback
-                    const auto old_ip = old_service_info.ip;
-                    const auto old_port = old_service_info.port;
-
-                    // Update the entry
-                    old_service_info.ip = info.ip;
-                    old_service_info.port = info.port;
-
-                    // Notify callbacks
-                    for (const auto &callback: registered_callbacks_) {
-                      callback->OnEndpointChanged(info.service_id_, old_ip, old_port, info.ip, info.port);
-                    }
-                  }
-                } else {
-                  spdlog::info("Found new service (Type: {}, ID: {}, endpoint: {})", info.description.type,
-                               info.service_id_, EndpointIntToString(info.ip, info.port));
-                  discovered_services_.emplace(info.service_id_, info);
-                  // Notify callbacks
-                  for (const auto &callback: registered_callbacks_) {
-                    callback->OnServiceDiscovered(info.service_id_);
-                  }
-                }
-              }
-            } catch (std::exception &e) {
-              spdlog::error("Got exception during service discovery: {}", e.what());
-            }
+          const uint8_t *payload = packet.data() + offset + sizeof(datatypes::XbotHeader);
+          if (header->message_type == datatypes::MessageType::SERVICE_ADVERTISEMENT) {
+            HandleAdvertisement(payload, header->payload_size);
+          } else if (header->message_type == datatypes::MessageType::SERVICE_QUERY) {
+            HandleDescription(header, payload);
+          } else if (header->message_type == datatypes::MessageType::LOG) {
+            RemoteLogImpl::GetInstance()->Ingest(header, payload);
+          } else {
+            spdlog::warn("Service Discovery socket got non-service discovery message");
           }
+          offset += packet_size;
         }
       }
     }
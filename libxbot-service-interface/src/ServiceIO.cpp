@@ -4,58 +4,140 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <limits>
 #include <map>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <thread>
 #include <xbot-service-interface/Socket.hpp>
+#include <xbot-service-interface/time_utils.hpp>
 #include <xbot/datatypes/ClaimPayload.hpp>
+#include <xbot/datatypes/TimeSyncPayload.hpp>
 
+#include "CallbackExecutor.hpp"
+#include "RemoteLogImpl.hpp"
 #include "ServiceDiscoveryImpl.hpp"
 #include "ServiceIOImpl.hpp"
 #include "xbot-service-interface/endpoint_utils.hpp"
 
 using namespace xbot::serviceif;
 
+using CallbackList = std::vector<std::shared_ptr<ServiceIOCallbacks> >;
+
 /**
- * Maps service_id to state.
+ * Maps service_id to its slot, nullptr if the service_id was never used.
+ * Indexed directly, so that the receive path needs neither a lock nor a tree
+ * walk to find a service.
  */
-std::map<uint16_t, std::unique_ptr<ServiceState> > endpoint_map_{};
+std::atomic<ServiceSlot *> service_slots_[std::numeric_limits<uint16_t>::max() + 1]{};
+// All slots in order of creation, the first slot_count_ ones are valid.
+// Slots are never freed.
+ServiceSlot *slot_list_[std::numeric_limits<uint16_t>::max() + 1]{};
+std::atomic<size_t> slot_count_{0};
+// Serializes creating slots
+std::mutex slots_mutex_{};
+
+// Earliest time a reliable packet might be due, as steady_clock ticks
+std::atomic<std::chrono::steady_clock::rep> next_retransmit_{0};
 
-// Protects inverse_endpoint_map_, endpoint_map_ and instance_
+// Protects instance_, executors_, callback_waiters_, telemetry_intervals_,
+// output_policies_ and serializes (un-)registering callbacks. Never send while holding it, service discovery
+// calls us while holding its own lock.
 std::recursive_mutex state_mutex_{};
 ServiceIOImpl *instance_ = nullptr;
 
 std::thread io_thread_{};
+// Like Worker::callback_section_, for packets handled on the IO thread
+std::atomic<uint32_t> io_callback_section_{0};
+// Set on the IO thread and the workers
+thread_local bool receiving_thread_ = false;
 Socket io_socket_{"0.0.0.0"};
 std::mutex stopped_mtx_{};
 bool stopped_{false};
+// Number of threads handling received packets, 0 to handle them on the IO
+// thread
+size_t worker_threads_{0};
 // track when we last checked for claims and timeouts
 std::chrono::time_point<std::chrono::steady_clock> last_check_{
   std::chrono::seconds(0)
 };
 
-// keep a list of callbacks for each service
-std::map<uint16_t, std::vector<ServiceIOCallbacks *> >
-registered_callbacks_{};
+// Subscribers called from a thread of their own
+std::map<ServiceIOCallbacks *, std::shared_ptr<CallbackExecutor> > executors_{};
+// Threads in WaitForCallbacks(), the executors don't block while there are any
+size_t callback_waiters_{0};
 
-bool ServiceIOImpl::OnServiceDiscovered(uint16_t service_id) {
-  std::unique_lock lk{state_mutex_};
+// Requested telemetry interval for each service, sent with the claim
+std::map<uint16_t, uint32_t> telemetry_intervals_{};
+
+// Requested output policies for each service (by output id), sent with the
+// claim
+std::map<uint16_t, std::map<uint16_t, xbot::datatypes::OutputPolicy> >
+output_policies_{};
 
+/**
+ * @return the slot of a service_id, nullptr if it was never used
+ */
+ServiceSlot *GetSlot(uint16_t service_id) {
+  return service_slots_[service_id].load(std::memory_order_acquire);
+}
+
+/**
+ * @return the slot of a discovered service, nullptr otherwise
+ */
+ServiceSlot *GetActiveSlot(uint16_t service_id) {
+  ServiceSlot *slot = GetSlot(service_id);
+  return slot != nullptr && slot->active_ ? slot : nullptr;
+}
+
+ServiceSlot *GetOrCreateSlot(uint16_t service_id) {
+  if (ServiceSlot *slot = GetSlot(service_id)) {
+    return slot;
+  }
+  std::unique_lock lk{slots_mutex_};
+  // Check again, someone else might have created it meanwhile
+  ServiceSlot *slot = service_slots_[service_id].load(std::memory_order_relaxed);
+  if (slot == nullptr) {
+    slot = new ServiceSlot{service_id};
+    const size_t count = slot_count_.load(std::memory_order_relaxed);
+    slot_list_[count] = slot;
+    slot_count_.store(count + 1, std::memory_order_release);
+    service_slots_[service_id].store(slot, std::memory_order_release);
+  }
+  return slot;
+}
+
+/**
+ * Makes sure RetransmitReliable() looks at a packet due at the given time.
+ */
+void ScheduleRetransmit(std::chrono::steady_clock::time_point due) {
+  auto next = next_retransmit_.load();
+  while (due.time_since_epoch().count() < next &&
+         !next_retransmit_.compare_exchange_weak(next, due.time_since_epoch().count())) {
+  }
+}
+
+bool ServiceIOImpl::OnServiceDiscovered(uint16_t service_id) {
   uint32_t service_ip = 0;
   uint16_t service_port = 0;
 
   if (service_discovery->GetEndpoint(service_id, service_ip, service_port) &&
       service_ip != 0 && service_port != 0) {
     // Got valid endpoint, create a state
-    if (endpoint_map_.contains(service_id)) {
+    ServiceSlot *slot = GetOrCreateSlot(service_id);
+    if (slot->active_) {
       spdlog::warn(
         "Service state already exists, overwriting with new state. This "
         "might have unforseen consequences.");
-      endpoint_map_.erase(service_id);
     }
-    std::unique_ptr<ServiceState> state = std::make_unique<ServiceState>();
-    endpoint_map_.emplace(service_id, std::move(state));
+    std::unique_lock lk{slot->mutex_};
+    slot->state_ = ServiceState{};
+    slot->claimed_successfully_ = false;
+    slot->active_ = true;
   }
 
   return true;
@@ -71,6 +153,10 @@ void ServiceIOImpl::SetBindAddress(std::string bind_address) {
   io_socket_.SetBindAddress(bind_address);
 }
 
+void ServiceIOImpl::SetWorkerThreads(size_t worker_threads) {
+  worker_threads_ = worker_threads;
+}
+
 ServiceIOImpl *ServiceIOImpl::GetInstance() {
   std::unique_lock lk{state_mutex_};
   if (instance_ == nullptr) {
@@ -83,6 +169,14 @@ bool ServiceIOImpl::Start() { {
     std::unique_lock lk{stopped_mtx_};
     stopped_ = false;
   }
+  // Create all workers before starting any thread, RunIo() and RunWorker()
+  // access workers_ without locking.
+  for (size_t i = 0; i < worker_threads_; i++) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < workers_.size(); i++) {
+    workers_[i]->thread = std::thread{&ServiceIOImpl::RunWorker, this, i};
+  }
   io_thread_ = std::thread{&ServiceIOImpl::RunIo, this};
 
   return true;
@@ -91,31 +185,218 @@ bool ServiceIOImpl::Start() { {
 void ServiceIOImpl::RegisterCallbacks(uint16_t service_id,
                                       ServiceIOCallbacks *callbacks) {
   std::unique_lock lk{state_mutex_};
-  // Square bracket notation is correct, we create an empty vector, if non-existent
-  auto &vector = registered_callbacks_[service_id];
+  if (const auto it = executors_.find(callbacks); it != executors_.end()) {
+    AddCallbacks(service_id, callbacks, it->second);
+    return;
+  }
+  // Not owned, the subscriber unregisters before it goes away
+  AddCallbacks(service_id, callbacks,
+               std::shared_ptr<ServiceIOCallbacks>{std::shared_ptr<void>{}, callbacks});
+}
+
+void ServiceIOImpl::RegisterCallbacks(uint16_t service_id,
+                                      ServiceIOCallbacks *callbacks,
+                                      const CallbackExecutorOptions &options) {
+  std::unique_lock lk{state_mutex_};
+  auto &executor = executors_[callbacks];
+  if (executor == nullptr) {
+    executor = std::make_shared<CallbackExecutor>(
+      callbacks, options, [this](uint16_t service_id, bool handled) {
+        OnConfigurationAnswered(service_id, handled);
+      });
+    executor->SetBlocking(callback_waiters_ == 0);
+    executor->Start();
+  }
+  AddCallbacks(service_id, callbacks, executor);
+}
+
+void ServiceIOImpl::AddCallbacks(uint16_t service_id,
+                                 ServiceIOCallbacks *callbacks,
+                                 std::shared_ptr<ServiceIOCallbacks> target) {
+  std::unique_lock lk{state_mutex_};
+  ServiceSlot *slot = GetOrCreateSlot(service_id);
+  const auto current = slot->callbacks_.load();
 
   // Check, if callbacks already registered
-  if (std::find(vector.begin(), vector.end(), callbacks) != vector.end()) {
+  if (current != nullptr &&
+      std::any_of(current->begin(), current->end(), [&](const auto &cb) {
+        return cb.get() == callbacks || cb == target;
+      })) {
     return;
   }
 
-  // add the callbacks
-  vector.push_back(callbacks);
+  // add the callbacks to a copy, the current list might be in use
+  auto list = current != nullptr ? std::make_shared<CallbackList>(*current)
+                                 : std::make_shared<CallbackList>();
+  list->push_back(std::move(target));
+  slot->callbacks_.store(std::move(list));
+}
+
+bool ServiceIOImpl::GetCallbackStats(ServiceIOCallbacks *callbacks,
+                                     CallbackStats &stats) {
+  std::unique_lock lk{state_mutex_};
+  const auto it = executors_.find(callbacks);
+  if (it == executors_.end()) {
+    return false;
+  }
+  stats = it->second->GetStats();
+  return true;
 }
 
 void ServiceIOImpl::UnregisterCallbacks(ServiceIOCallbacks *callbacks) {
   std::unique_lock lk{state_mutex_};
-  for (auto [service_id, callback_list]: registered_callbacks_) {
-    for (auto cb_it = callback_list.begin(); cb_it != callback_list.end();) {
-      if (*cb_it == callbacks) {
-        // Erase
-        cb_it = callback_list.erase(cb_it);
-      } else {
-        // Skip
-        ++cb_it;
+  std::shared_ptr<CallbackExecutor> executor{};
+  if (const auto it = executors_.find(callbacks); it != executors_.end()) {
+    executor = std::move(it->second);
+    executors_.erase(it);
+  }
+  const auto registered = [&](const std::shared_ptr<ServiceIOCallbacks> &cb) {
+    return cb.get() == callbacks || (executor != nullptr && cb == executor);
+  };
+  // Called directly by the receiving threads, not by an executor
+  bool direct = false;
+  const size_t count = slot_count_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < count; i++) {
+    ServiceSlot &slot = *slot_list_[i];
+    const auto current = slot.callbacks_.load();
+    if (current == nullptr ||
+        std::none_of(current->begin(), current->end(), registered)) {
+      continue;
+    }
+    direct |= std::any_of(current->begin(), current->end(), [&](const auto &cb) {
+      return cb.get() == callbacks;
+    });
+    auto list = std::make_shared<CallbackList>(*current);
+    std::erase_if(*list, registered);
+    slot.callbacks_.store(std::move(list));
+  }
+  lk.unlock();
+
+  if (executor != nullptr) {
+    // Without holding the lock, the subscriber might be using us right now.
+    // The old lists keep the executor alive, it drops what they still queue.
+    executor->Stop();
+  }
+  if (direct) {
+    // A receiving thread might still be calling them from an old list
+    WaitForCallbacks();
+  }
+}
+
+void ServiceIOImpl::WaitForCallbacks() {
+  if (receiving_thread_ || CallbackExecutor::IsExecutorThread()) {
+    // Called from a callback. The other threads might be waiting for this
+    // one, so waiting for them could deadlock.
+    return;
+  }
+  const auto set_blocking = [](bool blocking) {
+    for (const auto &[callbacks, executor]: executors_) {
+      executor->SetBlocking(blocking);
+    }
+  };
+  {
+    // A receiving thread blocked by a full executor waits for its subscriber,
+    // which might wait for our caller.
+    std::unique_lock lk{state_mutex_};
+    if (callback_waiters_++ == 0) {
+      set_blocking(false);
+    }
+  }
+  const auto wait = [](const std::atomic<uint32_t> &section_counter) {
+    const uint32_t section = section_counter.load();
+    if (section & 1) {
+      while (section_counter.load() == section) {
+        std::this_thread::yield();
       }
     }
+  };
+  wait(io_callback_section_);
+  for (const auto &worker: workers_) {
+    wait(worker->callback_section_);
+  }
+  std::unique_lock lk{state_mutex_};
+  if (--callback_waiters_ == 0) {
+    set_blocking(true);
+  }
+}
+
+void ServiceIOImpl::SetTelemetryInterval(uint16_t service_id,
+                                         uint32_t interval_micros) {
+  {
+    std::unique_lock lk{state_mutex_};
+    telemetry_intervals_[service_id] = interval_micros;
+  }
+  UpdateClaim(service_id);
+}
+
+bool ServiceIOImpl::SetOutputPolicy(uint16_t service_id,
+                                    const datatypes::OutputPolicy &policy) {
+  {
+    std::unique_lock lk{state_mutex_};
+    auto &policies = output_policies_[service_id];
+    if (policy.mode == datatypes::OutputPolicyMode::FULL_RATE) {
+      policies.erase(policy.output_id);
+    } else if (policies.contains(policy.output_id) ||
+               policies.size() < config::max_output_policies) {
+      policies[policy.output_id] = policy;
+    } else {
+      spdlog::error("Too many output policies for service {}", service_id);
+      return false;
+    }
+  }
+  UpdateClaim(service_id);
+  return true;
+}
+
+void ServiceIOImpl::UpdateClaim(uint16_t service_id) {
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr || !slot->claimed_successfully_) {
+    // Sent with the next claim
+    return;
+  }
+  {
+    std::unique_lock lk{slot->mutex_};
+    slot->state_.claim_update_pending_ = true;
+    slot->state_.last_claim_sent_ = std::chrono::steady_clock::time_point{};
+  }
+  ClaimService(service_id, true);
+}
+
+bool ServiceIOImpl::GetLatencyStats(uint16_t service_id, LatencyStats &stats) {
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr || !slot->claimed_successfully_) {
+    return false;
   }
+  std::unique_lock lk{slot->mutex_};
+  stats = slot->state_.latency_;
+  return true;
+}
+
+bool ServiceIOImpl::GetReliableStats(uint16_t service_id,
+                                     ReliableStats &stats) {
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr || !slot->claimed_successfully_) {
+    return false;
+  }
+  std::unique_lock lk{slot->mutex_};
+  stats = slot->state_.reliable_;
+  stats.rtt_micros = slot->state_.rtt_.getRttMicros();
+  return true;
+}
+
+bool ServiceIOImpl::GetSequenceStats(uint16_t service_id,
+                                     SequenceStats &stats) {
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr || !slot->claimed_successfully_) {
+    return false;
+  }
+  std::unique_lock lk{slot->mutex_};
+  stats = slot->state_.sequence_;
+  return true;
+}
+
+void ServiceIOImpl::SetDropOutOfOrder(uint16_t service_id, bool enabled) {
+  GetOrCreateSlot(service_id)->drop_out_of_order_ = enabled;
 }
 
 bool ServiceIOImpl::SendData(uint16_t service_id,
@@ -130,129 +411,385 @@ bool ServiceIOImpl::SendData(uint16_t service_id,
   return TransmitPacket(ip, port, data);
 }
 
+bool ServiceIOImpl::SendReliable(uint16_t service_id,
+                                 const std::vector<uint8_t> &data) {
+  if (data.size() < sizeof(datatypes::XbotHeader)) {
+    spdlog::error("reliable packet without header");
+    return false;
+  }
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr) {
+    spdlog::debug("no state for service {}, sending unreliably", service_id);
+    return SendData(service_id, data);
+  }
+
+  std::vector<uint8_t> packet = data;
+  const auto header = reinterpret_cast<datatypes::XbotHeader *>(packet.data());
+  header->flags |= datatypes::FLAG_RELIABLE;
+  const uint16_t sequence_no = header->sequence_no;
+  {
+    std::unique_lock lk{slot->mutex_};
+    auto &state = slot->state_;
+    if (state.reliable_in_flight_.size() >=
+        config::serviceif::reliable_max_in_flight) {
+      lk.unlock();
+      spdlog::warn("Too many reliable packets in flight for service {}, "
+                   "sending unreliably",
+                   service_id);
+      return SendData(service_id, data);
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const auto due = now + std::chrono::microseconds(state.rtt_.getTimeoutMicros());
+    state.reliable_.sent++;
+    state.reliable_in_flight_[sequence_no] = {packet, now, due, 0};
+    ScheduleRetransmit(due);
+  }
+  // Keep it even if the transmission failed, the retransmission might work
+  SendData(service_id, packet);
+  return true;
+}
+
+std::chrono::microseconds ServiceIOImpl::RetransmitReliable() {
+  const auto now = std::chrono::steady_clock::now();
+  const std::chrono::steady_clock::time_point scheduled{
+    std::chrono::steady_clock::duration{next_retransmit_.load()}
+  };
+  if (now < scheduled) {
+    // Nothing due yet, no need to look at every service
+    return std::chrono::duration_cast<std::chrono::microseconds>(scheduled - now);
+  }
+  auto next_due = now + std::chrono::microseconds(config::default_heartbeat_micros);
+  // Packets sent while we are looking lower it again
+  next_retransmit_.store(next_due.time_since_epoch().count());
+
+  std::vector<std::vector<uint8_t> > retransmissions{};
+  const size_t count = slot_count_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < count; i++) {
+    ServiceSlot &slot = *slot_list_[i];
+    if (!slot.active_) {
+      // Dropped, the state is reset when it's discovered again
+      continue;
+    }
+    {
+      std::unique_lock lk{slot.mutex_};
+      auto &state = slot.state_;
+      for (auto it = state.reliable_in_flight_.begin();
+           it != state.reliable_in_flight_.end();) {
+        auto &packet = it->second;
+        if (packet.due <= now) {
+          if (packet.retransmits >= config::reliable_max_retransmits) {
+            spdlog::warn("Service {} did not acknowledge a reliable packet, "
+                         "giving up",
+                         slot.service_id_);
+            state.reliable_.failures++;
+            it = state.reliable_in_flight_.erase(it);
+            continue;
+          }
+          packet.retransmits++;
+          state.reliable_.retransmits++;
+          packet.due = now + std::chrono::microseconds(
+                         state.rtt_.getTimeoutMicros(packet.retransmits));
+          retransmissions.push_back(packet.data);
+        }
+        next_due = std::min(next_due, packet.due);
+        ++it;
+      }
+    }
+    for (const auto &packet: retransmissions) {
+      SendData(slot.service_id_, packet);
+    }
+    retransmissions.clear();
+  }
+  ScheduleRetransmit(next_due);
+  return std::chrono::duration_cast<std::chrono::microseconds>(next_due - now);
+}
+
+void ServiceIOImpl::RunChecks(size_t worker) {
+  spdlog::debug("running checks");
+  // Claim all unclaimed services and check for timeouts.
+  const size_t count = slot_count_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < count; i++) {
+    ServiceSlot &slot = *slot_list_[i];
+    if (!slot.active_ ||
+        (!workers_.empty() && slot.service_id_ % workers_.size() != worker)) {
+      // Not discovered or checked by the service's own worker
+      continue;
+    }
+    if (!slot.claimed_successfully_) {
+      ClaimService(slot.service_id_);
+      continue;
+    }
+    bool timed_out;
+    bool transaction_open;
+    bool claim_update_pending;
+    {
+      std::unique_lock lk{slot.mutex_};
+      // Check for timeout
+      timed_out = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() -
+                    slot.state_.last_heartbeat_received_) >
+                  std::chrono::microseconds(config::default_heartbeat_micros +
+                                            config::heartbeat_jitter);
+      transaction_open = slot.state_.transaction_open_;
+      claim_update_pending = slot.state_.claim_update_pending_;
+    }
+    if (!timed_out) {
+      if (claim_update_pending) {
+        // The update or its ack might have been lost, send it again
+        ClaimService(slot.service_id_, true);
+      }
+      continue;
+    }
+    spdlog::warn("Service timed out, removing service.");
+    slot.active_ = false;
+    slot.claimed_successfully_ = false;
+
+    // Drop service from discovery, so that it will get
+    // rediscovered later
+    service_discovery->DropService(slot.service_id_);
+
+    // Notify callbacks for that service
+    if (const auto callbacks = slot.callbacks_.load()) {
+      for (const auto &cb: *callbacks) {
+        if (transaction_open) {
+          // The rest of the transaction won't arrive anymore
+          cb->OnTransactionEnd(slot.service_id_);
+        }
+        cb->OnServiceDisconnected(slot.service_id_);
+      }
+    }
+  }
+}
+
 void ServiceIOImpl::RunIo() {
   // Set timeout so that we can detect missing heartbeat
   io_socket_.SetReceiveTimeoutMicros(config::default_heartbeat_micros);
   io_socket_.Start();
+  uint32_t receive_timeout_micros = 0;
   uint32_t sender_ip;
   uint16_t sender_port;
   std::vector<uint8_t> packet{};
+  receiving_thread_ = true;
   // While not stopped
   while (true) {
     {
       std::unique_lock lk{stopped_mtx_};
       if (stopped_) break;
     }
-    if (std::chrono::duration_cast<std::chrono::microseconds>(
+    // With workers, each worker checks its own services, so that
+    // disconnects are ordered with the service's data.
+    if (workers_.empty() &&
+        std::chrono::duration_cast<std::chrono::microseconds>(
           std::chrono::steady_clock::now() - last_check_) >
         std::chrono::microseconds(1000000)) {
       last_check_ = std::chrono::steady_clock::now();
-      spdlog::debug("running checks");
-      std::unique_lock lk{state_mutex_};
-      // Claim all unclaimed services and check for timeouts.
-      for (auto it = endpoint_map_.begin(); it != endpoint_map_.end();
-           /* no increment */) {
-        if (!it->second->claimed_successfully_) {
-          ClaimService(it->first);
-          ++it;
-        } else {
-          // Check for timeout
-          if (std::chrono::duration_cast<std::chrono::microseconds>(
-                std::chrono::steady_clock::now() -
-                it->second->last_heartbeat_received_) >
-              std::chrono::microseconds(config::default_heartbeat_micros +
-                                        config::heartbeat_jitter)) {
-            spdlog::warn("Service timed out, removing service.");
-
-            // Drop service from discovery, so that it will get
-            // rediscovered later
-            service_discovery->DropService(it->first);
-
-            // Notify callbacks for that service
-            if (const auto cb_it = registered_callbacks_.find(it->first);
-              cb_it != registered_callbacks_.end()) {
-              for (const auto &cb: cb_it->second) {
-                cb->OnServiceDisconnected(it->first);
-              }
-            }
-
-            it = endpoint_map_.erase(it);
-          } else {
-            // No timeout, go to next
-            ++it;
-          }
-        }
-      }
+      io_callback_section_.fetch_add(1);
+      RunChecks(0);
+      io_callback_section_.fetch_add(1);
+    }
+
+    // Wake up in time for the next retransmission
+    const uint32_t timeout_micros = std::clamp<uint32_t>(
+      RetransmitReliable().count(), 1000, config::default_heartbeat_micros);
+    if (timeout_micros != receive_timeout_micros) {
+      receive_timeout_micros = timeout_micros;
+      io_socket_.SetReceiveTimeoutMicros(receive_timeout_micros);
     }
 
     if (io_socket_.ReceivePacket(sender_ip, sender_port, packet)) {
-      if (packet.size() >= sizeof(datatypes::XbotHeader)) {
-        const auto header =
-            reinterpret_cast<datatypes::XbotHeader *>(packet.data());
-        if (header->payload_size !=
-            packet.size() - sizeof(datatypes::XbotHeader)) {
-          spdlog::error("Got packet with invalid size");
-          continue;
-        }
+      if (workers_.empty()) {
+        io_callback_section_.fetch_add(1);
+        HandleDatagram(packet, GetTimestampNanos());
+        io_callback_section_.fetch_add(1);
+      } else {
+        Dispatch(packet, GetTimestampNanos());
+      }
+    }
+  }
+}
+
+void ServiceIOImpl::RunWorker(size_t index) {
+  Worker &worker = *workers_[index];
+  std::deque<Worker::Packet> packets{};
+  auto next_check = std::chrono::steady_clock::now();
+  receiving_thread_ = true;
+  while (true) {
+    {
+      std::unique_lock lk{worker.queue_mutex_};
+      worker.queue_cv_.wait_until(lk, next_check, [&worker] {
+        return worker.stopped_ || !worker.queue_.empty();
+      });
+      if (worker.stopped_) {
+        break;
+      }
+      // Take all packets at once, so that the IO thread does not wait for us
+      std::swap(packets, worker.queue_);
+    }
+    worker.callback_section_.fetch_add(1);
+    for (auto &packet: packets) {
+      HandleDatagram(packet.data, packet.receive_time_nanos);
+    }
+    packets.clear();
+
+    if (std::chrono::steady_clock::now() >= next_check) {
+      next_check = std::chrono::steady_clock::now() +
+                   std::chrono::microseconds(1000000);
+      RunChecks(index);
+    }
+    worker.callback_section_.fetch_add(1);
+  }
+}
 
-        const uint8_t *const payload_buffer =
-            packet.data() + sizeof(datatypes::XbotHeader);
-
-        switch (header->message_type) {
-          case datatypes::MessageType::CLAIM:
-            HandleClaimMessage(header, payload_buffer,
-                               header->payload_size);
-            break;
-          case datatypes::MessageType::DATA:
-            HandleDataMessage(header, payload_buffer,
-                              header->payload_size);
-            break;
-          case datatypes::MessageType::CONFIGURATION_REQUEST:
-            HandleConfigurationRequest(header, payload_buffer,
-                                       header->payload_size);
-            break;
-          case datatypes::MessageType::HEARTBEAT:
-            HandleHeartbeatMessage(header, payload_buffer,
-                                   header->payload_size);
-            break;
-          case datatypes::MessageType::TRANSACTION:
-            if (header->arg1 == 0) {
-              HandleDataTransaction(header, payload_buffer,
-                                    header->payload_size);
-            } else {
-              spdlog::warn("Got transaction with unknown type");
-            }
-            break;
-          default:
-            spdlog::warn("Got message of unknown type");
-            break;
+void ServiceIOImpl::Dispatch(std::vector<uint8_t> &datagram,
+                             uint64_t receive_time_nanos) {
+  size_t offset = 0;
+  while (datagram.size() - offset >= sizeof(datatypes::XbotHeader)) {
+    const auto header =
+        reinterpret_cast<const datatypes::XbotHeader *>(datagram.data() + offset);
+    const size_t packet_size =
+        sizeof(datatypes::XbotHeader) + header->payload_size;
+    if (datagram.size() - offset < packet_size) {
+      break;
+    }
+    Worker &worker = *workers_[header->service_id % workers_.size()];
+    bool dropped;
+    {
+      std::unique_lock lk{worker.queue_mutex_};
+      dropped = worker.queue_.size() >= config::serviceif::io_worker_queue_length;
+      if (!dropped) {
+        if (offset == 0 && packet_size == datagram.size()) {
+          // Not chained, no need to copy
+          worker.queue_.push_back({std::move(datagram), receive_time_nanos});
+          datagram.clear();
+        } else {
+          worker.queue_.push_back(
+              {{datagram.begin() + offset, datagram.begin() + offset + packet_size},
+               receive_time_nanos});
         }
       }
     }
+    if (dropped) {
+      spdlog::warn("Worker queue full, dropping packet");
+    } else {
+      worker.queue_cv_.notify_one();
+    }
+    offset += packet_size;
+    if (datagram.empty()) {
+      return;
+    }
+  }
+  if (offset != datagram.size()) {
+    spdlog::error("Got packet with invalid size");
   }
 }
 
-void ServiceIOImpl::ClaimService(uint16_t service_id) {
-  std::unique_lock lk{state_mutex_};
-  if (!endpoint_map_.contains(service_id)) {
-    // Cannot try to claim a service which was not even discovered
-    spdlog::error("Tried to claim a service which was not in the endpoint map");
+void ServiceIOImpl::HandleDatagram(std::vector<uint8_t> &datagram,
+                                   uint64_t receive_time_nanos) {
+  size_t offset = 0;
+  while (datagram.size() - offset >= sizeof(datatypes::XbotHeader)) {
+    const auto header =
+        reinterpret_cast<datatypes::XbotHeader *>(datagram.data() + offset);
+    const size_t packet_size =
+        sizeof(datatypes::XbotHeader) + header->payload_size;
+    if (datagram.size() - offset < packet_size) {
+      break;
+    }
+    HandlePacket(header, datagram.data() + offset + sizeof(datatypes::XbotHeader),
+                 receive_time_nanos);
+    offset += packet_size;
+  }
+  if (offset != datagram.size()) {
+    spdlog::error("Got packet with invalid size");
+  }
+}
+
+void ServiceIOImpl::HandlePacket(datatypes::XbotHeader *header,
+                                 const uint8_t *payload,
+                                 uint64_t receive_time_nanos) {
+  const bool in_order = TrackSequence(header);
+  // Acknowledge reliable packets, duplicates are only acknowledged.
+  // TrackSequence() never drops reliable ones.
+  if ((header->flags & datatypes::FLAG_RELIABLE) && !AcceptReliable(header)) {
+    return;
+  }
+  if (!in_order) {
     return;
   }
-  const auto &state = endpoint_map_.at(service_id);
 
-  // Check, if we recently sent the claim. If not, try again
-  auto now = std::chrono::steady_clock::now();
+  switch (header->message_type) {
+    case datatypes::MessageType::DATA:
+    case datatypes::MessageType::HEARTBEAT:
+    case datatypes::MessageType::TELEMETRY:
+      RecordLatency(header, receive_time_nanos);
+      break;
+    default:
+      break;
+  }
 
-  auto diff = std::chrono::duration_cast<std::chrono::microseconds>(
-    now - state->last_claim_sent_);
-  if (diff < std::chrono::microseconds(1000)) {
+  switch (header->message_type) {
+    case datatypes::MessageType::CLAIM:
+      HandleClaimMessage(header, payload, header->payload_size);
+      break;
+    case datatypes::MessageType::DATA:
+      HandleDataMessage(header, payload, header->payload_size);
+      break;
+    case datatypes::MessageType::CONFIGURATION_REQUEST:
+      HandleConfigurationRequest(header, payload, header->payload_size);
+      break;
+    case datatypes::MessageType::HEARTBEAT:
+      HandleHeartbeatMessage(header, payload, header->payload_size);
+      break;
+    case datatypes::MessageType::TELEMETRY:
+      HandleTelemetryMessage(header, payload, header->payload_size);
+      break;
+    case datatypes::MessageType::TIME_SYNC:
+      HandleTimeSyncRequest(header, payload, header->payload_size,
+                            receive_time_nanos);
+      break;
+    case datatypes::MessageType::ACK:
+      HandleAck(header);
+      break;
+    case datatypes::MessageType::LOG:
+      RemoteLogImpl::GetInstance()->Ingest(header, payload);
+      break;
+    case datatypes::MessageType::TRANSACTION:
+      if (header->arg1 == 0) {
+        HandleDataTransaction(header, payload, header->payload_size);
+      } else {
+        spdlog::warn("Got transaction with unknown type");
+      }
+      break;
+    default:
+      spdlog::warn("Got message of unknown type");
+      break;
+  }
+}
+
+void ServiceIOImpl::ClaimService(uint16_t service_id, bool update) {
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr) {
+    // Cannot try to claim a service which was not even discovered
+    spdlog::error("Tried to claim a service which was not discovered");
     return;
   }
 
-  // Set it here, in case of error we also don't want to retry too often
-  state->last_claim_sent_ = now;
-  state->claimed_successfully_ = false;
+  {
+    std::unique_lock lk{slot->mutex_};
+    // Check, if we recently sent the claim. If not, try again
+    auto now = std::chrono::steady_clock::now();
+
+    auto diff = std::chrono::duration_cast<std::chrono::microseconds>(
+      now - slot->state_.last_claim_sent_);
+    if (diff < std::chrono::microseconds(1000)) {
+      return;
+    }
+
+    // Set it here, in case of error we also don't want to retry too often
+    slot->state_.last_claim_sent_ = now;
+  }
+  if (!update) {
+    slot->claimed_successfully_ = false;
+  }
 
   std::string my_ip{};
   uint16_t my_port;
@@ -262,27 +799,60 @@ void ServiceIOImpl::ClaimService(uint16_t service_id) {
     return;
   }
 
+  std::unique_lock lk{state_mutex_};
+  size_t policy_count = 0;
+  if (const auto it = output_policies_.find(service_id);
+    it != output_policies_.end()) {
+    policy_count = it->second.size();
+  }
+  uint32_t telemetry_interval_micros = 0;
+  if (const auto it = telemetry_intervals_.find(service_id);
+    it != telemetry_intervals_.end()) {
+    telemetry_interval_micros = it->second;
+  }
+  // Services built before telemetry and output policies only accept the
+  // legacy claim, so only send the new fields when they are used.
+  size_t payload_size = offsetof(datatypes::ClaimPayload,
+                                 telemetry_interval_micros);
+  if (telemetry_interval_micros > 0 || policy_count > 0) {
+    payload_size = sizeof(datatypes::ClaimPayload) +
+                   policy_count * sizeof(datatypes::OutputPolicy);
+  }
+
   std::vector<uint8_t> packet{};
-  packet.resize(sizeof(datatypes::XbotHeader) +
-                sizeof(datatypes::ClaimPayload));
+  packet.resize(sizeof(datatypes::XbotHeader) + payload_size);
   auto header = reinterpret_cast<datatypes::XbotHeader *>(packet.data());
   header->message_type = datatypes::MessageType::CLAIM;
   header->service_id = service_id;
   header->protocol_version = 1;
   header->arg1 = 0;
-  header->arg2 = 0;
+  header->arg2 = update ? 1 : 0;
   header->sequence_no = 0;
   header->flags = 0;
-  header->timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
-        std::chrono::steady_clock::now().time_since_epoch())
-      .count();
-  header->payload_size = sizeof(datatypes::ClaimPayload);
+  header->timestamp = GetTimestampNanos();
+  header->payload_size = payload_size;
   auto payload_ptr = reinterpret_cast<datatypes::ClaimPayload *>(
     packet.data() + sizeof(datatypes::XbotHeader));
   payload_ptr->target_ip = IpStringToInt(my_ip);
   payload_ptr->target_port = my_port;
   payload_ptr->heartbeat_micros = config::default_heartbeat_micros;
-  spdlog::info("Sending Service Claim");
+  if (payload_size >= sizeof(datatypes::ClaimPayload)) {
+    payload_ptr->telemetry_interval_micros = telemetry_interval_micros;
+  }
+  if (policy_count > 0) {
+    auto policy_ptr = reinterpret_cast<datatypes::OutputPolicy *>(
+      packet.data() + sizeof(datatypes::XbotHeader) +
+      sizeof(datatypes::ClaimPayload));
+    for (const auto &[output_id, policy]: output_policies_[service_id]) {
+      *policy_ptr++ = policy;
+    }
+  }
+  lk.unlock();
+  if (update) {
+    spdlog::debug("Sending Service Claim update");
+  } else {
+    spdlog::info("Sending Service Claim");
+  }
   SendData(service_id, packet);
 }
 
@@ -304,26 +874,28 @@ void ServiceIOImpl::HandleClaimMessage(xbot::datatypes::XbotHeader *header,
     return;
   }
 
-  std::unique_lock lk{state_mutex_};
-  if (!endpoint_map_.contains(service_id)) {
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr) {
     spdlog::warn("received claim ack from wrong service");
     return;
   }
-  const auto &ptr = endpoint_map_.at(service_id);
-  // Also count the ack as heartbeat in order to not instantly timeout
-  ptr->last_heartbeat_received_ = std::chrono::steady_clock::now();
+  {
+    std::unique_lock lk{slot->mutex_};
+    // Also count the ack as heartbeat in order to not instantly timeout
+    slot->state_.last_heartbeat_received_ = std::chrono::steady_clock::now();
+    slot->state_.claim_update_pending_ = false;
+  }
 
-  if (ptr->claimed_successfully_) {
-    spdlog::warn("claim ack from already claimed service");
+  if (slot->claimed_successfully_.exchange(true)) {
+    // Acknowledged a claim update, the subscribers already know the service
+    spdlog::debug("claim ack from already claimed service");
     return;
   }
-  ptr->claimed_successfully_ = true;
   spdlog::info("Successfully claimed service");
 
   // Notify callbacks for that service
-  if (const auto it = registered_callbacks_.find(service_id);
-    it != registered_callbacks_.end()) {
-    for (const auto &cb: it->second) {
+  if (const auto callbacks = slot->callbacks_.load()) {
+    for (const auto &cb: *callbacks) {
       cb->OnServiceConnected(service_id);
     }
   }
@@ -332,23 +904,20 @@ void ServiceIOImpl::HandleClaimMessage(xbot::datatypes::XbotHeader *header,
 void ServiceIOImpl::HandleDataMessage(xbot::datatypes::XbotHeader *header,
                                       const uint8_t *payload,
                                       size_t payload_len) {
-  uint16_t service_id = header->service_id; {
-    std::unique_lock lk{state_mutex_};
-    if (!endpoint_map_.contains(service_id)) {
-      spdlog::debug("got data from wrong service");
-      return;
-    }
-    if (!endpoint_map_.at(service_id)->claimed_successfully_) {
-      spdlog::debug("Got data from an unclaimed service, dropping it.");
-      return;
-    }
+  uint16_t service_id = header->service_id;
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr) {
+    spdlog::debug("got data from wrong service");
+    return;
+  }
+  if (!slot->claimed_successfully_) {
+    spdlog::debug("Got data from an unclaimed service, dropping it.");
+    return;
   }
-  const auto &ptr = endpoint_map_.at(service_id);
 
   // Notify callbacks for that service
-  if (const auto it = registered_callbacks_.find(service_id);
-    it != registered_callbacks_.end()) {
-    for (const auto &cb: it->second) {
+  if (const auto callbacks = slot->callbacks_.load()) {
+    for (const auto &cb: *callbacks) {
       cb->OnData(service_id, header->timestamp, header->arg2, payload,
                  header->payload_size);
     }
@@ -358,28 +927,60 @@ void ServiceIOImpl::HandleDataMessage(xbot::datatypes::XbotHeader *header,
 void ServiceIOImpl::HandleDataTransaction(xbot::datatypes::XbotHeader *header,
                                           const uint8_t *payload,
                                           size_t payload_len) {
-  uint16_t service_id = header->service_id; {
-    std::unique_lock lk{state_mutex_};
-    if (!endpoint_map_.contains(service_id)) {
-      // This happens if we restart the interface and an unknown service sends
-      // us data.
-      spdlog::debug("got data from wrong service");
-      return;
+  uint16_t service_id = header->service_id;
+  // Large transactions are split into fragments by the service. Only start the
+  // transaction on the first fragment and end it on the last one.
+  bool end_previous = false;
+  bool start_transaction = false;
+  const bool end_transaction =
+      (header->flags & datatypes::FLAG_MORE_FRAGMENTS) == 0;
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr) {
+    // This happens if we restart the interface and an unknown service sends
+    // us data.
+    spdlog::debug("got data from wrong service");
+    return;
+  }
+  if (!slot->claimed_successfully_) {
+    // This happens if we restart the interface and a previously claimed
+    // service is still sending data.
+    spdlog::debug("Got data from an unclaimed service, dropping it.");
+    return;
+  }
+  {
+    std::unique_lock lk{slot->mutex_};
+    auto &state = slot->state_;
+    const uint16_t fragment = header->arg2;
+    if (state.transaction_open_ &&
+        (fragment != state.next_transaction_fragment_ ||
+         header->timestamp != state.transaction_timestamp_)) {
+      spdlog::warn("Lost the end of a fragmented transaction (service {})",
+                   service_id);
+      end_previous = true;
+      state.transaction_open_ = false;
     }
-    if (!endpoint_map_.at(service_id)->claimed_successfully_) {
-      // This happens if we restart the interface and a previously claimed
-      // service is still sending data.
-      spdlog::debug("Got data from an unclaimed service, dropping it.");
-      return;
+    if (!state.transaction_open_) {
+      if (fragment != 0) {
+        spdlog::warn(
+          "Lost the start of a fragmented transaction (service {})",
+          service_id);
+      }
+      start_transaction = true;
     }
+    state.transaction_open_ = !end_transaction;
+    state.transaction_timestamp_ = header->timestamp;
+    state.next_transaction_fragment_ = fragment + 1;
   }
-  const auto &state_ptr = endpoint_map_.at(service_id);
 
   // Notify callbacks for that service
-  if (const auto it = registered_callbacks_.find(service_id);
-    it != registered_callbacks_.end()) {
-    for (const auto &cb: it->second) {
-      cb->OnTransactionStart(header->timestamp);
+  if (const auto callbacks = slot->callbacks_.load()) {
+    for (const auto &cb: *callbacks) {
+      if (end_previous) {
+        cb->OnTransactionEnd(service_id);
+      }
+      if (start_transaction) {
+        cb->OnTransactionStart(service_id, header->timestamp);
+      }
       // Go through all data packets in the transaction
       size_t processed_len = 0;
       while (processed_len + sizeof(datatypes::DataDescriptor) <=
@@ -409,7 +1010,9 @@ void ServiceIOImpl::HandleDataTransaction(xbot::datatypes::XbotHeader *header,
         spdlog::warn("Transaction size mismatch!");
       }
 
-      cb->OnTransactionEnd();
+      if (end_transaction) {
+        cb->OnTransactionEnd(service_id);
+      }
     }
   }
 }
@@ -419,42 +1022,235 @@ void ServiceIOImpl::HandleHeartbeatMessage(xbot::datatypes::XbotHeader *header,
                                            size_t payload_len) {
   uint16_t service_id = header->service_id;
 
-  std::unique_lock lk{state_mutex_};
-  if (!endpoint_map_.contains(service_id)) {
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr) {
     spdlog::warn("received heartbeat from wrong service");
     return;
   }
-  endpoint_map_.at(service_id)->last_heartbeat_received_ =
-      std::chrono::steady_clock::now();
+  std::unique_lock lk{slot->mutex_};
+  slot->state_.last_heartbeat_received_ = std::chrono::steady_clock::now();
+}
+
+void ServiceIOImpl::HandleTelemetryMessage(xbot::datatypes::XbotHeader *header,
+                                           const uint8_t *payload,
+                                           size_t payload_len) {
+  // Older services don't send the reliable delivery counters
+  if (payload_len != sizeof(datatypes::TelemetryPayload) &&
+      payload_len != offsetof(datatypes::TelemetryPayload, retransmits)) {
+    spdlog::warn("Got telemetry with invalid size");
+    return;
+  }
+  datatypes::TelemetryPayload telemetry{};
+  memcpy(&telemetry, payload, payload_len);
+
+  const ServiceSlot *slot = GetSlot(header->service_id);
+  if (slot == nullptr) {
+    return;
+  }
+  if (const auto callbacks = slot->callbacks_.load()) {
+    for (const auto &cb: *callbacks) {
+      cb->OnTelemetry(header->service_id, telemetry);
+    }
+  }
+}
+
+void ServiceIOImpl::HandleTimeSyncRequest(xbot::datatypes::XbotHeader *header,
+                                          const uint8_t *payload,
+                                          size_t payload_len,
+                                          uint64_t receive_time_nanos) {
+  if (header->arg1 != 0 ||
+      payload_len != sizeof(datatypes::TimeSyncPayload)) {
+    spdlog::warn("Got invalid time sync request");
+    return;
+  }
+  std::vector<uint8_t> packet(sizeof(datatypes::XbotHeader) +
+                              sizeof(datatypes::TimeSyncPayload));
+  auto response_header =
+      reinterpret_cast<datatypes::XbotHeader *>(packet.data());
+  response_header->protocol_version = 1;
+  response_header->message_type = datatypes::MessageType::TIME_SYNC;
+  response_header->service_id = header->service_id;
+  response_header->arg1 = 1;
+  response_header->payload_size = sizeof(datatypes::TimeSyncPayload);
+
+  datatypes::TimeSyncPayload response{};
+  memcpy(&response, payload, sizeof(response));
+  response.request_received = receive_time_nanos;
+  response.response_sent = GetTimestampNanos();
+  response_header->timestamp = response.response_sent;
+  memcpy(packet.data() + sizeof(datatypes::XbotHeader), &response,
+         sizeof(response));
+  SendData(header->service_id, packet);
+}
+
+void ServiceIOImpl::RecordLatency(const datatypes::XbotHeader *header,
+                                  uint64_t receive_time_nanos) {
+  if ((header->flags & datatypes::FLAG_TIME_SYNCED) == 0) {
+    return;
+  }
+  ServiceSlot *slot = GetActiveSlot(header->service_id);
+  if (slot == nullptr || !slot->claimed_successfully_) {
+    return;
+  }
+  std::unique_lock lk{slot->mutex_};
+  LatencyStats &stats = slot->state_.latency_;
+  if (receive_time_nanos < header->timestamp) {
+    stats.negative_count++;
+    return;
+  }
+  const uint64_t latency_micros =
+      (receive_time_nanos - header->timestamp) / 1000;
+  stats.histogram[datatypes::telemetryHistogramBucket(
+      static_cast<uint32_t>(std::min<uint64_t>(latency_micros, UINT32_MAX)))]++;
+  stats.count++;
+  stats.sum_micros += latency_micros;
+  stats.max_micros = std::max(stats.max_micros, latency_micros);
+}
+
+bool ServiceIOImpl::AcceptReliable(const datatypes::XbotHeader *header) {
+  ServiceSlot *slot = GetActiveSlot(header->service_id);
+  if (slot == nullptr || !slot->claimed_successfully_) {
+    // Not acknowledged, the packet is dropped anyways
+    return true;
+  }
+
+  // Acknowledge duplicates as well, the first ACK might have been lost
+  std::vector<uint8_t> packet(sizeof(datatypes::XbotHeader));
+  auto ack_header = reinterpret_cast<datatypes::XbotHeader *>(packet.data());
+  ack_header->protocol_version = 1;
+  ack_header->message_type = datatypes::MessageType::ACK;
+  ack_header->service_id = header->service_id;
+  ack_header->sequence_no = header->sequence_no;
+  ack_header->timestamp = GetTimestampNanos();
+  SendData(header->service_id, packet);
+
+  std::unique_lock lk{slot->mutex_};
+  if (!slot->state_.reliable_window_.accept(header->sequence_no)) {
+    slot->state_.reliable_.duplicates_received++;
+    return false;
+  }
+  return true;
+}
+
+bool ServiceIOImpl::TrackSequence(const datatypes::XbotHeader *header) {
+  switch (header->message_type) {
+    case datatypes::MessageType::ACK:
+      // Carries the sequence number of the acknowledged packet
+    case datatypes::MessageType::LOG:
+      // Numbered separately
+      return true;
+    default:
+      break;
+  }
+
+  ServiceSlot *slot = GetActiveSlot(header->service_id);
+  if (slot == nullptr) {
+    return true;
+  }
+  std::unique_lock lk{slot->mutex_};
+  auto &state = slot->state_;
+  SequenceStats &stats = state.sequence_;
+  uint16_t skipped = 0;
+  auto arrival = state.sequence_window_.receive(header->sequence_no, &skipped);
+  if (arrival == SequenceWindow::Arrival::TOO_OLD &&
+      (header->flags & datatypes::FLAG_REBOOT) &&
+      header->sequence_no < SequenceWindow::size) {
+    // The service restarted and counts from the start again
+    spdlog::info("Service {} restarted", header->service_id);
+    stats.restarts++;
+    state.sequence_window_.reset();
+    arrival = state.sequence_window_.receive(header->sequence_no, &skipped);
+  }
+  stats.received++;
+  switch (arrival) {
+    case SequenceWindow::Arrival::IN_ORDER:
+      stats.lost += skipped;
+      return true;
+    case SequenceWindow::Arrival::LATE:
+      stats.reordered++;
+      // It was counted as lost, when a newer one skipped it
+      if (stats.lost > 0) {
+        stats.lost--;
+      }
+      break;
+    case SequenceWindow::Arrival::DUPLICATE:
+      stats.duplicates++;
+      break;
+    case SequenceWindow::Arrival::TOO_OLD:
+      stats.reordered++;
+      break;
+  }
+
+  const bool is_data =
+      header->message_type == datatypes::MessageType::DATA ||
+      (header->message_type == datatypes::MessageType::TRANSACTION &&
+       header->arg1 == 0);
+  // Reliable data is acknowledged, the service won't send it again
+  if (is_data && slot->drop_out_of_order_ &&
+      !(header->flags & datatypes::FLAG_RELIABLE)) {
+    stats.dropped++;
+    return false;
+  }
+  return true;
+}
+
+void ServiceIOImpl::HandleAck(const datatypes::XbotHeader *header) {
+  ServiceSlot *slot = GetActiveSlot(header->service_id);
+  if (slot == nullptr) {
+    return;
+  }
+  std::unique_lock lk{slot->mutex_};
+  auto &state = slot->state_;
+  const auto packet_it = state.reliable_in_flight_.find(header->sequence_no);
+  if (packet_it == state.reliable_in_flight_.end()) {
+    // ACK of a retransmission which arrived after the first ACK
+    return;
+  }
+  if (packet_it->second.retransmits == 0) {
+    // Only unambiguous round trips (Karn's algorithm)
+    state.rtt_.addSample(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - packet_it->second.sent)
+      .count());
+  }
+  state.reliable_.acknowledged++;
+  state.reliable_in_flight_.erase(packet_it);
 }
 
 void ServiceIOImpl::HandleConfigurationRequest(xbot::datatypes::XbotHeader *header, const uint8_t *payload,
                                                size_t payload_len) {
   uint16_t service_id = header->service_id;
 
-  std::unique_lock lk{state_mutex_};
-  if (!endpoint_map_.contains(service_id)) {
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr) {
     spdlog::debug("got config request from wrong service");
     return;
   }
-  if (!endpoint_map_.at(service_id)->claimed_successfully_) {
+  if (!slot->claimed_successfully_) {
     spdlog::debug("Got config request from an unclaimed service, dropping it.");
     return;
   }
 
-  const auto &ptr = endpoint_map_.at(service_id);
-
   // Notify callbacks for that service
   bool configuration_handled = false;
-  if (const auto it = registered_callbacks_.find(service_id);
-    it != registered_callbacks_.end()) {
-    for (const auto &cb: it->second) {
+  // Subscribers with their own thread answer later
+  size_t answers_pending = 0;
+  if (const auto callbacks = slot->callbacks_.load()) {
+    for (const auto &cb: *callbacks) {
       if (cb->OnConfigurationRequested(service_id)) {
         configuration_handled = true;
         break;
       }
+      if (dynamic_cast<const CallbackExecutor *>(cb.get()) != nullptr) {
+        answers_pending++;
+      }
     }
   }
+  if (!configuration_handled && answers_pending > 0) {
+    std::unique_lock lk{slot->mutex_};
+    slot->state_.configuration_answers_pending_ += answers_pending;
+    return;
+  }
   if (!configuration_handled) {
     spdlog::warn(
       "service {} requires configuration, but no handler provided any "
@@ -464,6 +1260,35 @@ void ServiceIOImpl::HandleConfigurationRequest(xbot::datatypes::XbotHeader *head
   }
 }
 
+void ServiceIOImpl::OnConfigurationAnswered(uint16_t service_id,
+                                            bool handled) {
+  ServiceSlot *slot = GetActiveSlot(service_id);
+  if (slot == nullptr) {
+    return;
+  }
+  {
+    std::unique_lock lk{slot->mutex_};
+    auto &state = slot->state_;
+    if (state.configuration_answers_pending_ == 0) {
+      // Asked before the service was discovered again
+      return;
+    }
+    state.configuration_handled_ |= handled;
+    if (--state.configuration_answers_pending_ > 0) {
+      return;
+    }
+    handled = state.configuration_handled_;
+    state.configuration_handled_ = false;
+  }
+  if (!handled) {
+    spdlog::warn(
+      "service {} requires configuration, but no handler provided any "
+      "configuration. "
+      "The service won't start.",
+      service_id);
+  }
+}
+
 ServiceIOImpl::ServiceIOImpl(ServiceDiscoveryImpl *serviceDiscovery)
   : service_discovery(serviceDiscovery) {
 }
@@ -479,6 +1304,27 @@ bool ServiceIOImpl::Stop() {
     stopped_ = true;
   }
   io_thread_.join();
+  // Stop the workers after the IO thread, which feeds them
+  for (const auto &worker: workers_) {
+    {
+      std::unique_lock lk{worker->queue_mutex_};
+      worker->stopped_ = true;
+    }
+    worker->queue_cv_.notify_all();
+    worker->thread.join();
+  }
+  workers_.clear();
+  std::vector<std::shared_ptr<CallbackExecutor> > executors{};
+  {
+    std::unique_lock lk{state_mutex_};
+    for (const auto &[callbacks, executor]: executors_) {
+      executors.push_back(executor);
+    }
+  }
+  // Without holding the lock, the subscribers might be using us right now
+  for (const auto &executor: executors) {
+    executor->Stop();
+  }
   spdlog::info("ServiceIO Stopped.");
   return true;
 }
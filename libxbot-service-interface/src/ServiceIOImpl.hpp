@@ -5,17 +5,23 @@
 #ifndef XBOT_FRAMEWORK_SERVICEIOIMPL_HPP
 #define XBOT_FRAMEWORK_SERVICEIOIMPL_HPP
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <xbot-service-interface/ServiceDiscovery.hpp>
 #include <xbot-service-interface/ServiceIO.hpp>
+#include <xbot/RttEstimator.hpp>
+#include <xbot/SequenceWindow.hpp>
 
 namespace xbot::serviceif {
- // Keep track of the state of each service (claimed or not, timeout)
+ // Keep track of the state of each service (claims, timeout, statistics)
  struct ServiceState {
-  // track, if we have claimed the service successfully.
-  // If the service is claimed it will send its outputs to this interface.
-  bool claimed_successfully_{false};
-
   // track when we sent the last claim, so that we don't spam the service
   std::chrono::time_point<std::chrono::steady_clock> last_claim_sent_{
    std::chrono::seconds(0)
@@ -23,6 +29,71 @@ namespace xbot::serviceif {
   std::chrono::time_point<std::chrono::steady_clock> last_heartbeat_received_{
    std::chrono::seconds(0)
   };
+  // Telemetry interval or output policies changed while claimed, the claim
+  // update is sent until the service acknowledges it
+  bool claim_update_pending_{false};
+
+  // Configuration requests asked to subscribers with their own thread, which
+  // did not answer yet, and whether anyone handled them
+  size_t configuration_answers_pending_{0};
+  bool configuration_handled_{false};
+
+  // Track fragmented transactions, so that all fragments are delivered
+  // within a single OnTransactionStart() / OnTransactionEnd() bracket.
+  bool transaction_open_{false};
+  uint64_t transaction_timestamp_{0};
+  uint16_t next_transaction_fragment_{0};
+
+  LatencyStats latency_{};
+
+  // Reliable packets sent to the service, waiting for their ACK, by
+  // sequence number
+  struct ReliablePacket {
+   std::vector<uint8_t> data;
+   std::chrono::steady_clock::time_point sent;
+   std::chrono::steady_clock::time_point due;
+   uint32_t retransmits;
+  };
+  std::map<uint16_t, ReliablePacket> reliable_in_flight_{};
+  RttEstimator rtt_{};
+  // Reliable packets received from the service, to drop duplicates
+  SequenceWindow reliable_window_{};
+  ReliableStats reliable_{};
+
+  // All messages received from the service, for loss and reorder detection
+  SequenceWindow sequence_window_{};
+  SequenceStats sequence_{};
+ };
+
+ /**
+  * Everything known about a single service_id. Slots are created on first use
+  * and never freed, so that the receive path can use them without locking.
+  */
+ struct ServiceSlot {
+  explicit ServiceSlot(uint16_t service_id) : service_id_(service_id) {
+  }
+
+  const uint16_t service_id_;
+
+  // Set while the service is discovered
+  std::atomic<bool> active_{false};
+
+  // track, if we have claimed the service successfully.
+  // If the service is claimed it will send its outputs to this interface.
+  std::atomic<bool> claimed_successfully_{false};
+
+  std::atomic<bool> drop_out_of_order_{false};
+
+  // Never modified once published, (un-)registering callbacks publishes a
+  // new list instead. nullptr without callbacks. Owns the CallbackExecutors,
+  // so that they outlive their use on the receive path.
+  std::atomic<std::shared_ptr<const std::vector<std::shared_ptr<ServiceIOCallbacks> > > >
+  callbacks_{};
+
+  // Protects state_. Don't send or call callbacks while holding it.
+  std::mutex mutex_{};
+  // Reset whenever the service is discovered
+  ServiceState state_{};
  };
 
  /**
@@ -39,6 +110,16 @@ namespace xbot::serviceif {
 
   static void SetBindAddress(std::string bind_address);
 
+  /**
+   * Sets the number of worker threads handling received packets, call before
+   * Start(). With 0 (the default), packets are handled on the IO thread.
+   *
+   * Services are assigned to workers by service_id, so that each service's
+   * packets are still handled in order and its callbacks are only called from
+   * a single thread.
+   */
+  static void SetWorkerThreads(size_t worker_threads);
+
   static ServiceIOImpl *GetInstance();
 
   bool Start();
@@ -59,6 +140,12 @@ namespace xbot::serviceif {
   void RegisterCallbacks(uint16_t service_id,
                          ServiceIOCallbacks *callbacks) override;
 
+  void RegisterCallbacks(uint16_t service_id, ServiceIOCallbacks *callbacks,
+                         const CallbackExecutorOptions &options) override;
+
+  bool GetCallbackStats(ServiceIOCallbacks *callbacks,
+                        CallbackStats &stats) override;
+
   /**
    * Unregister callbacks for all ids
    * @param callbacks callback pointer
@@ -71,6 +158,23 @@ namespace xbot::serviceif {
   bool SendData(uint16_t service_id,
                 const std::vector<uint8_t> &data) override;
 
+  bool SendReliable(uint16_t service_id,
+                    const std::vector<uint8_t> &data) override;
+
+  void SetTelemetryInterval(uint16_t service_id,
+                            uint32_t interval_micros) override;
+
+  bool SetOutputPolicy(uint16_t service_id,
+                       const datatypes::OutputPolicy &policy) override;
+
+  bool GetLatencyStats(uint16_t service_id, LatencyStats &stats) override;
+
+  bool GetReliableStats(uint16_t service_id, ReliableStats &stats) override;
+
+  bool GetSequenceStats(uint16_t service_id, SequenceStats &stats) override;
+
+  void SetDropOutOfOrder(uint16_t service_id, bool enabled) override;
+
   explicit ServiceIOImpl(ServiceDiscoveryImpl *serviceDiscovery);
 
   ~ServiceIOImpl() override = default;
@@ -80,12 +184,91 @@ namespace xbot::serviceif {
  private:
   ServiceDiscoveryImpl *const service_discovery;
 
+  // Received packets for the services assigned to one worker thread
+  struct Worker {
+   struct Packet {
+    std::vector<uint8_t> data;
+    uint64_t receive_time_nanos;
+   };
+
+   std::thread thread{};
+   std::mutex queue_mutex_{};
+   std::condition_variable queue_cv_{};
+   std::deque<Packet> queue_{};
+   bool stopped_{false};
+   // Incremented before and after handling packets and checks, so it is odd
+   // while the worker might call callbacks of an old list.
+   std::atomic<uint32_t> callback_section_{0};
+  };
+
+  // Empty, if packets are handled on the IO thread
+  std::vector<std::unique_ptr<Worker> > workers_{};
+
   void RunIo();
 
-  void ClaimService(uint16_t service_id);
+  /**
+   * Adds callbacks (or the executor calling them) to a service.
+   */
+  void AddCallbacks(uint16_t service_id, ServiceIOCallbacks *callbacks,
+                    std::shared_ptr<ServiceIOCallbacks> target);
+
+  void RunWorker(size_t index);
+
+  /**
+   * Called with the answer of a subscriber with its own thread to a
+   * configuration request. Warns, once all of them answered and no one
+   * handled the request.
+   */
+  void OnConfigurationAnswered(uint16_t service_id, bool handled);
+
+  /**
+   * Waits until the IO thread and the workers don't use callback lists
+   * published before this call anymore, so that callbacks removed from them
+   * can be destroyed. Returns right away, if called from a callback.
+   */
+  void WaitForCallbacks();
+
+  /**
+   * Claims unclaimed services and drops timed out ones.
+   * @param worker only check the services assigned to this worker, ignored
+   * without workers
+   */
+  void RunChecks(size_t worker);
+
+  /**
+   * Hands each xBot packet of a received datagram to the worker of its
+   * service. Drops the packet, if the worker's queue is full.
+   */
+  void Dispatch(std::vector<uint8_t> &datagram, uint64_t receive_time_nanos);
+
+  /**
+   * Handles all chained xBot packets of a received datagram.
+   */
+  void HandleDatagram(std::vector<uint8_t> &datagram,
+                      uint64_t receive_time_nanos);
+
+  /**
+   * Claims a service.
+   * @param update only update the telemetry interval and output policies of
+   * the service we already claimed
+   */
+  void ClaimService(uint16_t service_id, bool update = false);
+
+  /**
+   * Sends the new telemetry interval and output policies to a claimed
+   * service, without claiming it again.
+   */
+  void UpdateClaim(uint16_t service_id);
 
   bool TransmitPacket(uint32_t ip, uint16_t port, const std::vector<uint8_t> &data);
 
+  /**
+   * Handles a single xBot packet, a received datagram can contain multiple
+   * chained ones.
+   */
+  void HandlePacket(datatypes::XbotHeader *header, const uint8_t *payload,
+                    uint64_t receive_time_nanos);
+
   void HandleClaimMessage(datatypes::XbotHeader *header,
                           const uint8_t *payload, size_t payload_len);
 
@@ -100,6 +283,41 @@ namespace xbot::serviceif {
 
   void HandleConfigurationRequest(datatypes::XbotHeader *header,
                                   const uint8_t *payload, size_t payload_len);
+
+  void HandleTelemetryMessage(datatypes::XbotHeader *header,
+                              const uint8_t *payload, size_t payload_len);
+
+  /**
+   * Answers a time sync request right away, so that the service can
+   * estimate our clock.
+   */
+  void HandleTimeSyncRequest(datatypes::XbotHeader *header,
+                             const uint8_t *payload, size_t payload_len,
+                             uint64_t receive_time_nanos);
+
+  void RecordLatency(const datatypes::XbotHeader *header,
+                     uint64_t receive_time_nanos);
+
+  /**
+   * Acknowledges a reliable packet from the service.
+   * @return false, if the packet is a duplicate and must be dropped
+   */
+  bool AcceptReliable(const datatypes::XbotHeader *header);
+
+  /**
+   * Updates the sequence statistics of the sending service.
+   * @return false, if the packet is out of order data which must be dropped
+   */
+  bool TrackSequence(const datatypes::XbotHeader *header);
+
+  void HandleAck(const datatypes::XbotHeader *header);
+
+  /**
+   * Retransmits overdue reliable packets.
+   * @return time until the next packet is due, or until the next regular
+   * check, if nothing is in flight
+   */
+  std::chrono::microseconds RetransmitReliable();
  };
 } // namespace xbot::serviceif
 #endif  // XBOT_FRAMEWORK_SERVICEIOIMPL_HPP
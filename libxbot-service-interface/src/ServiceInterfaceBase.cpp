@@ -1,8 +1,10 @@
 //
 // Created by clemens on 7/17/24.
 //
+#include <limits>
 #include <utility>
 #include <xbot-service-interface/ServiceInterfaceBase.hpp>
+#include <xbot-service-interface/time_utils.hpp>
 
 #include "spdlog/spdlog.h"
 using namespace xbot::serviceif;
@@ -20,7 +22,42 @@ void ServiceInterfaceBase::Start() {
   ctx.serviceDiscovery->RegisterCallbacks(this);
 }
 
+bool ServiceInterfaceBase::SetOutputPolicy(uint16_t output_id,
+                                           datatypes::OutputPolicyMode mode,
+                                           uint32_t param) {
+  datatypes::OutputPolicy policy{};
+  policy.output_id = output_id;
+  policy.mode = mode;
+  policy.param = param;
+  return ctx.io->SetOutputPolicy(service_id_, policy);
+}
+
+bool ServiceInterfaceBase::SetOutputMaxRate(uint16_t output_id,
+                                            float rate_hz) {
+  // Also rejects NaN
+  if (!(rate_hz > 0)) {
+    spdlog::error("Invalid output rate: {}", rate_hz);
+    return false;
+  }
+  const double interval_micros = 1000000.0 / rate_hz;
+  if (interval_micros > std::numeric_limits<uint32_t>::max()) {
+    spdlog::error("Output rate too low: {} Hz", rate_hz);
+    return false;
+  }
+  return SetOutputPolicy(output_id, datatypes::OutputPolicyMode::MAX_RATE,
+                         static_cast<uint32_t>(interval_micros));
+}
+
+void ServiceInterfaceBase::SetDropOutOfOrder(bool enabled) {
+  ctx.io->SetDropOutOfOrder(service_id_, enabled);
+}
+
 bool ServiceInterfaceBase::StartTransaction(bool is_configuration) {
+  return StartTransaction(is_configuration, false);
+}
+
+bool ServiceInterfaceBase::StartTransaction(bool is_configuration,
+                                            bool is_update) {
   // Lock like this, we need to keep locked until CommitTransaction()
   state_mutex_.lock();
   if (transaction_started_) {
@@ -29,6 +66,18 @@ bool ServiceInterfaceBase::StartTransaction(bool is_configuration) {
   }
   transaction_started_ = true;
   is_configuration_transaction_ = is_configuration;
+  is_configuration_update_ = is_update;
+  if (is_configuration) {
+    // Registers of a lost configuration must not be skipped as unchanged
+    ReliableStats stats{};
+    const bool failed = ctx.io->GetReliableStats(service_id_, stats) &&
+                        stats.failures != reliable_failures_seen_;
+    reliable_failures_seen_ = stats.failures;
+    if (!is_update || failed) {
+      // The full configuration replaces everything the service had
+      ClearSentRegisters();
+    }
+  }
   buffer_.resize(sizeof(xbot::datatypes::XbotHeader));
   FillHeader();
 
@@ -39,6 +88,15 @@ bool ServiceInterfaceBase::StartTransaction(bool is_configuration) {
   return true;
 }
 
+bool ServiceInterfaceBase::StartConfigurationUpdate() {
+  return StartTransaction(true, true);
+}
+
+bool ServiceInterfaceBase::IsConfigurationUpdate() {
+  std::unique_lock lk{state_mutex_};
+  return transaction_started_ && is_configuration_update_;
+}
+
 bool ServiceInterfaceBase::CommitTransaction() {
   std::unique_lock lk{state_mutex_};
   if (!transaction_started_) {
@@ -61,7 +119,13 @@ bool ServiceInterfaceBase::CommitTransaction() {
   auto header_ptr =
       reinterpret_cast<xbot::datatypes::XbotHeader *>(buffer_.data());
   header_ptr->message_type = xbot::datatypes::MessageType::TRANSACTION;
-  if (is_configuration_transaction_) {
+  if (is_configuration_update_) {
+    if (buffer_.size() == sizeof(xbot::datatypes::XbotHeader)) {
+      // No register changed
+      return true;
+    }
+    header_ptr->arg1 = 2;
+  } else if (is_configuration_transaction_) {
     header_ptr->arg1 = 1;
   } else {
     header_ptr->arg1 = 0;
@@ -69,9 +133,19 @@ bool ServiceInterfaceBase::CommitTransaction() {
   header_ptr->payload_size =
       buffer_.size() - sizeof(xbot::datatypes::XbotHeader);
 
+  if (is_configuration_transaction_) {
+    // Retransmit lost configurations right away, instead of waiting for the
+    // service to request the configuration again
+    return ctx.io->SendReliable(service_id_, buffer_);
+  }
   return ctx.io->SendData(service_id_, buffer_);
 }
 
+void ServiceInterfaceBase::InvalidateSentRegisters() {
+  std::unique_lock lk{state_mutex_};
+  ClearSentRegisters();
+}
+
 bool ServiceInterfaceBase::SendData(uint16_t target_id, const void *data,
                                     size_t size, bool is_configuration) {
   if (!service_discovered_) {
@@ -156,7 +230,6 @@ bool ServiceInterfaceBase::OnEndpointChanged(
 }
 
 void ServiceInterfaceBase::FillHeader() {
-  using namespace std::chrono;
   header_.service_id = service_id_;
   header_.message_type = xbot::datatypes::MessageType::UNKNOWN;
   header_.payload_size = 0;
@@ -168,7 +241,5 @@ void ServiceInterfaceBase::FillHeader() {
     // Clear reboot flag on rolloger
     header_.flags &= 0xFE;
   }
-  header_.timestamp =
-      duration_cast<microseconds>(steady_clock::now().time_since_epoch())
-      .count();
+  header_.timestamp = GetTimestampNanos();
 }
@@ -9,6 +9,7 @@
 
 #include "CrowToSpeedlogHandler.hpp"
 #include "PlotJugglerBridge.hpp"
+#include "RemoteLogImpl.hpp"
 #include "ServiceDiscoveryImpl.hpp"
 #include "ServiceIOImpl.hpp"
 
@@ -28,7 +29,9 @@ std::unique_ptr<crow::SimpleApp> crow_app = nullptr;
 void SignalHandler(int signal) { Stop(); }
 struct sigaction act;
 
-xbot::serviceif::Context xbot::serviceif::Start(bool register_handlers, std::string bind_ip) {
+xbot::serviceif::Context xbot::serviceif::Start(bool register_handlers, std::string bind_ip,
+                                                size_t io_worker_threads,
+                                                PlotJugglerEncoding plotjuggler_encoding) {
   std::unique_lock lk{mtx};
 
   if (started) {
@@ -40,6 +43,7 @@ xbot::serviceif::Context xbot::serviceif::Start(bool register_handlers, std::str
   ServiceDiscoveryImpl::SetMulticastIfAddress(bind_ip);
   // Service IO needs to bind to the specified interface (unicast)
   ServiceIOImpl::SetBindAddress(bind_ip);
+  ServiceIOImpl::SetWorkerThreads(io_worker_threads);
 
   //
   //  // Register signal handler for graceful shutdown
@@ -51,15 +55,18 @@ xbot::serviceif::Context xbot::serviceif::Start(bool register_handlers, std::str
 
   const auto ioImpl = ServiceIOImpl::GetInstance();
   const auto sdImpl = ServiceDiscoveryImpl::GetInstance();
+  const auto logImpl = RemoteLogImpl::GetInstance();
 
-  ctx = {.io = ioImpl, .serviceDiscovery = sdImpl};
+  ctx = {.io = ioImpl, .serviceDiscovery = sdImpl, .remoteLog = logImpl};
 
   // Register the ServiceIO before starting service discovery
   // this way, whenever a service is found, ServiceIO claims it automatically
   ctx.serviceDiscovery->RegisterCallbacks(ioImpl);
 
-  pjb = std::make_unique<PlotJugglerBridge>(ctx);
+  pjb = std::make_unique<PlotJugglerBridge>(ctx, plotjuggler_encoding);
   pjb->Start();
+  // Start log processing first, both IO and service discovery forward logs to it
+  logImpl->Start();
   ioImpl->Start();
   sdImpl->Start();
 
@@ -112,6 +119,7 @@ void xbot::serviceif::Stop() {
   if (started) {
     dynamic_cast<ServiceDiscoveryImpl *>(ctx.serviceDiscovery)->Stop();
     dynamic_cast<ServiceIOImpl *>(ctx.io)->Stop();
+    dynamic_cast<RemoteLogImpl *>(ctx.remoteLog)->Stop();
     if (crow_app) {
       crow_app->stop();
     }
@@ -0,0 +1,91 @@
+//
+// Compares the BlockingQueue against the LockFreeQueue used for the per
+// service packet queue.
+//
+// Throughput: one producer pushes as fast as it can (waiting while the queue is
+// full), the consumer pops with a timeout (like Service::runProcessing does).
+// Latency: the producer pushes one timestamped item at a time while the
+// consumer is parked, this is what happens for every received packet.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <xbot-service/portable/queue.hpp>
+
+using namespace xbot::service::queue;
+using Clock = std::chrono::steady_clock;
+
+static constexpr size_t queue_length = 10;
+static constexpr size_t throughput_items = 2000000;
+static constexpr size_t latency_items = 20000;
+
+template <typename Queue>
+double BenchmarkThroughput() {
+  Queue queue{};
+  void* buffer[queue_length];
+  queue.init(queue_length, buffer, sizeof(buffer));
+  static uint8_t dummy;
+
+  const auto start = Clock::now();
+  std::thread producer{[&]() {
+    for (size_t i = 0; i < throughput_items; i++) {
+      while (!queue.push(&dummy, 1000)) {
+      }
+    }
+  }};
+  for (size_t i = 0; i < throughput_items;) {
+    if (queue.pop(1000) != nullptr) {
+      i++;
+    }
+  }
+  producer.join();
+  const std::chrono::duration<double> elapsed = Clock::now() - start;
+  return throughput_items / elapsed.count();
+}
+
+template <typename Queue>
+std::vector<int64_t> BenchmarkLatency() {
+  Queue queue{};
+  void* buffer[queue_length];
+  queue.init(queue_length, buffer, sizeof(buffer));
+  std::vector<Clock::time_point> sent(latency_items);
+  std::vector<int64_t> latencies{};
+  latencies.reserve(latency_items);
+
+  std::thread producer{[&]() {
+    for (size_t i = 0; i < latency_items; i++) {
+      // Give the consumer time to park
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      sent[i] = Clock::now();
+      queue.push(&sent[i], 0);
+    }
+  }};
+  while (latencies.size() < latency_items) {
+    void* item = queue.pop(1000000);
+    if (item == nullptr) continue;
+    const auto now = Clock::now();
+    latencies.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - *static_cast<Clock::time_point*>(item))
+            .count());
+  }
+  producer.join();
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+template <typename Queue>
+void RunBenchmark(const char* name) {
+  const double throughput = BenchmarkThroughput<Queue>();
+  const auto latencies = BenchmarkLatency<Queue>();
+  printf("%-16s throughput: %10.0f items/s, wakeup latency p50: %6ld ns, p99: %6ld ns, max: %8ld ns\n", name,
+         throughput, latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100], latencies.back());
+}
+
+int main() {
+  RunBenchmark<BlockingQueue>("BlockingQueue");
+  RunBenchmark<LockFreeQueue>("LockFreeQueue");
+  return 0;
+}
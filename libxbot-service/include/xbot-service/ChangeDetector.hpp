@@ -0,0 +1,68 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef CHANGEDETECTOR_HPP
+#define CHANGEDETECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace xbot::service {
+/**
+ * Remembers the last value sent for an output, so that unchanged values
+ * don't need to be sent again. A keyframe interval still refreshes the
+ * value periodically, as long as it is being published.
+ *
+ * Times are wrapping uint32_t micros. Not thread safe, the generated code
+ * protects it with the state_mutex_.
+ */
+template <size_t MaxSize>
+class ChangeDetector {
+ public:
+  /**
+   * @param keyframe_interval_micros max. time between two sends, 0 to only
+   * send changes
+   * @return true, if the value differs from the last one sent or the
+   * keyframe is due
+   */
+  bool needsSend(const void *data, size_t size, uint32_t now_micros, uint32_t keyframe_interval_micros) const {
+    if (!valid_ || size != size_) {
+      return true;
+    }
+    if (keyframe_interval_micros > 0 && now_micros - last_sent_micros_ >= keyframe_interval_micros) {
+      return true;
+    }
+    // Compare bytes, so that e.g. NaN == NaN
+    return memcmp(last_value_, data, size) != 0;
+  }
+
+  /**
+   * Remembers the value, call this after it was sent successfully.
+   */
+  void markSent(const void *data, size_t size, uint32_t now_micros) {
+    if (size > MaxSize) {
+      valid_ = false;
+      return;
+    }
+    memcpy(last_value_, data, size);
+    size_ = size;
+    last_sent_micros_ = now_micros;
+    valid_ = true;
+  }
+
+  /**
+   * Sends the next value regardless of changes, e.g. for a new interface.
+   */
+  void invalidate() { valid_ = false; }
+
+ private:
+  uint8_t last_value_[MaxSize]{};
+  size_t size_ = 0;
+  uint32_t last_sent_micros_ = 0;
+  bool valid_ = false;
+};
+}  // namespace xbot::service
+
+#endif  // CHANGEDETECTOR_HPP
@@ -0,0 +1,82 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef CLOCKSYNC_HPP
+#define CLOCKSYNC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <xbot/config.hpp>
+
+namespace xbot::service {
+/**
+ * Estimates offset and drift of the local clock to a reference clock from
+ * NTP style request / response exchanges.
+ *
+ * Only the exchange with the shortest round trip out of the last
+ * config::time_sync_window ones is used, because its offset is disturbed the
+ * least by queuing delays. The drift is estimated from consecutive selected
+ * exchanges and used to extrapolate between them.
+ *
+ * Not thread safe.
+ */
+class ClockSync {
+ public:
+  /**
+   * Adds a completed exchange.
+   * @param request_sent local time the request was sent
+   * @param request_received reference time the request was received
+   * @param response_sent reference time the response was sent
+   * @param response_received local time the response was received
+   */
+  void addSample(uint64_t request_sent, uint64_t request_received, uint64_t response_sent,
+                 uint64_t response_received);
+
+  /**
+   * Forgets all samples, e.g. when the reference changes.
+   */
+  void reset();
+
+  /**
+   * @return true, once enough samples were added to trust the estimate
+   */
+  bool isSynchronized() const;
+
+  /**
+   * Converts a local time to the reference clock. Returns the local time as
+   * is, if not synchronized.
+   */
+  uint64_t toReference(uint64_t local_nanos) const;
+
+  int64_t getOffsetNanos() const { return offset_nanos_; }
+  // Reference clock nanos gained per local nano
+  double getDrift() const { return drift_; }
+  uint64_t getRoundTripNanos() const { return round_trip_nanos_; }
+
+ private:
+  struct Sample {
+    uint64_t local_nanos;
+    int64_t offset_nanos;
+    uint64_t round_trip_nanos;
+  };
+
+  Sample samples_[config::time_sync_window]{};
+  size_t sample_count_ = 0;
+  size_t next_sample_ = 0;
+  uint32_t total_samples_ = 0;
+
+  // The current estimate, taken from the selected sample
+  bool has_estimate_ = false;
+  uint64_t local_nanos_ = 0;
+  int64_t offset_nanos_ = 0;
+  uint64_t round_trip_nanos_ = 0;
+  double drift_ = 0;
+  bool has_drift_ = false;
+  // The sample the drift was last measured against
+  uint64_t drift_local_nanos_ = 0;
+  int64_t drift_offset_nanos_ = 0;
+};
+}  // namespace xbot::service
+
+#endif  // CLOCKSYNC_HPP
@@ -0,0 +1,50 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef INPUTHANDLER_HPP
+#define INPUTHANDLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <xbot/config.hpp>
+#include <xbot/datatypes/XbotHeader.hpp>
+
+namespace xbot::service {
+/**
+ * @return true, if length is a valid payload length for an input with elements of element_size.
+ * Scalar inputs need exactly element_size bytes.
+ */
+constexpr bool isValidInputLength(size_t length, size_t element_size, bool is_array) {
+  if (!is_array) {
+    return length == element_size;
+  }
+  return element_size == 1 || length % element_size == 0;
+}
+
+/**
+ * Entry of the generated input dispatch table, indexed by input id.
+ * The handler is only called with a valid payload length.
+ */
+template <typename ServiceT>
+struct InputHandler {
+  // nullptr for unused ids
+  bool (ServiceT::*handler)(const void *payload, size_t length);
+  uint32_t element_size;
+  // false for scalar inputs, which need exactly element_size bytes
+  bool is_array;
+
+  constexpr bool isValidLength(size_t length) const {
+    return isValidInputLength(length, element_size, is_array);
+  }
+};
+
+/**
+ * @return true, if an input of this size can be received at all.
+ */
+constexpr bool inputFitsPacket(size_t size) {
+  return size <= config::max_packet_size - sizeof(datatypes::XbotHeader);
+}
+}  // namespace xbot::service
+
+#endif  // INPUTHANDLER_HPP
@@ -5,21 +5,41 @@
 #ifndef IO_H
 #define IO_H
 #include <xbot-service/ServiceIo.h>
+#include <xbot-service/portable/thread.hpp>
 namespace xbot::service {
 class Io {
  public:
   // Register a new service for IO.
   // This service will then be able to receive
+  // Returns false, if the service_id is already taken or
+  // config::max_service_count services are registered.
+  // Safe to call while IO is running.
   static bool registerServiceIo(ServiceIo* service);
 
+  // Unregister a service. Once this returns, the service won't receive any
+  // more packets.
+  static bool unregisterServiceIo(ServiceIo* service);
+
   static bool transmitPacket(packet::PacketPtr packet,
                                          uint32_t ip, uint16_t port);
   static bool transmitPacket(packet::PacketPtr packet,
                                          const char*ip, uint16_t port);
+  // Transmit header and payload from the caller's buffers, see
+  // sock::transmitSegments().
+  static bool transmitSegments(const packet::PacketSegment* segments,
+                               size_t segment_count, uint32_t ip,
+                               uint16_t port);
 
   static bool getEndpoint(char* ip, size_t ip_len, uint16_t* port);
 
+  // Packets which were accepted by transmitPacket(), but could not be sent
+  // later on (e.g. a failed TX batch). Counted for all services.
+  static uint32_t getTxBatchFailures();
+
   static bool start();
+  // Start with custom attributes for the IO thread, e.g. a real-time
+  // priority above the services it delivers to.
+  static bool start(const thread::ThreadAttributes& attributes);
 };
 }  // namespace xbot::service
 
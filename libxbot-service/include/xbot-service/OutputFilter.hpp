@@ -0,0 +1,97 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef OUTPUTFILTER_HPP
+#define OUTPUTFILTER_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <xbot/datatypes/OutputPolicy.hpp>
+
+namespace xbot::service {
+/**
+ * Applies the publish policy the interface requested for an output, so that
+ * unneeded samples are dropped before they are serialized.
+ *
+ * Times are wrapping uint32_t micros. Not thread safe, the generated code
+ * protects it with the state_mutex_.
+ */
+class OutputFilter {
+ public:
+  void setPolicy(datatypes::OutputPolicyMode mode, uint32_t param);
+
+  /**
+   * Back to full rate, drops the current window.
+   */
+  void reset() { *this = OutputFilter{}; }
+
+  /**
+   * Decides, whether a sample needs to be sent. For the window modes, value
+   * is replaced by the aggregate of the window, once it has elapsed.
+   * @param value the sample
+   * @param now_micros the current time
+   * @return true, if value needs to be sent
+   */
+  template <typename T>
+  bool filter(T *value, uint32_t now_micros) {
+    if (mode_ == datatypes::OutputPolicyMode::FULL_RATE) {
+      return true;
+    }
+    if constexpr (std::is_arithmetic_v<T>) {
+      if (isWindowed()) {
+        double aggregate = 0;
+        if (!addSample(static_cast<double>(*value), now_micros, &aggregate)) {
+          return false;
+        }
+        if constexpr (std::is_integral_v<T>) {
+          aggregate = std::round(aggregate);
+        }
+        *value = static_cast<T>(aggregate);
+        return true;
+      }
+    }
+    return accept(now_micros);
+  }
+
+  /**
+   * Decides, whether a sample which can't be aggregated (e.g. an array)
+   * needs to be sent. The window modes send one sample per window.
+   */
+  bool accept(uint32_t now_micros);
+
+  /**
+   * Adds a sample to the current window.
+   * @param aggregate set to the aggregate, if the window has elapsed
+   * @return true, if the window has elapsed and aggregate needs to be sent
+   */
+  bool addSample(double value, uint32_t now_micros, double *aggregate);
+
+  datatypes::OutputPolicyMode getMode() const { return mode_; }
+
+ private:
+  bool isWindowed() const {
+    return mode_ == datatypes::OutputPolicyMode::WINDOW_MIN ||
+           mode_ == datatypes::OutputPolicyMode::WINDOW_MAX ||
+           mode_ == datatypes::OutputPolicyMode::WINDOW_MEAN;
+  }
+
+  datatypes::OutputPolicyMode mode_ = datatypes::OutputPolicyMode::FULL_RATE;
+  uint32_t param_ = 0;
+
+  // EVERY_NTH: samples since the last one sent
+  uint32_t skipped_ = 0;
+  // MAX_RATE: time of the last sample sent
+  bool has_sent_ = false;
+  uint32_t last_sent_micros_ = 0;
+  // Window modes: the samples since window_start_micros_
+  uint32_t window_start_micros_ = 0;
+  uint32_t window_count_ = 0;
+  double window_min_ = 0;
+  double window_max_ = 0;
+  double window_sum_ = 0;
+};
+}  // namespace xbot::service
+
+#endif  // OUTPUTFILTER_HPP
@@ -0,0 +1,93 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef RELIABLESENDER_HPP
+#define RELIABLESENDER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <xbot-service/portable/packet.hpp>
+#include <xbot/RttEstimator.hpp>
+#include <xbot/config.hpp>
+
+namespace xbot::service {
+/**
+ * Keeps copies of packets sent with datatypes::FLAG_RELIABLE until they are
+ * acknowledged and tells when to retransmit them.
+ *
+ * Not thread safe.
+ */
+class ReliableSender {
+ public:
+  // Returned by poll(), if no packet is waiting for its ACK.
+  static constexpr uint32_t NOTHING_IN_FLIGHT = UINT32_MAX;
+
+  typedef void (*RetransmitCallback)(packet::PacketPtr packet, void *arg);
+
+  ReliableSender() = default;
+  ~ReliableSender();
+
+  ReliableSender(const ReliableSender &) = delete;
+  ReliableSender &operator=(const ReliableSender &) = delete;
+
+  /**
+   * Keeps the packet until its ACK arrives. Takes ownership of the packet.
+   * @param sequence_no sequence number in the packet's header
+   * @param packet copy of the sent packet
+   * @param now_micros the time the packet was sent
+   * @return false, if config::service::reliable_max_in_flight packets are
+   * already waiting. The packet is freed then.
+   */
+  bool track(uint16_t sequence_no, packet::PacketPtr packet, uint32_t now_micros);
+
+  /**
+   * Counts a packet which could not be sent reliably, e.g. because there was
+   * no free packet for its copy.
+   */
+  void countFailure() { failures_++; }
+
+  /**
+   * Handles an ACK.
+   * @return true, if the packet was waiting for it
+   */
+  bool acknowledge(uint16_t sequence_no, uint32_t now_micros);
+
+  /**
+   * Calls the callback for every packet whose ACK is overdue. The callback
+   * needs to send a copy, the packet stays owned by the ReliableSender.
+   * Packets are given up after config::reliable_max_retransmits.
+   * @return micros until the next packet is due, NOTHING_IN_FLIGHT if none is
+   * waiting
+   */
+  uint32_t poll(uint32_t now_micros, RetransmitCallback callback, void *arg);
+
+  /**
+   * Gives up all packets, e.g. when a different interface claims the service.
+   */
+  void reset();
+
+  size_t getInFlight() const { return in_flight_; }
+  uint32_t getRetransmits() const { return retransmits_; }
+  // Packets which were given up or could not be tracked
+  uint32_t getFailures() const { return failures_; }
+  uint32_t getRttMicros() const { return rtt_.getRttMicros(); }
+
+ private:
+  struct Entry {
+    packet::PacketPtr packet;
+    uint16_t sequence_no;
+    uint32_t sent_micros;
+    uint32_t due_micros;
+    uint32_t retransmits;
+  };
+
+  Entry entries_[config::service::reliable_max_in_flight]{};
+  size_t in_flight_ = 0;
+  RttEstimator rtt_{};
+  uint32_t retransmits_ = 0;
+  uint32_t failures_ = 0;
+};
+}  // namespace xbot::service
+
+#endif  // RELIABLESENDER_HPP
@@ -5,6 +5,110 @@
 #ifndef REMOTELOGGING_HPP
 #define REMOTELOGGING_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <xbot/config.hpp>
+#include <xbot/datatypes/LogPayload.hpp>
+
+/**
+ * Starts the remote logging sender. Records logged with the XBOT_LOG_*
+ * macros and ulog messages are sent as LOG messages to
+ * config::remote_log_multicast_address.
+ */
 bool startRemoteLogging();
 
+namespace xbot::service::logging {
+/**
+ * Puts a record into the log buffer. Use the XBOT_LOG_* macros instead.
+ * @param format printf style format string, needs to stay valid forever
+ * (i.e. a string literal)
+ * @param args encoded arguments, see datatypes::LogArgType
+ * @return false, if logging was not started or the buffer is full
+ */
+bool enqueueRecord(datatypes::LogLevel level, uint16_t service_id, const char *format, const uint8_t *args,
+                   uint16_t args_size, uint8_t arg_count);
+
+/**
+ * @return number of records which were dropped because the buffer was full
+ */
+uint32_t getDroppedRecords();
+
+/**
+ * Appends a single argument to the encoded arguments.
+ * @return false, if the argument did not fit
+ */
+template <typename T>
+bool encodeArg(uint8_t *&buffer, const uint8_t *end, const T &value) {
+  using V = std::decay_t<T>;
+  datatypes::LogArgType type;
+  uint64_t raw;
+  if constexpr (std::is_same_v<V, const char *> || std::is_same_v<V, char *>) {
+    const char *str = value != nullptr ? value : "(null)";
+    if (end - buffer < 2) return false;
+    // Cut off strings which don't fit
+    size_t length = strnlen(str, UINT8_MAX);
+    if (length > static_cast<size_t>(end - buffer) - 2) {
+      length = end - buffer - 2;
+    }
+    *buffer++ = static_cast<uint8_t>(datatypes::LogArgType::STRING);
+    *buffer++ = static_cast<uint8_t>(length);
+    memcpy(buffer, str, length);
+    buffer += length;
+    return true;
+  } else if constexpr (std::is_floating_point_v<V>) {
+    type = datatypes::LogArgType::DOUBLE;
+    const double d = value;
+    memcpy(&raw, &d, sizeof(raw));
+  } else if constexpr (std::is_enum_v<V>) {
+    type = datatypes::LogArgType::INT;
+    raw = static_cast<uint64_t>(static_cast<int64_t>(value));
+  } else if constexpr (std::is_integral_v<V> && std::is_signed_v<V>) {
+    type = datatypes::LogArgType::INT;
+    raw = static_cast<uint64_t>(static_cast<int64_t>(value));
+  } else if constexpr (std::is_integral_v<V>) {
+    type = datatypes::LogArgType::UINT;
+    raw = value;
+  } else {
+    static_assert(std::is_pointer_v<V>, "Unsupported log argument type");
+    type = datatypes::LogArgType::POINTER;
+    raw = reinterpret_cast<uintptr_t>(value);
+  }
+  if (end - buffer < static_cast<ptrdiff_t>(1 + sizeof(raw))) return false;
+  *buffer++ = static_cast<uint8_t>(type);
+  memcpy(buffer, &raw, sizeof(raw));
+  buffer += sizeof(raw);
+  return true;
+}
+
+/**
+ * Logs a record without formatting it. The arguments are copied, so that
+ * formatting can happen on the receiving side.
+ */
+template <typename... Args>
+bool log(datatypes::LogLevel level, uint16_t service_id, const char *format, const Args &...args) {
+  uint8_t buffer[config::remote_log_max_args_size];
+  uint8_t *ptr = buffer;
+  const uint8_t *const end = buffer + sizeof(buffer);
+  uint8_t arg_count = 0;
+  // Stop at the first argument which does not fit
+  (void)((encodeArg(ptr, end, args) && ++arg_count) && ...);
+  return enqueueRecord(level, service_id, format, buffer, static_cast<uint16_t>(ptr - buffer), arg_count);
+}
+}  // namespace xbot::service::logging
+
+// The format needs to be a string literal, because only its address is
+// stored until the record is sent.
+#define XBOT_LOG(level, service_id, format, ...) \
+  xbot::service::logging::log(level, service_id, "" format "" __VA_OPT__(, ) __VA_ARGS__)
+#define XBOT_LOG_DEBUG(service_id, format, ...) \
+  XBOT_LOG(xbot::datatypes::LogLevel::DEBUG_LEVEL, service_id, format __VA_OPT__(, ) __VA_ARGS__)
+#define XBOT_LOG_INFO(service_id, format, ...) \
+  XBOT_LOG(xbot::datatypes::LogLevel::INFO_LEVEL, service_id, format __VA_OPT__(, ) __VA_ARGS__)
+#define XBOT_LOG_WARNING(service_id, format, ...) \
+  XBOT_LOG(xbot::datatypes::LogLevel::WARNING_LEVEL, service_id, format __VA_OPT__(, ) __VA_ARGS__)
+#define XBOT_LOG_ERROR(service_id, format, ...) \
+  XBOT_LOG(xbot::datatypes::LogLevel::ERROR_LEVEL, service_id, format __VA_OPT__(, ) __VA_ARGS__)
+
 #endif  // REMOTELOGGING_HPP
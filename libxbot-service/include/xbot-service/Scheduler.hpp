@@ -0,0 +1,92 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <xbot/config.hpp>
+
+namespace xbot::service {
+/**
+ * Keeps periodic tasks in a min-heap ordered by their next deadline, so that
+ * the caller knows exactly how long it can sleep.
+ *
+ * Times are wrapping uint32_t micros, intervals must be shorter than 2^31
+ * micros. The scheduler is not thread safe, only use it from a single thread.
+ */
+class Scheduler {
+ public:
+  typedef void (*TaskCallback)(void *arg);
+
+  static constexpr int INVALID_TASK = -1;
+  // Returned by run(), if no task is enabled.
+  static constexpr uint32_t NO_TASK_DUE = UINT32_MAX;
+
+  /**
+   * Adds a new task. The task is disabled until setInterval() is called.
+   * @param callback function to call when the task is due
+   * @param arg argument for the callback
+   * @return the task id, INVALID_TASK if there is no space left
+   */
+  int addTask(TaskCallback callback, void *arg);
+
+  /**
+   * Changes the interval of a task.
+   * @param task_id the task to change
+   * @param interval_micros time between two runs, 0 disables the task
+   * @param next_due_micros when the task should run next
+   * @return true on success
+   */
+  bool setInterval(int task_id, uint32_t interval_micros, uint32_t next_due_micros);
+
+  /**
+   * Runs all tasks which are due. Tasks are rescheduled before their callback
+   * is called, so a callback can change its own interval.
+   * @param now_micros the current time
+   * @return micros until the next task is due, NO_TASK_DUE if none is enabled
+   */
+  uint32_t run(uint32_t now_micros);
+
+  /**
+   * @return micros until the next task is due, NO_TASK_DUE if none is enabled
+   */
+  uint32_t getMicrosUntilNextTask(uint32_t now_micros) const;
+
+  /**
+   * @return how often the task was rescheduled, because it missed a whole
+   * interval.
+   */
+  uint32_t getOverruns(int task_id) const;
+
+ private:
+  struct Task {
+    TaskCallback callback;
+    void *arg;
+    uint32_t interval_micros;
+    uint32_t due_micros;
+    uint32_t overruns;
+    // Position in heap_, only valid if interval_micros > 0
+    size_t heap_index;
+  };
+
+  Task tasks_[config::service::max_scheduled_tasks]{};
+  size_t task_count_ = 0;
+
+  // Ids of enabled tasks, heap_[0] is due first
+  int heap_[config::service::max_scheduled_tasks]{};
+  size_t heap_size_ = 0;
+
+  bool isValid(int task_id) const;
+  void heapInsert(int task_id);
+  void heapRemove(int task_id);
+  void siftUp(size_t index);
+  void siftDown(size_t index);
+  void heapSwap(size_t a, size_t b);
+  bool dueBefore(size_t a, size_t b) const;
+};
+}  // namespace xbot::service
+
+#endif  // SCHEDULER_HPP
@@ -9,8 +9,14 @@
 
 #include <xbot/config.hpp>
 
+#include "ClockSync.hpp"
+#include "ReliableSender.hpp"
+#include "Scheduler.hpp"
 #include "portable/queue.hpp"
 #include "portable/thread.hpp"
+#include "xbot/datatypes/OutputPolicy.hpp"
+#include "xbot/datatypes/TelemetryPayload.hpp"
+#include "xbot/SequenceWindow.hpp"
 #include "xbot/datatypes/XbotHeader.hpp"
 
 namespace xbot::service {
@@ -30,6 +36,14 @@ class Service : public ServiceIo {
    */
   bool start();
 
+  /**
+   * Sets name, scheduling, CPU affinity and stack of the processing thread,
+   * e.g. to run a control service with real-time priority on its own core.
+   * Call this before start(). If no stack is set, the one passed to the
+   * constructor is used. If no name is set, GetName() is used.
+   */
+  void setThreadAttributes(const thread::ThreadAttributes &attributes);
+
   /**
    * Since the portable thread implementation does not know what a class is, we
    * use this helper to start the service.
@@ -49,17 +63,74 @@ class Service : public ServiceIo {
   // Track, if we have already started a transaction
   bool transaction_started_ = false;
 
+  // True, while the outputs of a callback are coalesced into an implicit
+  // transaction.
+  bool implicit_transaction_ = false;
+
+  // Timestamp and index of the next fragment for the current transaction.
+  // Transactions which don't fit into the scratch_buffer are split into
+  // multiple packets sharing the same timestamp.
+  uint64_t transaction_timestamp_ = 0;
+  uint16_t transaction_fragment_ = 0;
+  // True, if a reliable output was added to the current transaction
+  bool transaction_reliable_ = false;
+
   // Scratch space for the header.
   // Needs to be protected by a mutex, becuase SendData might
   // be called from a different thread
   datatypes::XbotHeader header_{};
 
-  bool SendData(uint16_t target_id, const void *data, size_t size);
+  /**
+   * Sends an output or adds it to the current transaction.
+   * @param reliable retransmit until the interface acknowledges it. Within a
+   * transaction, this applies to the whole transaction.
+   */
+  bool SendData(uint16_t target_id, const void *data, size_t size, bool reliable = false);
 
+  /**
+   * Starts a transaction.
+   * @param timestamp timestamp of the data, 0 for now. Use GetTimestamp() to
+   * get the time base of the header.
+   */
   bool StartTransaction(uint64_t timestamp = 0);
 
   bool CommitTransaction();
 
+  /**
+   * If enabled, all outputs sent from tick() or an input callback are
+   * collected and sent as a single transaction once the callback returns.
+   * Explicit transactions within these callbacks become part of it.
+   * Outputs sent from other threads are not coalesced.
+   * Call this before start() or from the processing thread.
+   */
+  void SetOutputCoalescing(bool enabled) { coalesce_outputs_ = enabled; }
+
+  /**
+   * @return the current time in nanoseconds, in the claiming interface's time
+   * base once synchronized to it.
+   */
+  uint64_t GetTimestamp();
+
+  /**
+   * Registers a function which is called periodically by the processing
+   * thread, regardless of whether the service is running.
+   * Only call this from the processing thread (e.g. in OnCreate()).
+   * @param callback function to call
+   * @param arg argument for the callback
+   * @param interval_micros time between two calls, 0 to add it disabled
+   * @return the task id, Scheduler::INVALID_TASK if there is no space left
+   */
+  int AddPeriodicTask(Scheduler::TaskCallback callback, void *arg, uint32_t interval_micros);
+
+  /**
+   * Changes the interval of a periodic task, the next call happens
+   * interval_micros from now.
+   * Only call this from the processing thread.
+   * @param task_id id returned by AddPeriodicTask()
+   * @param interval_micros time between two calls, 0 to disable the task
+   */
+  bool SetPeriodicTaskInterval(int task_id, uint32_t interval_micros);
+
   /**
    * Called before OnStart
    * @return true, if configuration was success
@@ -91,34 +162,105 @@ class Service : public ServiceIo {
    * The main thread for the service.
    * Here the implementation can do its processing.
    */
-  void *processing_thread_stack_;
-  size_t processing_thread_stack_size_;
+  thread::ThreadAttributes thread_attributes_{};
   XBOT_THREAD_TYPEDEF process_thread_{};
 
   uint32_t tick_rate_micros_;
-  uint32_t last_tick_micros_ = 0;
-  uint32_t last_service_discovery_micros_ = 0;
-  uint32_t last_heartbeat_micros_ = 0;
   uint32_t heartbeat_micros_ = 0;
   uint32_t target_ip = 0;
   uint32_t target_port = 0;
-  uint32_t last_configuration_request_micros_ = 0;
+
+  // Owns all periodic duties, only used by the processing thread.
+  Scheduler scheduler_{};
+  int tick_task_ = Scheduler::INVALID_TASK;
+  int heartbeat_task_ = Scheduler::INVALID_TASK;
+  int advertisement_task_ = Scheduler::INVALID_TASK;
+  int configuration_request_task_ = Scheduler::INVALID_TASK;
+  int telemetry_task_ = Scheduler::INVALID_TASK;
+  int time_sync_task_ = Scheduler::INVALID_TASK;
+
+  // Estimates the claiming interface's clock, protected by state_mutex_
+  ClockSync clock_sync_{};
+  // Local time of the outstanding time sync request
+  uint64_t time_sync_request_sent_ = 0;
+
+  // Telemetry is only measured, if the claiming interface asked for it
+  // (interval > 0).
+  uint32_t telemetry_interval_micros_ = 0;
+  datatypes::TelemetryPayload telemetry_{};
+  uint32_t last_tick_start_micros_ = 0;
+  bool last_tick_valid_ = false;
+  // Atomic, because SendData might be called from a different thread
+  std::atomic<uint32_t> tx_failures_{0};
+
+  // Reliable packets waiting for their ACK, protected by state_mutex_
+  ReliableSender reliable_sender_{};
+  // Reliable packets received from the claiming interface, only used by the
+  // processing thread
+  SequenceWindow reliable_window_{};
 
   // True, when the service is running (i.e. configured and tick() is being
   // called)
   bool is_running_ = 0;
 
+  bool coalesce_outputs_ = false;
+
   void heartbeat();
 
   void runProcessing();
 
+  /**
+   * Sets is_running_ and schedules the tasks depending on it
+   * (tick and configuration requests).
+   */
+  void setRunning(bool running);
+
+  // Calls tick() and measures it for telemetry
+  void runTick();
+
+  void SendTelemetry();
+
+  /**
+   * Starts the implicit transaction for a callback, if coalescing is enabled.
+   * @return true, if EndCoalescing() needs to be called after the callback
+   */
+  bool BeginCoalescing();
+  // Sends the coalesced outputs, if there are any.
+  void EndCoalescing();
+
+  void SendTimeSyncRequest();
+
+  // Transmit to the claiming interface and count failures
+  bool transmitToTarget(packet::PacketPtr packet);
+  bool transmitSegmentsToTarget(const packet::PacketSegment *segments, size_t segment_count);
+  /**
+   * Transmits with datatypes::FLAG_RELIABLE and keeps a copy for
+   * retransmission. header_ needs to be the first segment, state_mutex_ needs
+   * to be held by the caller.
+   */
+  bool transmitReliableToTarget(const packet::PacketSegment *segments, size_t segment_count);
+  // Acknowledges a reliable packet from the claiming interface
+  void SendAck(uint16_t sequence_no);
+
   void HandleClaimMessage(datatypes::XbotHeader *header, const void *payload, size_t payload_len);
   void HandleDataMessage(datatypes::XbotHeader *header, const void *payload, size_t payload_len);
   void HandleDataTransaction(datatypes::XbotHeader *header, const void *payload, size_t payload_len);
   void HandleConfigurationTransaction(datatypes::XbotHeader *header, const void *payload, size_t payload_len);
+  void HandleConfigurationUpdate(datatypes::XbotHeader *header, const void *payload, size_t payload_len);
+
+  // Configures and starts the service, the registers need to be set already
+  void StartWithConfiguration();
+  void HandleTimeSyncMessage(datatypes::XbotHeader *header, const void *payload, size_t payload_len);
 
   void fillHeader();
 
+  /**
+   * Sends the scratch_buffer as transaction packet and clears it.
+   * state_mutex_ needs to be held by the caller.
+   * @param last true, if this is the last fragment of the transaction
+   */
+  bool SendTransactionFragment(bool last);
+
   bool SendDataClaimAck();
   bool SendConfigurationRequest();
 
@@ -126,6 +268,11 @@ class Service : public ServiceIo {
 
   virtual bool advertiseService() = 0;
 
+  /**
+   * Answers a SERVICE_QUERY by sending the full service description.
+   */
+  virtual bool sendServiceDescription() = 0;
+
   // Return true, if the service is configured properly
   virtual bool isConfigured() = 0;
   virtual void clearConfiguration() = 0;
@@ -133,6 +280,41 @@ class Service : public ServiceIo {
   virtual bool handleData(uint16_t target_id, const void *payload, size_t length) = 0;
 
   virtual bool setRegister(uint16_t target_id, const void *payload, size_t length) = 0;
+
+  /**
+   * Stores a register value for commitStagedRegisters(), without changing
+   * the register used by the running service.
+   * @return false, if there is no such register or the size is invalid
+   */
+  virtual bool stageRegister(uint16_t target_id, const void *payload, size_t length) = 0;
+
+  /**
+   * Applies all staged registers and calls their OnRegister<Name>Changed()
+   * hooks.
+   * @return false, if a hook could not apply the change at runtime, the
+   * service needs to be restarted then.
+   */
+  virtual bool commitStagedRegisters() = 0;
+
+  virtual void discardStagedRegisters() = 0;
+
+  /**
+   * Sends all outputs at full rate again. Called with the state_mutex_ held.
+   */
+  virtual void clearOutputPolicies() = 0;
+
+  /**
+   * Applies a publish policy requested by the interface. Called with the
+   * state_mutex_ held.
+   * @return false, if there is no such output
+   */
+  virtual bool setOutputPolicy(const datatypes::OutputPolicy &policy) = 0;
+
+  /**
+   * Sends the next value of outputs which are only sent on change, regardless
+   * of whether they changed. Called with the state_mutex_ held.
+   */
+  virtual void invalidateSentOutputs() = 0;
 };
 }  // namespace xbot::service
 
@@ -4,9 +4,11 @@
 
 #ifndef PACKETHANDLER_H
 #define PACKETHANDLER_H
+#include <atomic>
 #include <xbot-service/portable/mutex.hpp>
 #include <xbot-service/portable/queue.hpp>
 #include <xbot-service/portable/socket.hpp>
+#include <xbot/config.hpp>
 
 namespace xbot::service {
 /**
@@ -22,18 +24,22 @@ class ServiceIo {
    */
   const uint16_t service_id_;
 
-  // Keep track of the next service. This is used by Io to loop through all
-  // registered services.
-  ServiceIo *next_service_ = nullptr;
+  // True, if service is stopped. Atomic, because the IO thread checks it
+  // without holding the state_mutex_.
+  std::atomic<bool> stopped{true};
 
-  // True, if service is stopped
-  bool stopped = true;
-
-  // Storage for the queue
-  static constexpr size_t packet_queue_length = 10;
-  uint8_t packet_queue_buffer[packet_queue_length * sizeof(void *)]{};
+  // Storage for the queue. The queue stores (atomic) pointers in here, so keep
+  // it pointer aligned.
+  static constexpr size_t packet_queue_length = config::service::packet_queue_length;
+  alignas(void *) uint8_t packet_queue_buffer[packet_queue_length * sizeof(void *)]{};
   XBOT_QUEUE_TYPEDEF packet_queue_{};
 
+  // Queue statistics for telemetry, updated without holding state_mutex_.
+  // queued_packets_ needs to be decremented by the consumer of the queue.
+  std::atomic<uint16_t> queued_packets_{0};
+  std::atomic<uint16_t> queue_high_water_mark_{0};
+  std::atomic<uint32_t> queue_drops_{0};
+
   // State mutex needs to be held before modifying ANY of the member properties.
   XBOT_MUTEX_TYPEDEF state_mutex_{};
 
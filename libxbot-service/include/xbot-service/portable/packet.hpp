@@ -14,6 +14,17 @@ namespace xbot::service::packet {
 
 typedef XBOT_PACKET_TYPEDEF* PacketPtr;
 
+/**
+ * A piece of packet data which stays in the caller's buffer.
+ *
+ * A packet can be described as a list of segments (e.g. header and payload),
+ * which are transmitted without copying them into a packet first.
+ */
+struct PacketSegment {
+  const void* data;
+  size_t size;
+};
+
 /**
  * @brief Allocate a packet.
  *
@@ -24,6 +35,17 @@ typedef XBOT_PACKET_TYPEDEF* PacketPtr;
  */
 PacketPtr allocatePacket();
 
+/**
+ * @brief Allocate a packet without blocking.
+ *
+ * @return PacketPtr A pointer to the allocated packet, nullptr if no packet is
+ * available right now.
+ *
+ * Use this on threads which must not block, e.g. the IO thread which needs to
+ * keep sending packets for the others to be freed.
+ */
+PacketPtr tryAllocatePacket();
+
 /**
  * @brief Free the memory used by a packet.
  *
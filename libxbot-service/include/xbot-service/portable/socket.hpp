@@ -49,6 +49,19 @@ bool subscribeMulticast(SocketPtr socket, const char* ip);
  */
 bool receivePacket(SocketPtr socket, packet::PacketPtr* packet);
 
+/**
+ * Blocks until at least one packet is received or timeout occured, then
+ * receives up to max_packets packets at once.
+ *
+ * @param socket The socket
+ * @param packets Array of at least max_packets packet pointers. Only the first
+ * (return value) entries are valid.
+ * @param max_packets Max. number of packets to receive
+ *
+ * @return the number of received packets, 0 on timeout
+ */
+size_t receivePackets(SocketPtr socket, packet::PacketPtr* packets, size_t max_packets);
+
 /**
  * Transmits a packet to a channel using the provided socket.
  * The packet will be freed by the driver, don't free the packet yourself.
@@ -64,6 +77,22 @@ bool transmitPacket(SocketPtr socket, packet::PacketPtr packet, const char* ip,
 bool transmitPacket(SocketPtr socket, packet::PacketPtr packet, uint32_t ip,
                     uint16_t port);
 
+/**
+ * Transmits a packet made up of multiple segments, without copying them into a
+ * packet first if the driver supports it.
+ * The segments only need to stay valid until this returns.
+ *
+ * @param socket socket to use for transmission
+ * @param segments the segments to send, in order
+ * @param segment_count number of segments, at most
+ * config::service::max_packet_segments
+ * @param ip the ip to transmit to
+ * @param port the port to transmit to
+ * @return true on success
+ */
+bool transmitSegments(SocketPtr socket, const packet::PacketSegment* segments,
+                      size_t segment_count, uint32_t ip, uint16_t port);
+
 /**
  * Closes the socket.
  * @return true, if close was success
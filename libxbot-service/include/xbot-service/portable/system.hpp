@@ -7,6 +7,11 @@
 
 namespace xbot::service::system {
 void initSystem(uint32_t node_id = 0);
+// Monotonic, wraps after ~71 minutes. Use for intervals and deadlines.
 uint32_t getTimeMicros();
+// Monotonic, does not wrap. Use for timestamps.
+uint64_t getTimeNanos();
+// CPU time used by the calling thread
+uint64_t getThreadCpuTimeMicros();
 }  // namespace xbot::service::system
 #endif  // SYSTEM_HPP
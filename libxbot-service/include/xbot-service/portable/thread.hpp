@@ -5,6 +5,8 @@
 #ifndef THREAD_HPP
 #define THREAD_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <xbot/thread_impl.hpp>
 
 #ifndef XBOT_THREAD_TYPEDEF
@@ -14,9 +16,52 @@
 namespace xbot::service::thread {
 typedef XBOT_THREAD_TYPEDEF* ThreadPtr;
 
+enum class SchedulingPolicy : uint8_t {
+  // Normal time sharing, priority is ignored
+  DEFAULT = 0,
+  // Real-time, runs until it blocks or a higher priority thread gets ready
+  FIFO,
+  // Real-time, like FIFO but shares the CPU with threads of equal priority
+  ROUND_ROBIN,
+};
+
+struct ThreadAttributes {
+  const char* name = nullptr;
+  SchedulingPolicy policy = SchedulingPolicy::DEFAULT;
+  // Real-time priority, higher runs first. Only used for FIFO and
+  // ROUND_ROBIN, the valid range depends on the platform (1-99 on Linux).
+  int priority = 0;
+  // Nice value for DEFAULT scheduling, higher values run less often. Only
+  // lowering the priority (positive values) works without permissions.
+  int nice = 0;
+  // Bit n allows the thread to run on CPU n, 0 allows all CPUs.
+  uint64_t cpu_mask = 0;
+  // Stack for the thread, nullptr lets the platform allocate it.
+  void* stack = nullptr;
+  // Size of the stack buffer, or of the stack to allocate. 0 uses the
+  // platform default.
+  size_t stack_size = 0;
+  // Lock all current and future memory of the process in RAM before starting
+  // the thread, so that it never waits for a page fault. This also prefaults
+  // the new thread's stack.
+  bool lock_memory = false;
+};
+
+/**
+ * Starts a thread.
+ * Platforms which don't support an attribute ignore it. If the real-time
+ * attributes can't be applied (e.g. missing permissions), the thread is
+ * started without them.
+ * @return false, if the thread could not be started
+ */
+bool initialize(ThreadPtr thread, void (*threadfunc)(void*), void* arg,
+                const ThreadAttributes& attributes);
 bool initialize(ThreadPtr thread, void (*threadfunc)(void*), void* arg,
                 void* stackbuf, size_t buflen, const char* name);
 void deinitialize(ThreadPtr thread);
+
+// Suspends the calling thread for at least the given time.
+void sleepMicros(uint32_t micros);
 }  // namespace xbot::service::thread
 
 #endif  // THREAD_HPP
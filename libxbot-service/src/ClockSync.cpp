@@ -0,0 +1,71 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot-service/ClockSync.hpp>
+
+using namespace xbot::service;
+
+void ClockSync::addSample(uint64_t request_sent, uint64_t request_received, uint64_t response_sent,
+                          uint64_t response_received) {
+  if (response_received < request_sent || response_sent < request_received) {
+    // Broken exchange
+    return;
+  }
+  const uint64_t local_duration = response_received - request_sent;
+  const uint64_t reference_duration = response_sent - request_received;
+  Sample &sample = samples_[next_sample_];
+  sample.local_nanos = request_sent + local_duration / 2;
+  sample.offset_nanos = (static_cast<int64_t>(request_received - request_sent) +
+                         static_cast<int64_t>(response_sent - response_received)) /
+                        2;
+  sample.round_trip_nanos = local_duration > reference_duration ? local_duration - reference_duration : 0;
+  next_sample_ = (next_sample_ + 1) % config::time_sync_window;
+  if (sample_count_ < config::time_sync_window) {
+    sample_count_++;
+  }
+  total_samples_++;
+
+  // Select the sample with the shortest round trip
+  const Sample *best = &samples_[0];
+  for (size_t i = 1; i < sample_count_; i++) {
+    if (samples_[i].round_trip_nanos < best->round_trip_nanos) {
+      best = &samples_[i];
+    }
+  }
+  if (has_estimate_ && best->local_nanos == local_nanos_) {
+    // Still the same sample, nothing new to learn
+    return;
+  }
+
+  if (!has_estimate_) {
+    drift_local_nanos_ = best->local_nanos;
+    drift_offset_nanos_ = best->offset_nanos;
+  } else if (best->local_nanos > drift_local_nanos_ &&
+             best->local_nanos - drift_local_nanos_ >= config::time_sync_drift_baseline_nanos) {
+    const double measured_drift = static_cast<double>(best->offset_nanos - drift_offset_nanos_) /
+                                  static_cast<double>(best->local_nanos - drift_local_nanos_);
+    // Low pass, a single sample with an unlucky round trip should not throw
+    // off the drift.
+    drift_ = has_drift_ ? drift_ + (measured_drift - drift_) * 0.25 : measured_drift;
+    has_drift_ = true;
+    drift_local_nanos_ = best->local_nanos;
+    drift_offset_nanos_ = best->offset_nanos;
+  }
+  has_estimate_ = true;
+  local_nanos_ = best->local_nanos;
+  offset_nanos_ = best->offset_nanos;
+  round_trip_nanos_ = best->round_trip_nanos;
+}
+
+void ClockSync::reset() { *this = ClockSync{}; }
+
+bool ClockSync::isSynchronized() const { return has_estimate_ && total_samples_ >= config::time_sync_min_samples; }
+
+uint64_t ClockSync::toReference(uint64_t local_nanos) const {
+  if (!isSynchronized()) {
+    return local_nanos;
+  }
+  const double elapsed = static_cast<double>(static_cast<int64_t>(local_nanos - local_nanos_));
+  return local_nanos + offset_nanos_ + static_cast<int64_t>(elapsed * drift_);
+}
@@ -0,0 +1,85 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot-service/OutputFilter.hpp>
+
+using namespace xbot::service;
+using xbot::datatypes::OutputPolicyMode;
+
+void OutputFilter::setPolicy(OutputPolicyMode mode, uint32_t param) {
+  reset();
+  switch (mode) {
+    case OutputPolicyMode::EVERY_NTH:
+    case OutputPolicyMode::MAX_RATE:
+    case OutputPolicyMode::WINDOW_MIN:
+    case OutputPolicyMode::WINDOW_MAX:
+    case OutputPolicyMode::WINDOW_MEAN:
+      // Every sample or an interval of 0 is full rate anyway
+      if (param > (mode == OutputPolicyMode::EVERY_NTH ? 1u : 0u)) {
+        mode_ = mode;
+        param_ = param;
+      }
+      break;
+    default:
+      // FULL_RATE and unknown modes
+      break;
+  }
+}
+
+bool OutputFilter::accept(uint32_t now_micros) {
+  switch (mode_) {
+    case OutputPolicyMode::FULL_RATE:
+      return true;
+    case OutputPolicyMode::EVERY_NTH:
+      if (skipped_ == 0) {
+        skipped_ = param_ - 1;
+        return true;
+      }
+      skipped_--;
+      return false;
+    default:
+      // Rate limit, window modes limit to one sample per window
+      if (has_sent_ && now_micros - last_sent_micros_ < param_) {
+        return false;
+      }
+      has_sent_ = true;
+      last_sent_micros_ = now_micros;
+      return true;
+  }
+}
+
+bool OutputFilter::addSample(double value, uint32_t now_micros,
+                             double *aggregate) {
+  if (window_count_ == 0) {
+    window_start_micros_ = now_micros;
+    window_min_ = value;
+    window_max_ = value;
+    window_sum_ = 0;
+  }
+  window_count_++;
+  window_sum_ += value;
+  if (value < window_min_) {
+    window_min_ = value;
+  }
+  if (value > window_max_) {
+    window_max_ = value;
+  }
+  if (now_micros - window_start_micros_ < param_) {
+    return false;
+  }
+
+  switch (mode_) {
+    case OutputPolicyMode::WINDOW_MIN:
+      *aggregate = window_min_;
+      break;
+    case OutputPolicyMode::WINDOW_MAX:
+      *aggregate = window_max_;
+      break;
+    default:
+      *aggregate = window_sum_ / window_count_;
+      break;
+  }
+  window_count_ = 0;
+  return true;
+}
@@ -0,0 +1,79 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot-service/ReliableSender.hpp>
+
+using namespace xbot::service;
+
+ReliableSender::~ReliableSender() { reset(); }
+
+bool ReliableSender::track(uint16_t sequence_no, packet::PacketPtr packet, uint32_t now_micros) {
+  if (in_flight_ >= config::service::reliable_max_in_flight) {
+    packet::freePacket(packet);
+    failures_++;
+    return false;
+  }
+  Entry &entry = entries_[in_flight_++];
+  entry.packet = packet;
+  entry.sequence_no = sequence_no;
+  entry.sent_micros = now_micros;
+  entry.due_micros = now_micros + rtt_.getTimeoutMicros();
+  entry.retransmits = 0;
+  return true;
+}
+
+bool ReliableSender::acknowledge(uint16_t sequence_no, uint32_t now_micros) {
+  for (size_t i = 0; i < in_flight_; i++) {
+    Entry &entry = entries_[i];
+    if (entry.sequence_no != sequence_no) {
+      continue;
+    }
+    if (entry.retransmits == 0) {
+      // Only unambiguous round trips (Karn's algorithm)
+      rtt_.addSample(now_micros - entry.sent_micros);
+    }
+    packet::freePacket(entry.packet);
+    // Order doesn't matter, move the last one into the gap
+    entry = entries_[--in_flight_];
+    entries_[in_flight_].packet = nullptr;
+    return true;
+  }
+  return false;
+}
+
+uint32_t ReliableSender::poll(uint32_t now_micros, RetransmitCallback callback, void *arg) {
+  uint32_t next_due = NOTHING_IN_FLIGHT;
+  for (size_t i = 0; i < in_flight_;) {
+    Entry &entry = entries_[i];
+    int32_t remaining = static_cast<int32_t>(entry.due_micros - now_micros);
+    if (remaining <= 0) {
+      if (entry.retransmits >= config::reliable_max_retransmits) {
+        // Give up
+        failures_++;
+        packet::freePacket(entry.packet);
+        entry = entries_[--in_flight_];
+        entries_[in_flight_].packet = nullptr;
+        continue;
+      }
+      entry.retransmits++;
+      retransmits_++;
+      callback(entry.packet, arg);
+      remaining = static_cast<int32_t>(rtt_.getTimeoutMicros(entry.retransmits));
+      entry.due_micros = now_micros + remaining;
+    }
+    if (static_cast<uint32_t>(remaining) < next_due) {
+      next_due = remaining;
+    }
+    i++;
+  }
+  return next_due;
+}
+
+void ReliableSender::reset() {
+  for (size_t i = 0; i < in_flight_; i++) {
+    packet::freePacket(entries_[i].packet);
+    entries_[i].packet = nullptr;
+  }
+  in_flight_ = 0;
+}
@@ -4,11 +4,14 @@
 
 #include <ulog.h>
 
+#include <atomic>
 #include <cstdio>
 #include <cstring>
 #include <xbot-service/Lock.hpp>
 #include <xbot-service/RemoteLogging.hpp>
 #include <xbot-service/portable/socket.hpp>
+#include <xbot-service/portable/system.hpp>
+#include <xbot-service/portable/thread.hpp>
 #include <xbot/config.hpp>
 
 #include "xbot/datatypes/LogPayload.hpp"
@@ -17,62 +20,239 @@
 using namespace xbot::service;
 using namespace xbot::datatypes;
 
-XBOT_MUTEX_TYPEDEF logging_mutex{};
-XBOT_SOCKET_TYPEDEF logging_socket{};
-uint8_t log_packet_buffer[xbot::config::max_packet_size];
+namespace {
+struct LogRecord {
+  const char* format;
+  uint64_t timestamp;
+  uint16_t service_id;
+  LogLevel level;
+  uint8_t arg_count;
+  uint16_t args_size;
+  uint8_t args[xbot::config::remote_log_max_args_size];
+};
+
+// Bounded MPSC ring, each slot's sequence tells whether it is free for the
+// producer of a given position or filled for the consumer.
+struct LogSlot {
+  std::atomic<uint32_t> sequence;
+  LogRecord record;
+};
+
+constexpr uint32_t BUFFER_SIZE = xbot::config::remote_log_buffer_size;
+// Max. number of different format strings per message
+constexpr uint8_t MAX_FORMATS = 32;
 
-XbotHeader log_message_header{};
+LogSlot log_buffer_[BUFFER_SIZE]{};
+std::atomic<uint32_t> enqueue_pos_{0};
+// Only used by the sender thread
+uint32_t dequeue_pos_ = 0;
+std::atomic<bool> started_{false};
+std::atomic<uint32_t> dropped_records_{0};
+uint32_t reported_dropped_records_ = 0;
+
+XBOT_SOCKET_TYPEDEF logging_socket{};
+XBOT_THREAD_TYPEDEF logging_thread{};
 
 uint16_t log_sequence_no = 0;
 
-void remote_logger(ulog_level_t severity, char* msg, const void* args) {
-  (void)args;
-  (void)severity;
-  (void)msg;
-  // TODO: Implement
-  /*Lock lk(&logging_mutex);
-
-  // Packet Header
-  log_message_header.protocol_version = 0;
-  log_message_header.message_type = MessageType::LOG;
-  log_message_header.flags = 0;
-
-  log_message_header.arg1 = (severity - ULOG_TRACE_LEVEL + 1);
-  log_message_header.arg2 = 0;
-  log_message_header.sequence_no = log_sequence_no++;
-  log_message_header.timestamp = 0;
-
-  int written = snprintf(msg, xbot::config::max_log_length, "[%s]: %s",
-                         ulog_level_name(severity), msg);
-
-  if (written > 0 && written < xbot::config::max_log_length) {
-    // Need to add that terminating 0, for cppserdes to copy it.
-    log_message_header.payload_size = written + 1;
-    // serdes::status_t result = log_message.store(log_packet_buffer);
-    // if(result.status == serdes::status_e::NO_ERROR) {
-    // (result.bits+7)/8 is effectively ceil(result.bits/8) without the float
-    // log_message_header.payload_size = (result.bits+7)/8;
-    // Serialize success, send it.
-    // PacketPtr log_packet = allocatePacket();
-    // packetAppendData(log_packet, &log_message_header,
-    // sizeof(log_message_header)); packetAppendData(log_packet,
-    // &log_packet_buffer, log_message_header.payload_size);
-    // socketTransmitPacket(logging_socket, log_packet,
-    // config::remote_log_multicast_address, config::multicast_port);
-    // }
-  }*/
+bool dequeueRecord(LogRecord* record) {
+  LogSlot& slot = log_buffer_[dequeue_pos_ & (BUFFER_SIZE - 1)];
+  if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+    // Empty (or not yet committed)
+    return false;
+  }
+  memcpy(record, &slot.record, sizeof(LogRecord));
+  slot.sequence.store(dequeue_pos_ + BUFFER_SIZE, std::memory_order_release);
+  dequeue_pos_++;
+  return true;
 }
 
-bool startRemoteLogging() {
-  if (!mutex::initialize(&logging_mutex)) {
+/**
+ * Collects records into a LOG message. Format strings are sent once per
+ * message and referenced by their index.
+ */
+class LogMessageBuilder {
+ public:
+  LogMessageBuilder() { reset(); }
+
+  bool empty() const { return fill_ == sizeof(XbotHeader); }
+
+  // Returns false, if the record did not fit
+  bool appendRecord(const LogRecord& record) {
+    int format_id = -1;
+    for (uint8_t i = 0; i < format_count_; i++) {
+      if (formats_[i] == record.format) {
+        format_id = i;
+        break;
+      }
+    }
+    const size_t format_length = strnlen(record.format, xbot::config::max_log_length);
+    size_t required = sizeof(LogEntryHeader) + sizeof(LogRecordHeader) + record.args_size;
+    if (format_id < 0) {
+      if (format_count_ >= MAX_FORMATS) return false;
+      required += sizeof(LogEntryHeader) + format_length;
+    }
+    if (fill_ + required > sizeof(buffer_)) return false;
+
+    if (format_id < 0) {
+      format_id = format_count_;
+      formats_[format_count_++] = record.format;
+      appendEntryHeader(LogEntryType::FORMAT, format_id, format_length);
+      append(record.format, format_length);
+    }
+    appendEntryHeader(LogEntryType::RECORD, format_id, sizeof(LogRecordHeader) + record.args_size);
+    LogRecordHeader record_header{};
+    record_header.level = record.level;
+    record_header.arg_count = record.arg_count;
+    record_header.service_id = record.service_id;
+    record_header.timestamp = record.timestamp;
+    append(&record_header, sizeof(record_header));
+    append(record.args, record.args_size);
+    if (record.level > max_level_) {
+      max_level_ = record.level;
+    }
+    return true;
+  }
+
+  bool appendDropped(uint32_t count) {
+    if (fill_ + sizeof(LogEntryHeader) + sizeof(count) > sizeof(buffer_)) return false;
+    appendEntryHeader(LogEntryType::DROPPED, 0, sizeof(count));
+    append(&count, sizeof(count));
+    return true;
+  }
+
+  void send() {
+    XbotHeader header{};
+    header.protocol_version = 1;
+    header.message_type = MessageType::LOG;
+    header.arg1 = static_cast<uint8_t>(max_level_);
+    header.arg2 = static_cast<uint16_t>(LogEncoding::RECORDS);
+    header.sequence_no = log_sequence_no++;
+    header.timestamp = system::getTimeNanos();
+    header.payload_size = fill_ - sizeof(XbotHeader);
+    memcpy(buffer_, &header, sizeof(header));
+
+    packet::PacketPtr packet = packet::allocatePacket();
+    packet::packetAppendData(packet, buffer_, fill_);
+    sock::transmitPacket(&logging_socket, packet, xbot::config::remote_log_multicast_address,
+                         xbot::config::multicast_port);
+    reset();
+  }
+
+ private:
+  uint8_t buffer_[xbot::config::max_packet_size]{};
+  size_t fill_ = 0;
+  const char* formats_[MAX_FORMATS]{};
+  uint8_t format_count_ = 0;
+  LogLevel max_level_ = LogLevel::UNKNOWN_LEVEL;
+
+  void reset() {
+    fill_ = sizeof(XbotHeader);
+    format_count_ = 0;
+    max_level_ = LogLevel::UNKNOWN_LEVEL;
+  }
+
+  void append(const void* data, size_t size) {
+    memcpy(buffer_ + fill_, data, size);
+    fill_ += size;
+  }
+
+  void appendEntryHeader(LogEntryType type, uint8_t format_id, size_t length) {
+    LogEntryHeader entry{};
+    entry.type = type;
+    entry.format_id = format_id;
+    entry.length = static_cast<uint16_t>(length);
+    append(&entry, sizeof(entry));
+  }
+};
+
+LogMessageBuilder message_builder_{};
+
+void runLogSender(void* arg) {
+  (void)arg;
+  LogRecord record{};
+  while (true) {
+    thread::sleepMicros(xbot::config::remote_log_flush_interval_micros);
+
+    const uint32_t dropped = dropped_records_.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped_records_ && message_builder_.appendDropped(dropped - reported_dropped_records_)) {
+      reported_dropped_records_ = dropped;
+    }
+    while (dequeueRecord(&record)) {
+      if (!message_builder_.appendRecord(record)) {
+        // Message is full, send it and start the next one
+        message_builder_.send();
+        message_builder_.appendRecord(record);
+      }
+    }
+    if (!message_builder_.empty()) {
+      message_builder_.send();
+    }
+  }
+}
+}  // namespace
+
+bool logging::enqueueRecord(LogLevel level, uint16_t service_id, const char* format, const uint8_t* args,
+                            uint16_t args_size, uint8_t arg_count) {
+  if (!started_.load(std::memory_order_acquire) || args_size > xbot::config::remote_log_max_args_size) {
     return false;
   }
+  uint32_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+  LogSlot* slot;
+  while (true) {
+    slot = &log_buffer_[pos & (BUFFER_SIZE - 1)];
+    const auto diff = static_cast<int32_t>(slot->sequence.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // The sender did not catch up yet
+      dropped_records_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+  slot->record.format = format;
+  slot->record.timestamp = system::getTimeNanos();
+  slot->record.service_id = service_id;
+  slot->record.level = level;
+  slot->record.arg_count = arg_count;
+  slot->record.args_size = args_size;
+  memcpy(slot->record.args, args, args_size);
+  slot->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+uint32_t logging::getDroppedRecords() { return dropped_records_.load(std::memory_order_relaxed); }
+
+// ulog messages are already formatted, send them as string argument.
+void remote_logger(ulog_level_t severity, char* msg, const void* args) {
+  const uint16_t service_id = args != nullptr ? *static_cast<const uint16_t*>(args) : 0;
+  logging::log(static_cast<LogLevel>(severity - ULOG_TRACE_LEVEL + 1), service_id, "%s", msg);
+}
 
-  Lock lk(&logging_mutex);
+bool startRemoteLogging() {
+  if (started_) {
+    return true;
+  }
+  for (uint32_t i = 0; i < BUFFER_SIZE; i++) {
+    log_buffer_[i].sequence.store(i, std::memory_order_relaxed);
+  }
   if (!sock::initialize(&logging_socket, false)) {
     ULOG_ERROR("Error setting up remote logging: Error creating socket");
     return false;
   }
+  started_.store(true, std::memory_order_release);
+
+  thread::ThreadAttributes attributes{};
+  attributes.name = "xbot-log";
+  attributes.nice = xbot::config::remote_log_thread_nice;
+  if (!thread::initialize(&logging_thread, runLogSender, nullptr, attributes)) {
+    started_ = false;
+    return false;
+  }
 
   ULOG_SUBSCRIBE(remote_logger, ULOG_INFO_LEVEL);
   return true;
@@ -0,0 +1,144 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot-service/Scheduler.hpp>
+
+using namespace xbot::service;
+
+namespace {
+// Compares wrapping timestamps
+bool isBefore(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b) < 0; }
+}  // namespace
+
+int Scheduler::addTask(TaskCallback callback, void *arg) {
+  if (callback == nullptr || task_count_ >= config::service::max_scheduled_tasks) {
+    return INVALID_TASK;
+  }
+  Task &task = tasks_[task_count_];
+  task.callback = callback;
+  task.arg = arg;
+  task.interval_micros = 0;
+  task.due_micros = 0;
+  task.overruns = 0;
+  return static_cast<int>(task_count_++);
+}
+
+bool Scheduler::setInterval(int task_id, uint32_t interval_micros, uint32_t next_due_micros) {
+  if (!isValid(task_id)) {
+    return false;
+  }
+  Task &task = tasks_[task_id];
+  if (task.interval_micros > 0) {
+    heapRemove(task_id);
+  }
+  task.interval_micros = interval_micros;
+  task.due_micros = next_due_micros;
+  if (interval_micros > 0) {
+    heapInsert(task_id);
+  }
+  return true;
+}
+
+uint32_t Scheduler::run(uint32_t now_micros) {
+  while (heap_size_ > 0) {
+    const int task_id = heap_[0];
+    Task &task = tasks_[task_id];
+    if (isBefore(now_micros, task.due_micros)) {
+      break;
+    }
+    // Keep the phase, unless we are a whole interval late.
+    task.due_micros += task.interval_micros;
+    if (!isBefore(now_micros, task.due_micros)) {
+      task.overruns++;
+      task.due_micros = now_micros + task.interval_micros;
+    }
+    siftDown(0);
+    task.callback(task.arg);
+  }
+  return getMicrosUntilNextTask(now_micros);
+}
+
+uint32_t Scheduler::getMicrosUntilNextTask(uint32_t now_micros) const {
+  if (heap_size_ == 0) {
+    return NO_TASK_DUE;
+  }
+  const uint32_t due_micros = tasks_[heap_[0]].due_micros;
+  if (!isBefore(now_micros, due_micros)) {
+    return 0;
+  }
+  return due_micros - now_micros;
+}
+
+uint32_t Scheduler::getOverruns(int task_id) const {
+  if (!isValid(task_id)) {
+    return 0;
+  }
+  return tasks_[task_id].overruns;
+}
+
+bool Scheduler::isValid(int task_id) const {
+  return task_id >= 0 && static_cast<size_t>(task_id) < task_count_;
+}
+
+void Scheduler::heapInsert(int task_id) {
+  heap_[heap_size_] = task_id;
+  tasks_[task_id].heap_index = heap_size_;
+  heap_size_++;
+  siftUp(heap_size_ - 1);
+}
+
+void Scheduler::heapRemove(int task_id) {
+  const size_t index = tasks_[task_id].heap_index;
+  heap_size_--;
+  if (index == heap_size_) {
+    return;
+  }
+  heapSwap(index, heap_size_);
+  // The moved task can be due earlier or later than the removed one
+  const int moved_task_id = heap_[index];
+  siftUp(index);
+  siftDown(tasks_[moved_task_id].heap_index);
+}
+
+void Scheduler::siftUp(size_t index) {
+  while (index > 0) {
+    const size_t parent = (index - 1) / 2;
+    if (!dueBefore(index, parent)) {
+      break;
+    }
+    heapSwap(index, parent);
+    index = parent;
+  }
+}
+
+void Scheduler::siftDown(size_t index) {
+  while (true) {
+    const size_t left = 2 * index + 1;
+    const size_t right = left + 1;
+    size_t first = index;
+    if (left < heap_size_ && dueBefore(left, first)) {
+      first = left;
+    }
+    if (right < heap_size_ && dueBefore(right, first)) {
+      first = right;
+    }
+    if (first == index) {
+      break;
+    }
+    heapSwap(index, first);
+    index = first;
+  }
+}
+
+void Scheduler::heapSwap(size_t a, size_t b) {
+  const int task_a = heap_[a];
+  heap_[a] = heap_[b];
+  heap_[b] = task_a;
+  tasks_[heap_[a]].heap_index = a;
+  tasks_[heap_[b]].heap_index = b;
+}
+
+bool Scheduler::dueBefore(size_t a, size_t b) const {
+  return isBefore(tasks_[heap_[a]].due_micros, tasks_[heap_[b]].due_micros);
+}
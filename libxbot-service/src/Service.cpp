@@ -3,23 +3,28 @@
 //
 #include <ulog.h>
 
+#include <cstddef>
 #include <cstring>
 #include <xbot-service/Io.hpp>
 #include <xbot-service/Lock.hpp>
 #include <xbot-service/Service.hpp>
 #include <xbot-service/portable/system.hpp>
 #include <xbot/datatypes/ClaimPayload.hpp>
+#include <xbot/datatypes/TimeSyncPayload.hpp>
 
 xbot::service::Service::Service(uint16_t service_id, uint32_t tick_rate_micros,
                                 void *processing_thread_stack,
                                 size_t processing_thread_stack_size)
     : ServiceIo(service_id),
       scratch_buffer{},
-      processing_thread_stack_(processing_thread_stack),
-      processing_thread_stack_size_(processing_thread_stack_size),
-      tick_rate_micros_(tick_rate_micros) {}
+      tick_rate_micros_(tick_rate_micros) {
+  thread_attributes_.stack = processing_thread_stack;
+  thread_attributes_.stack_size = processing_thread_stack_size;
+}
 
 xbot::service::Service::~Service() {
+  // Make sure the IO thread doesn't deliver to us anymore
+  Io::unregisterServiceIo(this);
   mutex::deinitialize(&state_mutex_);
   thread::deinitialize(&process_thread_);
 }
@@ -39,19 +44,37 @@ bool xbot::service::Service::start() {
     return false;
   }
 
-  Io::registerServiceIo(this);
+  if (!Io::registerServiceIo(this)) {
+    return false;
+  }
 
+  if (thread_attributes_.name == nullptr) {
+    thread_attributes_.name = GetName();
+  }
   if (!thread::initialize(&process_thread_, Service::startProcessingHelper,
-                          this, processing_thread_stack_,
-                          processing_thread_stack_size_, GetName())) {
+                          this, thread_attributes_)) {
     return false;
   }
 
   return true;
 }
 
+void xbot::service::Service::setThreadAttributes(
+    const thread::ThreadAttributes &attributes) {
+  void *const stack = thread_attributes_.stack;
+  const size_t stack_size = thread_attributes_.stack_size;
+  thread_attributes_ = attributes;
+  if (thread_attributes_.stack == nullptr && thread_attributes_.stack_size == 0) {
+    thread_attributes_.stack = stack;
+    thread_attributes_.stack_size = stack_size;
+  }
+}
+
 bool xbot::service::Service::SendData(uint16_t target_id, const void *data,
-                                      size_t size) {
+                                      size_t size, bool reliable) {
+  // Lock before checking for a transaction, other threads must not append
+  // to the transaction of the processing thread.
+  Lock lk(&state_mutex_);
   if (transaction_started_) {
     // We are using a transaction, append the data
     if (scratch_buffer_fill_ + size + sizeof(datatypes::DataDescriptor) <=
@@ -67,29 +90,35 @@ bool xbot::service::Service::SendData(uint16_t target_id, const void *data,
       descriptor_ptr->target_id = target_id;
       memcpy(data_target_ptr, data, size);
       scratch_buffer_fill_ += size + sizeof(datatypes::DataDescriptor);
+      transaction_reliable_ |= reliable;
       return true;
-    } else {
-      // TODO: send the current packet and create a new one.
+    }
+    if (scratch_buffer_fill_ == 0 ||
+        size + sizeof(datatypes::DataDescriptor) > sizeof(scratch_buffer)) {
+      ULOG_ARG_ERROR(&service_id_, "Data too large for a transaction");
       return false;
     }
+    // Data does not fit anymore, send what we have and continue the
+    // transaction in a new packet.
+    SendTransactionFragment(false);
+    return SendData(target_id, data, size, reliable);
   }
   if (target_ip == 0 || target_port == 0) {
     ULOG_ARG_INFO(&service_id_, "Service has no target, dropping packet");
     return false;
   }
-  // Send header and data
-  packet::PacketPtr ptr = packet::allocatePacket();
-  {
-    Lock lk(&state_mutex_);
-    fillHeader();
-    header_.message_type = datatypes::MessageType::DATA;
-    header_.payload_size = size;
-    header_.arg2 = target_id;
-
-    packet::packetAppendData(ptr, &header_, sizeof(header_));
+  // Send header and data straight from their buffers
+  fillHeader();
+  header_.message_type = datatypes::MessageType::DATA;
+  header_.payload_size = size;
+  header_.arg2 = target_id;
+
+  const packet::PacketSegment segments[] = {{&header_, sizeof(header_)},
+                                            {data, size}};
+  if (reliable) {
+    return transmitReliableToTarget(segments, 2);
   }
-  packet::packetAppendData(ptr, data, size);
-  return Io::transmitPacket(ptr, target_ip, target_port);
+  return transmitSegmentsToTarget(segments, 2);
 }
 
 bool xbot::service::Service::SendDataClaimAck() {
@@ -109,45 +138,116 @@ bool xbot::service::Service::SendDataClaimAck() {
     packet::packetAppendData(ptr, &header_, sizeof(header_));
   }
 
-  return Io::transmitPacket(ptr, target_ip, target_port);
+  return transmitToTarget(ptr);
 }
 bool xbot::service::Service::StartTransaction(uint64_t timestamp) {
+  // Lock like this, because we need to keep it locked until Commit()
+  mutex::lockMutex(&state_mutex_);
+  if (implicit_transaction_) {
+    // Join the coalesced transaction, it is sent after the callback.
+    if (timestamp && scratch_buffer_fill_ == 0 && transaction_fragment_ == 0) {
+      transaction_timestamp_ = timestamp;
+    }
+    mutex::unlockMutex(&state_mutex_);
+    return true;
+  }
   if (transaction_started_) {
+    mutex::unlockMutex(&state_mutex_);
     return false;
   }
-  // Lock like this, because we need to keep it locked until Commit()
-  mutex::lockMutex(&state_mutex_);
   fillHeader();
   // If the user has provided a timestamp for the data, set it here.
   if (timestamp) {
     header_.timestamp = timestamp;
   }
+  transaction_timestamp_ = header_.timestamp;
+  transaction_fragment_ = 0;
   scratch_buffer_fill_ = 0;
   transaction_started_ = true;
   return true;
 }
 bool xbot::service::Service::CommitTransaction() {
   mutex::lockMutex(&state_mutex_);
+  if (implicit_transaction_) {
+    // EndCoalescing() sends it after the callback
+    mutex::unlockMutex(&state_mutex_);
+    return true;
+  }
   if (transaction_started_) {
     // unlock the StartTransaction() lock
     mutex::unlockMutex(&state_mutex_);
   }
   transaction_started_ = false;
+  const bool result = SendTransactionFragment(true);
+  // done with the scratch buffer, release it
+  mutex::unlockMutex(&state_mutex_);
+  return result;
+}
+
+bool xbot::service::Service::BeginCoalescing() {
+  if (!coalesce_outputs_) {
+    return false;
+  }
+  // Keep it locked until EndCoalescing()
+  mutex::lockMutex(&state_mutex_);
+  if (transaction_started_) {
+    mutex::unlockMutex(&state_mutex_);
+    return false;
+  }
+  // The header is filled when the first fragment is sent, so that callbacks
+  // without outputs don't use up a sequence number.
+  transaction_timestamp_ = clock_sync_.toReference(system::getTimeNanos());
+  transaction_fragment_ = 0;
+  scratch_buffer_fill_ = 0;
+  transaction_started_ = true;
+  implicit_transaction_ = true;
+  return true;
+}
+
+void xbot::service::Service::EndCoalescing() {
+  // Don't send empty transactions, unless we need to finish a fragmented one
+  if (scratch_buffer_fill_ > 0 || transaction_fragment_ > 0) {
+    SendTransactionFragment(true);
+  }
+  implicit_transaction_ = false;
+  transaction_started_ = false;
+  // unlock the BeginCoalescing() lock
+  mutex::unlockMutex(&state_mutex_);
+}
+
+bool xbot::service::Service::SendTransactionFragment(bool last) {
+  if (transaction_fragment_ > 0 || implicit_transaction_) {
+    // Every fragment gets its own sequence number, but they share the
+    // timestamp of the transaction.
+    fillHeader();
+    header_.timestamp = transaction_timestamp_;
+  }
+  const size_t payload_size = scratch_buffer_fill_;
+  scratch_buffer_fill_ = 0;
+  // Every fragment of a reliable transaction is acknowledged on its own
+  const bool reliable = transaction_reliable_;
+  if (last) {
+    transaction_reliable_ = false;
+  }
   if (target_ip == 0 || target_port == 0) {
     ULOG_ARG_INFO(&service_id_, "Service has no target, dropping packet");
-    mutex::unlockMutex(&state_mutex_);
     return false;
   }
   header_.message_type = datatypes::MessageType::TRANSACTION;
-  header_.payload_size = scratch_buffer_fill_;
+  header_.arg1 = 0;
+  header_.arg2 = transaction_fragment_++;
+  header_.payload_size = payload_size;
+  if (!last) {
+    header_.flags |= datatypes::FLAG_MORE_FRAGMENTS;
+  }
 
-  // Send header and data
-  packet::PacketPtr ptr = packet::allocatePacket();
-  packet::packetAppendData(ptr, &header_, sizeof(header_));
-  packet::packetAppendData(ptr, scratch_buffer, scratch_buffer_fill_);
-  // done with the scratch buffer, release it
-  mutex::unlockMutex(&state_mutex_);
-  return Io::transmitPacket(ptr, target_ip, target_port);
+  // Send header and data straight from their buffers
+  const packet::PacketSegment segments[] = {{&header_, sizeof(header_)},
+                                            {scratch_buffer, payload_size}};
+  const bool result = reliable ? transmitReliableToTarget(segments, 2)
+                               : transmitSegmentsToTarget(segments, 2);
+  header_.flags &= ~datatypes::FLAG_MORE_FRAGMENTS;
+  return result;
 }
 
 void xbot::service::Service::fillHeader() {
@@ -162,12 +262,21 @@ void xbot::service::Service::fillHeader() {
     // Clear reboot flag on rollover
     header_.flags &= 0xFE;
   }
-  header_.timestamp = system::getTimeMicros();
+  header_.timestamp = clock_sync_.toReference(system::getTimeNanos());
+  if (clock_sync_.isSynchronized()) {
+    header_.flags |= datatypes::FLAG_TIME_SYNCED;
+  } else {
+    header_.flags &= ~datatypes::FLAG_TIME_SYNCED;
+  }
+}
+
+uint64_t xbot::service::Service::GetTimestamp() {
+  Lock lk(&state_mutex_);
+  return clock_sync_.toReference(system::getTimeNanos());
 }
 
 void xbot::service::Service::heartbeat() {
   if (target_ip == 0 || target_port == 0) {
-    last_heartbeat_micros_ = system::getTimeMicros();
     return;
   }
   // Send header and data
@@ -182,16 +291,218 @@ void xbot::service::Service::heartbeat() {
 
     packet::packetAppendData(ptr, &header_, sizeof(header_));
   }
-  Io::transmitPacket(ptr, target_ip, target_port);
-  last_heartbeat_micros_ = system::getTimeMicros();
+  transmitToTarget(ptr);
 }
 
-void xbot::service::Service::runProcessing() {
-  // Check, if we should stop
-  {
-    Lock lk(&state_mutex_);
-    last_tick_micros_ = system::getTimeMicros();
+int xbot::service::Service::AddPeriodicTask(Scheduler::TaskCallback callback,
+                                            void *arg,
+                                            uint32_t interval_micros) {
+  const int task_id = scheduler_.addTask(callback, arg);
+  if (task_id != Scheduler::INVALID_TASK && interval_micros > 0) {
+    SetPeriodicTaskInterval(task_id, interval_micros);
+  }
+  return task_id;
+}
+
+bool xbot::service::Service::SetPeriodicTaskInterval(int task_id,
+                                                     uint32_t interval_micros) {
+  return scheduler_.setInterval(task_id, interval_micros,
+                                system::getTimeMicros() + interval_micros);
+}
+
+void xbot::service::Service::runTick() {
+  if (telemetry_interval_micros_ == 0) {
+    tick();
+    return;
+  }
+  const uint32_t start_micros = system::getTimeMicros();
+  if (last_tick_valid_) {
+    const int32_t jitter = static_cast<int32_t>(
+        start_micros - last_tick_start_micros_ - tick_rate_micros_);
+    telemetry_.tick_jitter_histogram[datatypes::telemetryHistogramBucket(
+        jitter < 0 ? -jitter : jitter)]++;
   }
+  last_tick_start_micros_ = start_micros;
+  last_tick_valid_ = true;
+
+  tick();
+
+  const uint32_t duration_micros = system::getTimeMicros() - start_micros;
+  telemetry_.tick_duration_histogram[datatypes::telemetryHistogramBucket(
+      duration_micros)]++;
+  if (duration_micros > telemetry_.max_tick_duration_micros) {
+    telemetry_.max_tick_duration_micros = duration_micros;
+  }
+}
+
+void xbot::service::Service::SendTelemetry() {
+  if (target_ip == 0 || target_port == 0) {
+    return;
+  }
+  telemetry_.tick_overruns = scheduler_.getOverruns(tick_task_);
+  telemetry_.cpu_time_micros = system::getThreadCpuTimeMicros();
+  telemetry_.queue_high_water_mark = queue_high_water_mark_.load();
+  telemetry_.queue_length = packet_queue_length;
+  telemetry_.queue_drops = queue_drops_.load();
+  // The batch is shared, so its failures can't be told apart by service
+  telemetry_.tx_failures = tx_failures_.load() + Io::getTxBatchFailures();
+
+  Lock lk(&state_mutex_);
+  telemetry_.retransmits = reliable_sender_.getRetransmits();
+  telemetry_.reliable_failures = reliable_sender_.getFailures();
+  fillHeader();
+  header_.message_type = datatypes::MessageType::TELEMETRY;
+  header_.payload_size = sizeof(telemetry_);
+  const packet::PacketSegment segments[] = {{&header_, sizeof(header_)},
+                                            {&telemetry_, sizeof(telemetry_)}};
+  transmitSegmentsToTarget(segments, 2);
+}
+
+void xbot::service::Service::SendTimeSyncRequest() {
+  if (target_ip == 0 || target_port == 0) {
+    return;
+  }
+  datatypes::TimeSyncPayload payload{};
+
+  Lock lk(&state_mutex_);
+  if (clock_sync_.isSynchronized()) {
+    // Only keep track of the drift from now on
+    scheduler_.setInterval(
+        time_sync_task_, config::time_sync_interval_micros,
+        system::getTimeMicros() + config::time_sync_interval_micros);
+  }
+  fillHeader();
+  header_.message_type = datatypes::MessageType::TIME_SYNC;
+  header_.arg1 = 0;
+  header_.payload_size = sizeof(payload);
+  // Take the time as late as possible
+  time_sync_request_sent_ = system::getTimeNanos();
+  payload.request_sent = time_sync_request_sent_;
+  const packet::PacketSegment segments[] = {{&header_, sizeof(header_)},
+                                            {&payload, sizeof(payload)}};
+  transmitSegmentsToTarget(segments, 2);
+}
+
+bool xbot::service::Service::transmitToTarget(packet::PacketPtr packet) {
+  if (!Io::transmitPacket(packet, target_ip, target_port)) {
+    tx_failures_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool xbot::service::Service::transmitSegmentsToTarget(
+    const packet::PacketSegment *segments, size_t segment_count) {
+  if (!Io::transmitSegments(segments, segment_count, target_ip, target_port)) {
+    tx_failures_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+bool xbot::service::Service::transmitReliableToTarget(
+    const packet::PacketSegment *segments, size_t segment_count) {
+  // Keep a copy, the segments are only valid during this call. We hold the
+  // state_mutex_, so don't wait for a free packet.
+  packet::PacketPtr copy = packet::tryAllocatePacket();
+  if (copy == nullptr) {
+    // Send it once at least
+    reliable_sender_.countFailure();
+    transmitSegmentsToTarget(segments, segment_count);
+    return false;
+  }
+  header_.flags |= datatypes::FLAG_RELIABLE;
+  for (size_t i = 0; i < segment_count; i++) {
+    packet::packetAppendData(copy, segments[i].data, segments[i].size);
+  }
+  const bool result = transmitSegmentsToTarget(segments, segment_count);
+  header_.flags &= ~datatypes::FLAG_RELIABLE;
+  // Track it even if the transmission failed, the retransmission might work
+  reliable_sender_.track(header_.sequence_no, copy, system::getTimeMicros());
+  return result;
+}
+
+void xbot::service::Service::SendAck(uint16_t sequence_no) {
+  if (target_ip == 0 || target_port == 0) {
+    return;
+  }
+  // Don't use header_, the ACK doesn't get a sequence number of its own
+  datatypes::XbotHeader header{};
+  header.protocol_version = 1;
+  header.message_type = datatypes::MessageType::ACK;
+  header.service_id = service_id_;
+  header.sequence_no = sequence_no;
+  header.timestamp = GetTimestamp();
+  packet::PacketPtr ptr = packet::allocatePacket();
+  packet::packetAppendData(ptr, &header, sizeof(header));
+  transmitToTarget(ptr);
+}
+
+void xbot::service::Service::setRunning(bool running) {
+  is_running_ = running;
+  // Don't measure the jitter across a pause
+  last_tick_valid_ = false;
+  const uint32_t now_micros = system::getTimeMicros();
+  // tick() is only called while running, a tick rate of 0 disables it.
+  scheduler_.setInterval(tick_task_, running ? tick_rate_micros_ : 0,
+                         now_micros + tick_rate_micros_);
+  // Ask for a (new) configuration as long as we're not running. Without a
+  // target, the claim will schedule this.
+  const bool request_configuration =
+      !running && target_ip > 0 && target_port > 0;
+  scheduler_.setInterval(
+      configuration_request_task_,
+      request_configuration ? config::request_configuration_interval_micros : 0,
+      now_micros + config::request_configuration_interval_micros);
+}
+
+void xbot::service::Service::runProcessing() {
+  tick_task_ = scheduler_.addTask(
+      [](void *service) {
+        const auto self = static_cast<Service *>(service);
+        const bool coalescing = self->BeginCoalescing();
+        self->runTick();
+        if (coalescing) {
+          self->EndCoalescing();
+        }
+      },
+      this);
+  heartbeat_task_ = scheduler_.addTask(
+      [](void *service) {
+        const auto self = static_cast<Service *>(service);
+        ULOG_ARG_DEBUG(&self->service_id_, "Sending heartbeat");
+        self->heartbeat();
+      },
+      this);
+  advertisement_task_ = scheduler_.addTask(
+      [](void *service) {
+        const auto self = static_cast<Service *>(service);
+        ULOG_ARG_DEBUG(&self->service_id_, "Sending SD advertisement");
+        self->advertiseService();
+      },
+      this);
+  configuration_request_task_ = scheduler_.addTask(
+      [](void *service) {
+        const auto self = static_cast<Service *>(service);
+        if (!self->isConfigured()) {
+          ULOG_ARG_DEBUG(&self->service_id_, "Requesting Configuration");
+          self->SendConfigurationRequest();
+        }
+      },
+      this);
+  telemetry_task_ = scheduler_.addTask(
+      [](void *service) { static_cast<Service *>(service)->SendTelemetry(); },
+      this);
+  time_sync_task_ = scheduler_.addTask(
+      [](void *service) {
+        static_cast<Service *>(service)->SendTimeSyncRequest();
+      },
+      this);
+  // Advertise right away and with the fast interval until we're claimed.
+  scheduler_.setInterval(advertisement_task_,
+                         config::sd_advertisement_interval_micros_fast,
+                         system::getTimeMicros());
+
   OnCreate();
   clearConfiguration();
   // If after clearing the config, the service is configured, it does not need
@@ -200,8 +511,10 @@ void xbot::service::Service::runProcessing() {
     // Call the configure lifecycle hook regardless
     Configure();
     OnStart();
-    is_running_ = true;
+    setRunning(true);
   }
+  uint32_t tick_overruns = 0;
+  uint32_t heartbeat_overruns = 0;
   while (true) {
     // Check, if we should stop
     {
@@ -211,43 +524,47 @@ void xbot::service::Service::runProcessing() {
       }
     }
 
-    // Fetch from queue
-    packet::PacketPtr packet;
-    uint32_t now_micros = system::getTimeMicros();
-    // Calculate when the next tick needs to happen (expected tick rate - time
-    // elapsed)
-    int32_t block_time = tick_rate_micros_ > 0 ? static_cast<int32_t>(tick_rate_micros_ -
-                                              (now_micros - last_tick_micros_)) : 0;
-    // If this is ture, we have a rollover (since we should need to wait longer
-    // than the tick length)
-    if (is_running_) {
-      if (block_time < 0) {
-        ULOG_ARG_WARNING(&service_id_,
-                         "Service too slow to keep up with tick rate.");
-        block_time = 0;
-      }
-    } else {
-      block_time = tick_rate_micros_;
+    // Run everything that is due, then sleep until the next task is due or a
+    // packet arrives.
+    uint32_t block_time = scheduler_.run(system::getTimeMicros());
+    if (scheduler_.getOverruns(tick_task_) != tick_overruns) {
+      tick_overruns = scheduler_.getOverruns(tick_task_);
+      ULOG_ARG_WARNING(&service_id_,
+                       "Service too slow to keep up with tick rate.");
     }
-    // If this is true, we have a rollover (since we should need to wait longer
-    // than the tick length)
-    if (heartbeat_micros_ > 0) {
-      int32_t time_to_next_heartbeat = static_cast<int32_t>(
-          heartbeat_micros_ - (now_micros - last_heartbeat_micros_));
-      if(time_to_next_heartbeat < 0) {
-        ULOG_ARG_WARNING(&service_id_,
-                         "Service too slow to keep up with heartbeat rate.");
-        time_to_next_heartbeat = 0;
-      }
-      block_time = block_time < time_to_next_heartbeat ? block_time : time_to_next_heartbeat;
+    if (scheduler_.getOverruns(heartbeat_task_) != heartbeat_overruns) {
+      heartbeat_overruns = scheduler_.getOverruns(heartbeat_task_);
+      ULOG_ARG_WARNING(&service_id_,
+                       "Service too slow to keep up with heartbeat rate.");
     }
-    if (!is_running_) {
-      // When not running, we need to block shorter than the config request
-      // interval
-      block_time = block_time < static_cast<int32_t>(config::request_configuration_interval_micros) ? block_time : static_cast<int32_t>(config::request_configuration_interval_micros);
+
+    {
+      // Reliable packets sent from other threads are only checked once the
+      // processing thread wakes up.
+      Lock lk(&state_mutex_);
+      const uint32_t retransmit_time = reliable_sender_.poll(
+          system::getTimeMicros(),
+          [](packet::PacketPtr packet, void *service) {
+            void *buffer = nullptr;
+            size_t size = 0;
+            if (!packet::packetGetData(packet, &buffer, &size)) {
+              return;
+            }
+            // Send from the kept packet, no need for a copy
+            const packet::PacketSegment segment{buffer, size};
+            static_cast<Service *>(service)->transmitSegmentsToTarget(&segment,
+                                                                      1);
+          },
+          this);
+      if (retransmit_time < block_time) {
+        block_time = retransmit_time;
+      }
     }
+
+    packet::PacketPtr packet;
     if (queue::queuePopItem(&packet_queue_, reinterpret_cast<void **>(&packet),
                             block_time)) {
+      queued_packets_.fetch_sub(1);
       void *buffer = nullptr;
       size_t used_data = 0;
       if (packet::packetGetData(packet, &buffer, &used_data)) {
@@ -255,71 +572,100 @@ void xbot::service::Service::runProcessing() {
         const uint8_t *const payload_buffer =
             reinterpret_cast<uint8_t *>(buffer) + sizeof(datatypes::XbotHeader);
 
-        switch (header->message_type) {
-          case datatypes::MessageType::CLAIM:
-            HandleClaimMessage(header, payload_buffer, header->payload_size);
+        bool duplicate = false;
+        if (header->flags & datatypes::FLAG_RELIABLE) {
+          // Acknowledge duplicates as well, the first ACK might have been
+          // lost.
+          SendAck(header->sequence_no);
+          duplicate = !reliable_window_.accept(header->sequence_no);
+          if (duplicate) {
+            ULOG_ARG_DEBUG(&service_id_, "Dropping duplicate packet");
+          }
+        }
 
-            break;
-          case datatypes::MessageType::DATA:
-            if (is_running_) {
-              HandleDataMessage(header, payload_buffer, header->payload_size);
-            }
-            break;
-          case datatypes::MessageType::TRANSACTION:
-            if (header->arg1 == 0 && is_running_) {
-              HandleDataTransaction(header, payload_buffer,
-                                    header->payload_size);
-            } else if (header->arg1 == 1) {
-              HandleConfigurationTransaction(header, payload_buffer,
-                                             header->payload_size);
+        if (!duplicate) {
+          switch (header->message_type) {
+            case datatypes::MessageType::CLAIM:
+              HandleClaimMessage(header, payload_buffer, header->payload_size);
+
+              break;
+            case datatypes::MessageType::DATA:
+              if (is_running_) {
+                HandleDataMessage(header, payload_buffer, header->payload_size);
+              }
+              break;
+            case datatypes::MessageType::TRANSACTION:
+              if (header->arg1 == 0 && is_running_) {
+                HandleDataTransaction(header, payload_buffer,
+                                      header->payload_size);
+              } else if (header->arg1 == 1) {
+                HandleConfigurationTransaction(header, payload_buffer,
+                                               header->payload_size);
+              } else if (header->arg1 == 2) {
+                HandleConfigurationUpdate(header, payload_buffer,
+                                          header->payload_size);
+              }
+              break;
+            case datatypes::MessageType::TIME_SYNC:
+              HandleTimeSyncMessage(header, payload_buffer, header->payload_size);
+              break;
+            case datatypes::MessageType::ACK: {
+              Lock lk(&state_mutex_);
+              reliable_sender_.acknowledge(header->sequence_no,
+                                           system::getTimeMicros());
+              break;
             }
-            break;
-          default:
-            ULOG_ARG_WARNING(&service_id_, "Got unsupported message");
-            break;
+            case datatypes::MessageType::SERVICE_QUERY:
+              if (header->arg1 == 0) {
+                ULOG_ARG_DEBUG(&service_id_, "Sending service description");
+                sendServiceDescription();
+              }
+              break;
+            default:
+              ULOG_ARG_WARNING(&service_id_, "Got unsupported message");
+              break;
+          }
         }
       }
 
       packet::freePacket(packet);
     }
-    uint32_t now = system::getTimeMicros();
-    // Measure time required for the tick() call, so that we can subtract
-    // before next timeout
-    if (is_running_ &&
-        now >= last_tick_micros_ + tick_rate_micros_) {
-      last_tick_micros_ = now;
-      tick();
-    }
-    if (now >= last_service_discovery_micros_ + ((target_ip > 0 && target_port > 0)
-             ? config::sd_advertisement_interval_micros
-             : config::sd_advertisement_interval_micros_fast)) {
-      ULOG_ARG_DEBUG(&service_id_, "Sending SD advertisement");
-      advertiseService();
-      last_service_discovery_micros_ = now;
-    }
-    if (heartbeat_micros_ > 0 &&
-        now > last_heartbeat_micros_+heartbeat_micros_) {
-      ULOG_ARG_DEBUG(&service_id_, "Sending heartbeat");
-      heartbeat();
-    }
-    if (!is_running_ && !isConfigured() && target_ip > 0 && target_port > 0 &&
-        now > last_configuration_request_micros_ + config::request_configuration_interval_micros) {
-      ULOG_ARG_DEBUG(&service_id_, "Requesting Configuration");
-      SendConfigurationRequest();
-    }
   }
 }
 void xbot::service::Service::HandleClaimMessage(
     xbot::datatypes::XbotHeader *header, const void *payload,
     size_t payload_len) {
-  (void)header;
   ULOG_ARG_INFO(&service_id_, "Received claim message");
-  if (payload_len != sizeof(datatypes::ClaimPayload)) {
+  // Claims from older interfaces don't contain the telemetry interval.
+  constexpr size_t min_payload_len =
+      offsetof(datatypes::ClaimPayload, telemetry_interval_micros);
+  const size_t policies_len =
+      payload_len > sizeof(datatypes::ClaimPayload)
+          ? payload_len - sizeof(datatypes::ClaimPayload)
+          : 0;
+  if ((payload_len < sizeof(datatypes::ClaimPayload) &&
+       payload_len != min_payload_len) ||
+      policies_len % sizeof(datatypes::OutputPolicy) != 0 ||
+      policies_len / sizeof(datatypes::OutputPolicy) >
+          config::max_output_policies) {
     ULOG_ARG_ERROR(&service_id_, "claim message with invalid payload size");
     return;
   }
   const auto payload_ptr =
       reinterpret_cast<const datatypes::ClaimPayload *>(payload);
+  // Our interface changed its telemetry interval or output policies, keep
+  // everything else.
+  const bool update = header->arg2 == 1 &&
+                      target_ip == payload_ptr->target_ip &&
+                      target_port == payload_ptr->target_port;
+  if (target_ip != payload_ptr->target_ip ||
+      target_port != payload_ptr->target_port) {
+    // Different interface, different clock and sequence numbers
+    Lock lk(&state_mutex_);
+    clock_sync_.reset();
+    reliable_sender_.reset();
+    reliable_window_.reset();
+  }
   target_ip = payload_ptr->target_ip;
   target_port = payload_ptr->target_port;
   heartbeat_micros_ = payload_ptr->heartbeat_micros;
@@ -332,21 +678,92 @@ void xbot::service::Service::HandleClaimMessage(
   // send heartbeat at twice the requested rate
   heartbeat_micros_ >>= 1;
 
+  telemetry_interval_micros_ =
+      payload_len >= sizeof(datatypes::ClaimPayload)
+          ? payload_ptr->telemetry_interval_micros
+          : 0;
+
+  {
+    // Each claim replaces all policies
+    Lock lk(&state_mutex_);
+    clearOutputPolicies();
+    if (!update) {
+      // The claiming interface might not know any values yet
+      invalidateSentOutputs();
+    }
+    const auto policies = reinterpret_cast<const datatypes::OutputPolicy *>(
+        static_cast<const uint8_t *>(payload) +
+        sizeof(datatypes::ClaimPayload));
+    for (size_t i = 0; i < policies_len / sizeof(datatypes::OutputPolicy);
+         i++) {
+      if (!setOutputPolicy(policies[i])) {
+        ULOG_ARG_WARNING(&service_id_, "Policy for unknown output requested");
+      }
+    }
+  }
+
+  const uint32_t now_micros = system::getTimeMicros();
+  scheduler_.setInterval(telemetry_task_, telemetry_interval_micros_,
+                         now_micros + telemetry_interval_micros_);
+  if (update) {
+    ULOG_ARG_INFO(&service_id_, "claim updated.");
+    SendDataClaimAck();
+    return;
+  }
+  scheduler_.setInterval(heartbeat_task_, heartbeat_micros_, now_micros);
+  scheduler_.setInterval(time_sync_task_, config::time_sync_interval_micros_fast,
+                         now_micros);
+  scheduler_.setInterval(
+      advertisement_task_, config::sd_advertisement_interval_micros,
+      now_micros + config::sd_advertisement_interval_micros);
+  if (!is_running_) {
+    // We have a target now, ask it for the configuration
+    scheduler_.setInterval(configuration_request_task_,
+                           config::request_configuration_interval_micros,
+                           now_micros);
+  }
+
   ULOG_ARG_INFO(&service_id_, "service claimed successfully.");
 
   SendDataClaimAck();
 }
+void xbot::service::Service::HandleTimeSyncMessage(
+    xbot::datatypes::XbotHeader *header, const void *payload,
+    size_t payload_len) {
+  const uint64_t response_received = system::getTimeNanos();
+  if (header->arg1 != 1 || payload_len != sizeof(datatypes::TimeSyncPayload)) {
+    ULOG_ARG_WARNING(&service_id_, "Got invalid time sync message");
+    return;
+  }
+  datatypes::TimeSyncPayload response{};
+  memcpy(&response, payload, sizeof(response));
+
+  Lock lk(&state_mutex_);
+  if (response.request_sent != time_sync_request_sent_) {
+    // Response to an older request, the round trip is unknown
+    return;
+  }
+  clock_sync_.addSample(response.request_sent, response.request_received,
+                        response.response_sent, response_received);
+}
+
 void xbot::service::Service::HandleDataMessage(
     xbot::datatypes::XbotHeader *header, const void *payload,
     size_t payload_len) {
   (void)payload_len;
+  const bool coalescing = BeginCoalescing();
   // Packet seems OK, hand to service implementation
   handleData(header->arg2, payload, header->payload_size);
+  if (coalescing) {
+    EndCoalescing();
+  }
 }
 void xbot::service::Service::HandleDataTransaction(
     xbot::datatypes::XbotHeader *header, const void *payload,
     size_t payload_len) {
   (void)header;
+  // Outputs of all callbacks for this transaction go into one transaction
+  const bool coalescing = BeginCoalescing();
   const auto payload_buffer = static_cast<const uint8_t *>(payload);
   // Go through all data packets in the transaction
   size_t processed_len = 0;
@@ -373,6 +790,9 @@ void xbot::service::Service::HandleDataTransaction(
   if (processed_len != payload_len) {
     ULOG_ARG_ERROR(&service_id_, "Transaction size mismatch");
   }
+  if (coalescing) {
+    EndCoalescing();
+  }
 }
 void xbot::service::Service::HandleConfigurationTransaction(
     xbot::datatypes::XbotHeader *header, const void *payload,
@@ -383,7 +803,7 @@ void xbot::service::Service::HandleConfigurationTransaction(
     OnStop();
   }
   clearConfiguration();
-  is_running_ = false;
+  setRunning(false);
 
   bool register_success = true;
   // Set the registers
@@ -418,13 +838,68 @@ void xbot::service::Service::HandleConfigurationTransaction(
   // isConfigured() checks if overall config is correct
   if (register_success && isConfigured()) {
     // successfully set all registers, start the service if it was configured correctly
-    if(Configure()) {
-      OnStart();
-      is_running_ = true;
-    } else {
-      // Need to reset configuration, so that a new one is requested
-      clearConfiguration();
+    StartWithConfiguration();
+  }
+}
+
+void xbot::service::Service::HandleConfigurationUpdate(
+    xbot::datatypes::XbotHeader *header, const void *payload,
+    size_t payload_len) {
+  (void)header;
+  if (!is_running_) {
+    // Nothing to update, the interface has to send a full configuration. It
+    // might not know that we lost ours, so ask right away.
+    ULOG_ARG_WARNING(&service_id_,
+                     "Ignoring configuration update, service is not running");
+    SendConfigurationRequest();
+    return;
+  }
+
+  // Stage all registers first, so that the update is applied completely or
+  // not at all.
+  bool register_success = true;
+  const auto payload_buffer = static_cast<const uint8_t *>(payload);
+  size_t processed_len = 0;
+  while (processed_len + sizeof(datatypes::DataDescriptor) <= payload_len) {
+    const auto descriptor = reinterpret_cast<const datatypes::DataDescriptor *>(
+        payload_buffer + processed_len);
+    size_t data_size = descriptor->payload_size;
+    if (processed_len + sizeof(datatypes::DataDescriptor) + data_size >
+        payload_len) {
+      break;
     }
+    register_success &= stageRegister(
+        descriptor->target_id,
+        payload_buffer + processed_len + sizeof(datatypes::DataDescriptor),
+        data_size);
+    processed_len += data_size + sizeof(datatypes::DataDescriptor);
+  }
+
+  if (processed_len != payload_len || !register_success) {
+    ULOG_ARG_ERROR(&service_id_, "Invalid configuration update, ignoring it");
+    discardStagedRegisters();
+    return;
+  }
+
+  // We are between two ticks, so the service sees either the old or the new
+  // registers.
+  if (commitStagedRegisters()) {
+    return;
+  }
+  // At least one register can't be changed at runtime
+  ULOG_ARG_INFO(&service_id_, "Restarting service to apply configuration");
+  OnStop();
+  setRunning(false);
+  StartWithConfiguration();
+}
+
+void xbot::service::Service::StartWithConfiguration() {
+  if (Configure()) {
+    OnStart();
+    setRunning(true);
+  } else {
+    // Need to reset configuration, so that a new one is requested
+    clearConfiguration();
   }
 }
 bool xbot::service::Service::SendConfigurationRequest() {
@@ -440,7 +915,6 @@ bool xbot::service::Service::SendConfigurationRequest() {
 
     packet::packetAppendData(ptr, &header_, sizeof(header_));
   }
-  Io::transmitPacket(ptr, target_ip, target_port);
-  last_configuration_request_micros_ = system::getTimeMicros();
+  transmitToTarget(ptr);
   return true;
 }
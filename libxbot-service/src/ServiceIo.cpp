@@ -9,14 +9,22 @@
 namespace xbot::service {
 
 ServiceIo::ServiceIo(uint32_t service_id)
-    : service_id_(service_id), next_service_(nullptr) {}
+    : service_id_(service_id) {}
 
 bool ServiceIo::ioInput(packet::PacketPtr packet) {
+  // Count before pushing, so that the consumer never sees a negative count.
+  const uint16_t queued = queued_packets_.fetch_add(1) + 1;
   if (!queue::queuePushItem(&packet_queue_, packet)) {
+    queued_packets_.fetch_sub(1);
+    queue_drops_.fetch_add(1, std::memory_order_relaxed);
     ULOG_ARG_ERROR(&service_id_, "Error pushing packet into processing queue.");
     packet::freePacket(packet);
     return false;
   }
+  uint16_t high_water_mark = queue_high_water_mark_.load(std::memory_order_relaxed);
+  while (queued > high_water_mark &&
+         !queue_high_water_mark_.compare_exchange_weak(high_water_mark, queued, std::memory_order_relaxed)) {
+  }
   return true;
 }
 }  // namespace xbot::service
@@ -3,6 +3,8 @@
 //
 #include <ulog.h>
 
+#include <atomic>
+#include <thread>
 #include <xbot-service/Io.hpp>
 #include <xbot-service/Lock.hpp>
 #include <xbot-service/portable/thread.hpp>
@@ -10,10 +12,79 @@
 
 namespace xbot::service {
 
-// Keep track of the first registered service.
-// All services have a pointer to the next one, so we can loop through all
-// of them (for IO)
-static ServiceIo* firstService_ = nullptr;
+/**
+ * Lookup table for dispatching packets to services.
+ * Open addressing with linear probing on service_id. The table is at most
+ * half full, so lookups are constant time.
+ *
+ * Tables are immutable once published. Registration builds a new table and
+ * swaps the dispatch_table_ pointer (RCU style), so the IO thread never needs
+ * a lock to find a service.
+ */
+static constexpr size_t dispatch_table_size = [] {
+  size_t size = 1;
+  while (size < 2 * config::max_service_count) size <<= 1;
+  return size;
+}();
+struct DispatchTable {
+  ServiceIo* slots[dispatch_table_size];
+};
+
+// Two tables: the published one and the one the next registration writes to.
+static DispatchTable dispatch_tables_[2]{};
+static std::atomic<DispatchTable*> dispatch_table_{&dispatch_tables_[0]};
+// Incremented by the IO thread before and after each dispatch, so it is odd
+// while the IO thread might hold a pointer to a table.
+static std::atomic<uint32_t> dispatch_section_{0};
+
+// All registered services, protected by registration_mutex_
+static ServiceIo* registered_services_[config::max_service_count]{};
+static XBOT_MUTEX_TYPEDEF registration_mutex_{};
+
+static ServiceIo* findService(const DispatchTable* table, uint16_t service_id) {
+  for (size_t i = 0; i < dispatch_table_size; i++) {
+    ServiceIo* service = table->slots[(service_id + i) & (dispatch_table_size - 1)];
+    if (service == nullptr || service->service_id_ == service_id) {
+      return service;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * Builds a new table from registered_services_, publishes it and waits until
+ * the IO thread can't use the old one anymore.
+ * Needs registration_mutex_ to be held.
+ */
+static void publishDispatchTable() {
+  DispatchTable* old_table = dispatch_table_.load();
+  DispatchTable* new_table =
+      old_table == &dispatch_tables_[0] ? &dispatch_tables_[1] : &dispatch_tables_[0];
+
+  for (auto& slot : new_table->slots) {
+    slot = nullptr;
+  }
+  for (ServiceIo* service : registered_services_) {
+    if (service == nullptr) continue;
+    size_t idx = service->service_id_ & (dispatch_table_size - 1);
+    while (new_table->slots[idx] != nullptr) {
+      idx = (idx + 1) & (dispatch_table_size - 1);
+    }
+    new_table->slots[idx] = service;
+  }
+
+  dispatch_table_.store(new_table);
+
+  // Wait for the IO thread to leave a dispatch which could still use the old
+  // table. Afterwards the old table can be rewritten by the next registration
+  // and unregistered services won't receive any more packets.
+  const uint32_t section = dispatch_section_.load();
+  if (section & 1) {
+    while (dispatch_section_.load() == section) {
+      std::this_thread::yield();
+    }
+  }
+}
 
 // This Socket is used for all UDP comms for all the services
 static XBOT_SOCKET_TYPEDEF udp_socket_{};
@@ -31,67 +102,120 @@ static const char* IO_THD_NAME = "xbot-io";
 
 using namespace xbot::service;
 
+// Hands a single xBot packet to the service's processing queue.
+static void deliverPacket(packet::PacketPtr packet, uint16_t service_id) {
+  bool packet_delivered = false;
+  dispatch_section_.fetch_add(1);
+  ServiceIo* service = findService(dispatch_table_.load(), service_id);
+  if (service != nullptr && !service->stopped) {
+    // Give packet to service
+    service->ioInput(packet);
+    packet_delivered = true;
+  }
+  dispatch_section_.fetch_add(1);
+  if (!packet_delivered) {
+    // service not running or not found
+    packet::freePacket(packet);
+  }
+}
+
+// Checks a received datagram and dispatches the xBot packets in it.
+static void dispatchPacket(packet::PacketPtr packet) {
+  void* buffer = nullptr;
+  size_t used_data = 0;
+  if (!packet::packetGetData(packet, &buffer, &used_data)) {
+    packet::freePacket(packet);
+    return;
+  }
+  if (used_data < sizeof(datatypes::XbotHeader)) {
+    ULOG_ARG_ERROR(&service_id_, "Packet too short to contain header.");
+    packet::freePacket(packet);
+    return;
+  }
+
+  const auto header = static_cast<datatypes::XbotHeader*>(buffer);
+  if (used_data - sizeof(datatypes::XbotHeader) == header->payload_size) {
+    // Single xBot packet, deliver as is.
+    deliverPacket(packet, header->service_id);
+    return;
+  }
+
+  // Multiple xBot packets chained in one datagram, split them so that every
+  // service gets its own packet.
+  const auto data = static_cast<const uint8_t*>(buffer);
+  size_t offset = 0;
+  while (offset + sizeof(datatypes::XbotHeader) <= used_data) {
+    const auto chained_header = reinterpret_cast<const datatypes::XbotHeader*>(data + offset);
+    const size_t packet_size = sizeof(datatypes::XbotHeader) + chained_header->payload_size;
+    if (offset + packet_size > used_data) {
+      break;
+    }
+    // Don't block the IO thread on the pool, drop the packet instead
+    packet::PacketPtr chained_packet = packet::tryAllocatePacket();
+    if (chained_packet != nullptr) {
+      packet::packetAppendData(chained_packet, data + offset, packet_size);
+      deliverPacket(chained_packet, chained_header->service_id);
+    }
+    offset += packet_size;
+  }
+  if (offset != used_data) {
+    ULOG_ARG_ERROR(&service_id_, "Packet header size does not match actual packet size.");
+  }
+  packet::freePacket(packet);
+}
+
 void runIo(void* arg) {
   (void)arg;
+  packet::PacketPtr packets[config::service::io_batch_size];
   while (true) {
-    packet::PacketPtr packet = nullptr;
-
-    if (sock::receivePacket(&udp_socket_, &packet)) {
-      // Got a packet, check if valid and put it into the processing queue.
-      void* buffer = nullptr;
-      size_t used_data = 0;
-      if (!packet::packetGetData(packet, &buffer, &used_data)) {
-        packet::freePacket(packet);
-        continue;
-      }
-      if (used_data < sizeof(datatypes::XbotHeader)) {
-        ULOG_ARG_ERROR(&service_id_, "Packet too short to contain header.");
-        packet::freePacket(packet);
-        continue;
-      }
-
-      const auto header = static_cast<datatypes::XbotHeader*>(buffer);
-      // Check, if the header size is correct
-      if (used_data - sizeof(datatypes::XbotHeader) != header->payload_size) {
-        // TODO: In order to allow chaining of xBot packets in the future,
-        // this needs to be adapted. (scan and split packets)
-        ULOG_ARG_ERROR(&service_id_,
-                       "Packet header size does not match actual packet size.");
-        packet::freePacket(packet);
-        continue;
-      }
-      bool packet_delivered = false;
-      for (ServiceIo* service = firstService_; service != nullptr;
-           service = service->next_service_) {
-        if (service->service_id_ == header->service_id) {
-          Lock lk(&service->state_mutex_);
-          if (!service->stopped) {
-            // Give packet to service
-            service->ioInput(packet);
-            packet_delivered = true;
-            break;
-          }
-        }
-      }
-      if (!packet_delivered) {
-        // service not running or not found
-        packet::freePacket(packet);
-      }
+    // Drain as many packets as available with a single call
+    const size_t count = sock::receivePackets(&udp_socket_, packets, config::service::io_batch_size);
+    for (size_t i = 0; i < count; i++) {
+      dispatchPacket(packets[i]);
     }
   }
 }
 
 bool Io::registerServiceIo(ServiceIo* service) {
-  ServiceIo** last_service = &firstService_;
-  while (*last_service != nullptr) {
-    last_service = &(*last_service)->next_service_;
+  if (service == nullptr) return false;
+  Lock lk(&registration_mutex_);
+  ServiceIo** free_slot = nullptr;
+  for (ServiceIo*& registered : registered_services_) {
+    if (registered == nullptr) {
+      if (free_slot == nullptr) free_slot = &registered;
+    } else if (registered->service_id_ == service->service_id_) {
+      ULOG_ARG_ERROR(&service->service_id_, "A service with this ID is already registered");
+      return false;
+    }
+  }
+  if (free_slot == nullptr) {
+    ULOG_ARG_ERROR(&service->service_id_, "Too many services, increase config::max_service_count");
+    return false;
   }
-  *last_service = service;
+  *free_slot = service;
+  publishDispatchTable();
   return true;
 }
+
+bool Io::unregisterServiceIo(ServiceIo* service) {
+  Lock lk(&registration_mutex_);
+  for (ServiceIo*& registered : registered_services_) {
+    if (registered == service) {
+      registered = nullptr;
+      publishDispatchTable();
+      return true;
+    }
+  }
+  return false;
+}
 bool Io::transmitPacket(packet::PacketPtr packet, uint32_t ip, uint16_t port) {
   return sock::transmitPacket(&udp_socket_, packet, ip, port);
 }
+bool Io::transmitSegments(const packet::PacketSegment* segments,
+                          size_t segment_count, uint32_t ip, uint16_t port) {
+  return sock::transmitSegments(&udp_socket_, segments, segment_count, ip,
+                                port);
+}
 bool Io::transmitPacket(packet::PacketPtr packet, const char* ip,
                         uint16_t port) {
   return sock::transmitPacket(&udp_socket_, packet, ip, port);
@@ -99,13 +223,25 @@ bool Io::transmitPacket(packet::PacketPtr packet, const char* ip,
 bool Io::getEndpoint(char* ip, size_t ip_len, uint16_t* port) {
   return sock::getEndpoint(&udp_socket_, ip, ip_len, port);
 }
+uint32_t Io::getTxBatchFailures() {
+  return sock::getSocketStats(&udp_socket_).tx_batch_failures;
+}
 
 bool Io::start() {
+  thread::ThreadAttributes attributes{};
+  attributes.name = IO_THD_NAME;
+  return start(attributes);
+}
+
+bool Io::start(const thread::ThreadAttributes& attributes) {
   if (!sock::initialize(&udp_socket_, false)) {
     return false;
   }
-  return thread::initialize(&io_thread_, runIo, nullptr, nullptr, 0,
-                            IO_THD_NAME);
+  // The IO thread receives on this socket, so it can also take care of
+  // flushing batched packets in time. All receivers split chained xBot
+  // packets, so small packets to the same endpoint are sent as one datagram.
+  sock::setTxBatching(&udp_socket_, config::service::tx_batch_max_latency_micros, true);
+  return thread::initialize(&io_thread_, runIo, nullptr, attributes);
 }
 
 }  // namespace xbot::service
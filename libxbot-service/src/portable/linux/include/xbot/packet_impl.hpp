@@ -5,13 +5,39 @@
 #ifndef PACKET_IMPL_HPP
 #define PACKET_IMPL_HPP
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <xbot/config.hpp>
 
 namespace xbot::service::packet {
 struct Packet {
   size_t used_data;
+  // Index of the next free packet while this packet is in the pool's free
+  // list. Only valid while the packet is not allocated.
+  std::atomic<uint32_t> next_free;
   uint8_t buffer[xbot::config::max_packet_size];
 };
+
+/**
+ * Statistics of the packet pool, use these to size
+ * config::service::packet_pool_size.
+ */
+struct PacketPoolStats {
+  // Total number of packets in the pool
+  uint32_t capacity;
+  // Packets currently allocated
+  uint32_t in_use;
+  // Max. packets allocated at the same time
+  uint32_t high_water_mark;
+  // Number of allocations which found the pool empty (and had to wait, unless
+  // they used tryAllocatePacket())
+  uint32_t exhausted_count;
+  // Total bytes copied into packets using packetAppendData()
+  uint64_t bytes_copied;
+};
+
+PacketPoolStats getPacketPoolStats();
 }  // namespace xbot::service::packet
 
 #define XBOT_PACKET_TYPEDEF Packet
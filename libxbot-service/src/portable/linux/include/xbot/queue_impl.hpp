@@ -5,7 +5,9 @@
 #ifndef QUEUE_IMPL_HPP
 #define QUEUE_IMPL_HPP
 
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 
 namespace xbot::service::queue {
 // Simple blocking queue implementation
@@ -44,8 +46,69 @@ class BlockingQueue {
   std::condition_variable cv_pop_{};
 };
 
+/**
+ * Futex based event used to park threads waiting for the queue.
+ * notify() is a single load as long as nobody is waiting, so the fast path
+ * never enters the kernel.
+ */
+class FutexEvent {
+ public:
+  /**
+   * Announce that the caller is about to wait. Re-check the condition after
+   * calling this, then either call wait() or cancelWait().
+   * @return the epoch to pass to wait()
+   */
+  uint32_t prepareWait();
+
+  void cancelWait();
+
+  /**
+   * Park until notify() is called or the timeout expired.
+   */
+  void wait(uint32_t epoch, uint32_t timeout_micros);
+
+  void notify();
+
+ private:
+  std::atomic<uint32_t> epoch_{0};
+  std::atomic<uint32_t> waiters_{0};
+};
+
+/**
+ * Bounded lock-free multi-producer / single-consumer ring queue.
+ *
+ * Slots hold the item pointers directly, nullptr marks an empty slot. Hence
+ * nullptr can't be pushed.
+ */
+class LockFreeQueue {
+ public:
+  LockFreeQueue() = default;
+
+  bool init(size_t size, void* buffer, size_t buffer_size);
+
+  bool push(void* ptr, uint32_t timeout_micros);
+
+  void* pop(uint32_t timeout_micros);
+
+ private:
+  bool tryPush(void* ptr);
+  void* tryPop();
+
+  std::atomic<void*>* slots_ = nullptr;
+  size_t queue_size_ = 0;
+
+  // Keep consumer and producer indices on separate cache lines.
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+
+  // Signalled on push (for the parked consumer) and on pop (for producers
+  // waiting on a full queue)
+  FutexEvent not_empty_{};
+  FutexEvent not_full_{};
+};
+
 }  // namespace xbot::service::queue
 
-#define XBOT_QUEUE_TYPEDEF xbot::service::queue::BlockingQueue
+#define XBOT_QUEUE_TYPEDEF xbot::service::queue::LockFreeQueue
 
 #endif  // QUEUE_IMPL_HPP
@@ -5,6 +5,80 @@
 #ifndef SOCKET_IMPL_HPP
 #define SOCKET_IMPL_HPP
 
-#define XBOT_SOCKET_TYPEDEF int
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <xbot/config.hpp>
+#include <xbot/packet_impl.hpp>
+
+namespace xbot::service::sock {
+/**
+ * Counters for the batched IO, average batch size is packets / calls.
+ */
+struct SocketStats {
+  uint32_t rx_calls;
+  uint32_t rx_packets;
+  uint32_t tx_calls;
+  uint32_t tx_packets;
+  // Packets which were appended to another datagram
+  uint32_t tx_coalesced;
+  // Packets which were sent from the caller's buffers without a copy
+  uint32_t tx_scatter_gather;
+  // Packets of the TX batch which could not be sent. Their transmit call
+  // already returned true.
+  uint32_t tx_batch_failures;
+};
+
+struct Socket {
+  int fd = -1;
+
+  // eventfd used to wake up the receiving thread when a new TX batch was
+  // started, so that it can flush the batch in time.
+  int wake_fd = -1;
+
+  // Max time a packet may wait in the TX batch, 0 to send packets right away.
+  uint32_t tx_max_latency_micros = 0;
+  // Append packets to a pending packet with the same destination, if it fits.
+  bool tx_coalesce = false;
+
+  // Pending TX batch, protected by tx_mutex
+  std::mutex tx_mutex{};
+  size_t tx_count = 0;
+  std::chrono::steady_clock::time_point tx_batch_started{};
+  packet::Packet* tx_packets[config::service::io_batch_size]{};
+  sockaddr_in tx_addresses[config::service::io_batch_size]{};
+
+  SocketStats stats{};
+};
+
+/**
+ * Enable batched transmission for a socket. Packets are collected and sent
+ * with a single syscall once io_batch_size packets are pending or the oldest
+ * packet waited for max_latency_micros.
+ *
+ * The deadline is enforced by receivePackets(), so only enable this on
+ * sockets which have a thread receiving on them.
+ *
+ * @param max_latency_micros 0 to disable batching
+ * @param coalesce true to append packets to a pending packet with the same
+ * destination, sending them as a single datagram. Only use this if the
+ * receivers can split the datagram again (e.g. chained xBot packets).
+ */
+bool setTxBatching(Socket* socket, uint32_t max_latency_micros, bool coalesce);
+
+/**
+ * Sends all packets in the TX batch. Packets which could not be sent are
+ * dropped and counted in SocketStats::tx_batch_failures.
+ * @return false, if not all packets could be sent
+ */
+bool flushPackets(Socket* socket);
+
+SocketStats getSocketStats(Socket* socket);
+}  // namespace xbot::service::sock
+
+#define XBOT_SOCKET_TYPEDEF xbot::service::sock::Socket
 
 #endif  // SOCKET_IMPL_HPP
@@ -5,8 +5,8 @@
 #ifndef THREAD_IMPL_HPP
 #define THREAD_IMPL_HPP
 
-#include <thread>
+#include <pthread.h>
 
-#define XBOT_THREAD_TYPEDEF std::thread*
+#define XBOT_THREAD_TYPEDEF pthread_t
 
 #endif  // THREAD_IMPL_HPP
@@ -2,27 +2,129 @@
 // Created by clemens on 3/21/24.
 //
 
-#include <cstdlib>
+#include <atomic>
+#include <cassert>
+#include <chrono>
 #include <cstring>
+#include <thread>
 #include <xbot-service/portable/packet.hpp>
 #include <xbot/config.hpp>
 
 using namespace xbot::service::packet;
 
-PacketPtr xbot::service::packet::allocatePacket() {
-  auto buffer = static_cast<Packet *>(malloc(sizeof(Packet)));
+namespace {
+constexpr uint32_t NO_PACKET = UINT32_MAX;
+constexpr uint32_t POOL_SIZE = xbot::config::service::packet_pool_size;
+static_assert(POOL_SIZE > 0 && POOL_SIZE < NO_PACKET);
+
+// All packets are preallocated here, so that we don't need the heap at
+// runtime.
+Packet pool_[POOL_SIZE]{};
+
+// Head of the lock-free free list (Treiber stack).
+// Lower 32 bits: index of the first free packet (or NO_PACKET).
+// Upper 32 bits: tag which is incremented on every pop to avoid ABA issues.
+std::atomic<uint64_t> free_head_{NO_PACKET};
+
+// Packets which were never handed out yet. These are not in the free list, so
+// that the pool does not need an explicit initialization step.
+std::atomic<uint32_t> next_unused_{0};
+
+std::atomic<uint32_t> in_use_{0};
+std::atomic<uint32_t> high_water_mark_{0};
+std::atomic<uint32_t> exhausted_count_{0};
+std::atomic<uint64_t> bytes_copied_{0};
+
+Packet *popFree() {
+  uint64_t head = free_head_.load(std::memory_order_acquire);
+  while (true) {
+    const uint32_t idx = static_cast<uint32_t>(head);
+    if (idx == NO_PACKET) {
+      return nullptr;
+    }
+    // The next pointer might be stale if another thread popped this packet
+    // in the meantime, the tag makes the CAS fail in that case.
+    const uint32_t next = pool_[idx].next_free.load(std::memory_order_relaxed);
+    const uint64_t new_head = (((head >> 32) + 1) << 32) | next;
+    if (free_head_.compare_exchange_weak(head, new_head, std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+      return &pool_[idx];
+    }
+  }
+}
+
+void pushFree(uint32_t idx) {
+  uint64_t head = free_head_.load(std::memory_order_relaxed);
+  uint64_t new_head;
+  do {
+    pool_[idx].next_free.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    new_head = (head & 0xFFFFFFFF00000000ULL) | idx;
+  } while (!free_head_.compare_exchange_weak(head, new_head, std::memory_order_release,
+                                             std::memory_order_relaxed));
+}
+
+Packet *takeUnused() {
+  uint32_t idx = next_unused_.load(std::memory_order_relaxed);
+  while (idx < POOL_SIZE) {
+    if (next_unused_.compare_exchange_weak(idx, idx + 1, std::memory_order_relaxed)) {
+      return &pool_[idx];
+    }
+  }
+  return nullptr;
+}
+
+Packet *takePacket() {
+  Packet *buffer = popFree();
+  if (buffer == nullptr) {
+    buffer = takeUnused();
+  }
+  if (buffer == nullptr) {
+    return nullptr;
+  }
+
+  const uint32_t used = in_use_.fetch_add(1, std::memory_order_relaxed) + 1;
+  uint32_t high_water_mark = high_water_mark_.load(std::memory_order_relaxed);
+  while (used > high_water_mark &&
+         !high_water_mark_.compare_exchange_weak(high_water_mark, used, std::memory_order_relaxed)) {
+  }
+
 #ifdef DEBUG_MEM
 #warning DEBUG_MEM enabled, disable for performance
-  memset(buffer, 0x42, sizeof(Packet));
+  memset(buffer->buffer, 0x42, sizeof(buffer->buffer));
 #endif
   // Set used data to 0, because packet is empty (byte contents might be random
   // at this point though)
   buffer->used_data = 0;
   return buffer;
 }
+}  // namespace
+
+PacketPtr xbot::service::packet::allocatePacket() {
+  Packet *buffer = takePacket();
+  if (buffer == nullptr) {
+    // Pool is exhausted, wait for someone to free a packet.
+    exhausted_count_.fetch_add(1, std::memory_order_relaxed);
+    do {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      buffer = takePacket();
+    } while (buffer == nullptr);
+  }
+  return buffer;
+}
+
+PacketPtr xbot::service::packet::tryAllocatePacket() {
+  Packet *buffer = takePacket();
+  if (buffer == nullptr) {
+    exhausted_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return buffer;
+}
 
 void xbot::service::packet::freePacket(PacketPtr packet_ptr) {
-  free(packet_ptr);
+  if (packet_ptr == nullptr) return;
+  assert(packet_ptr >= pool_ && packet_ptr < pool_ + POOL_SIZE);
+  in_use_.fetch_sub(1, std::memory_order_relaxed);
+  pushFree(static_cast<uint32_t>(packet_ptr - pool_));
 }
 
 bool xbot::service::packet::packetAppendData(PacketPtr packet,
@@ -33,6 +135,7 @@ bool xbot::service::packet::packetAppendData(PacketPtr packet,
 
   memcpy(packet->buffer + packet->used_data, buffer, size);
   packet->used_data += size;
+  bytes_copied_.fetch_add(size, std::memory_order_relaxed);
 
   return true;
 }
@@ -44,3 +147,13 @@ bool xbot::service::packet::packetGetData(PacketPtr packet, void **buffer,
   *size = packet->used_data;
   return true;
 }
+
+PacketPoolStats xbot::service::packet::getPacketPoolStats() {
+  return PacketPoolStats{
+      .capacity = POOL_SIZE,
+      .in_use = in_use_.load(std::memory_order_relaxed),
+      .high_water_mark = high_water_mark_.load(std::memory_order_relaxed),
+      .exhausted_count = exhausted_count_.load(std::memory_order_relaxed),
+      .bytes_copied = bytes_copied_.load(std::memory_order_relaxed),
+  };
+}
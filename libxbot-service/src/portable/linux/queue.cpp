@@ -1,10 +1,17 @@
 //
 // Created by clemens on 3/21/24.
 //
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 #include <cassert>
+#include <chrono>
+#include <climits>
 #include <condition_variable>
 #include <cstdlib>
 #include <mutex>
+#include <new>
 #include <queue>
 #include <xbot-service/portable/queue.hpp>
 
@@ -25,7 +32,8 @@ bool BlockingQueue::init(size_t size, void* buffer, size_t buffer_size) {
   return true;
 }
 
-BlockingQueue::~BlockingQueue() { free(buffer_); }
+// The buffer is owned by the caller, nothing to free here.
+BlockingQueue::~BlockingQueue() = default;
 
 bool BlockingQueue::push(void* ptr, uint32_t timeout_micros) {
   std::unique_lock lock(mutex_);
@@ -85,6 +93,136 @@ bool BlockingQueue::isEmpty() const { return item_count_ == 0; }
 
 bool BlockingQueue::isFull() const { return item_count_ == queue_size_; }
 
+uint32_t FutexEvent::prepareWait() {
+  waiters_.fetch_add(1, std::memory_order_seq_cst);
+  // Pairs with the fence in notify(): either we see the new item when
+  // re-checking the condition or the notifier sees us waiting.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return epoch_.load(std::memory_order_acquire);
+}
+
+void FutexEvent::cancelWait() { waiters_.fetch_sub(1, std::memory_order_relaxed); }
+
+void FutexEvent::wait(uint32_t epoch, uint32_t timeout_micros) {
+  if (timeout_micros == 0) {
+    // A zero timeout returns right away, don't spend a syscall on it.
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+    return;
+  }
+  timespec timeout{};
+  timeout.tv_sec = timeout_micros / 1000000;
+  timeout.tv_nsec = (timeout_micros % 1000000) * 1000;
+  // Returns immediately if the epoch changed since prepareWait().
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, epoch, &timeout, nullptr, 0);
+  waiters_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void FutexEvent::notify() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiters_.load(std::memory_order_relaxed) == 0) {
+    // Nobody parked, no need for a syscall.
+    return;
+  }
+  epoch_.fetch_add(1, std::memory_order_release);
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+static_assert(sizeof(std::atomic<void*>) == sizeof(void*), "atomic pointer needs to fit the queue buffer");
+static_assert(std::atomic<void*>::is_always_lock_free, "atomic pointer needs to be lock free");
+
+bool LockFreeQueue::init(size_t size, void* buffer, size_t buffer_size) {
+  (void)buffer_size;
+  // We need at least one space in the queue
+  assert(size >= 1);
+  assert(buffer != nullptr);
+  assert(buffer_size >= size * sizeof(std::atomic<void*>));
+  slots_ = static_cast<std::atomic<void*>*>(buffer);
+  for (size_t i = 0; i < size; i++) {
+    new (&slots_[i]) std::atomic<void*>(nullptr);
+  }
+  queue_size_ = size;
+  head_.store(0, std::memory_order_relaxed);
+  tail_.store(0, std::memory_order_relaxed);
+  return true;
+}
+
+bool LockFreeQueue::tryPush(void* ptr) {
+  uint64_t tail = tail_.load(std::memory_order_relaxed);
+  do {
+    if (tail - head_.load(std::memory_order_acquire) >= queue_size_) {
+      // Full
+      return false;
+    }
+    // Reserve the slot
+  } while (!tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed));
+  // The consumer has cleared the slot before moving head_ past it, so it is
+  // free. Publish the item.
+  slots_[tail % queue_size_].store(ptr, std::memory_order_release);
+  return true;
+}
+
+void* LockFreeQueue::tryPop() {
+  const uint64_t head = head_.load(std::memory_order_relaxed);
+  std::atomic<void*>& slot = slots_[head % queue_size_];
+  // nullptr means empty, or a producer has reserved the slot but not yet
+  // published its item. It will notify us once it did.
+  void* item = slot.load(std::memory_order_acquire);
+  if (item == nullptr) {
+    return nullptr;
+  }
+  slot.store(nullptr, std::memory_order_relaxed);
+  head_.store(head + 1, std::memory_order_release);
+  return item;
+}
+
+bool LockFreeQueue::push(void* ptr, uint32_t timeout_micros) {
+  if (ptr == nullptr) return false;
+  bool success = tryPush(ptr);
+  if (!success && timeout_micros > 0) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_micros);
+    while (true) {
+      const uint32_t epoch = not_full_.prepareWait();
+      success = tryPush(ptr);
+      // Less than a microsecond left counts as timed out, the futex would
+      // return immediately and we would spin until the deadline.
+      const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+          deadline - std::chrono::steady_clock::now());
+      if (success || remaining.count() <= 0) {
+        not_full_.cancelWait();
+        break;
+      }
+      not_full_.wait(epoch, remaining.count());
+    }
+  }
+  if (success) {
+    not_empty_.notify();
+  }
+  return success;
+}
+
+void* LockFreeQueue::pop(uint32_t timeout_micros) {
+  void* item = tryPop();
+  if (item == nullptr && timeout_micros > 0) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout_micros);
+    while (true) {
+      const uint32_t epoch = not_empty_.prepareWait();
+      item = tryPop();
+      // See push()
+      const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+          deadline - std::chrono::steady_clock::now());
+      if (item != nullptr || remaining.count() <= 0) {
+        not_empty_.cancelWait();
+        break;
+      }
+      not_empty_.wait(epoch, remaining.count());
+    }
+  }
+  if (item != nullptr) {
+    not_full_.notify();
+  }
+  return item;
+}
+
 bool xbot::service::queue::initialize(QueuePtr queue, size_t queue_length,
                                       void* buffer, size_t buffer_size) {
   // create the queue on the heap, we don't need the buffer.
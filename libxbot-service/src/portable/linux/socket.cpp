@@ -4,7 +4,9 @@
 #include <arpa/inet.h>
 #include <ifaddrs.h>
 #include <net/if.h>
+#include <poll.h>
 #include <pthread.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -12,6 +14,7 @@
 
 #include <cstdio>
 #include <cstring>
+#include <thread>
 #include <xbot-service/portable/socket.hpp>
 
 #include "xbot/config.hpp"
@@ -74,7 +77,7 @@ bool get_ip(char* ip, size_t ip_len) {
 
 bool xbot::service::sock::initialize(SocketPtr socket_ptr,
                                      bool bind_multicast) {
-  *socket_ptr = -1;
+  socket_ptr->fd = -1;
   // Create a UDP socket
 
   int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
@@ -128,14 +131,23 @@ bool xbot::service::sock::initialize(SocketPtr socket_ptr,
     }
   }
 
-  // Create a pointer to the fd and return it.
-  *socket_ptr = fd;
+  socket_ptr->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (socket_ptr->wake_fd < 0) {
+    close(fd);
+    return false;
+  }
+
+  socket_ptr->fd = fd;
   return true;
 }
 
 void xbot::service::sock::deinitialize(SocketPtr socket) {
   if (socket != nullptr) {
-    close(*socket);
+    flushPackets(socket);
+    close(socket->fd);
+    close(socket->wake_fd);
+    socket->fd = -1;
+    socket->wake_fd = -1;
   }
 }
 
@@ -144,27 +156,110 @@ bool xbot::service::sock::subscribeMulticast(SocketPtr socket, const char* ip) {
   opt.imr_interface.s_addr = 0;
   opt.imr_multiaddr.s_addr = inet_addr(ip);
 
-  if (setsockopt(*socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &opt, sizeof(opt)) <
+  if (setsockopt(socket->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &opt, sizeof(opt)) <
       0) {
     return false;
   }
   return true;
 }
 
+/**
+ * Flushes the TX batch, if its oldest packet reached the latency bound.
+ * @return time until the batch needs to be flushed, max 1s.
+ */
+static std::chrono::nanoseconds flushIfDue(SocketPtr socket) {
+  std::chrono::nanoseconds remaining = std::chrono::seconds(1);
+  {
+    std::unique_lock lk{socket->tx_mutex};
+    if (socket->tx_count == 0) {
+      return remaining;
+    }
+    remaining = socket->tx_batch_started +
+                std::chrono::microseconds(socket->tx_max_latency_micros) -
+                std::chrono::steady_clock::now();
+  }
+  if (remaining.count() > 0) {
+    return remaining;
+  }
+  flushPackets(socket);
+  return std::chrono::seconds(1);
+}
+
 bool xbot::service::sock::receivePacket(SocketPtr socket, PacketPtr* packet) {
-  const PacketPtr pkt = allocatePacket();
-  sockaddr_in fromAddr{};
-  socklen_t fromLen = sizeof(fromAddr);
-  const ssize_t recvLen =
-      recvfrom(*socket, pkt->buffer, config::max_packet_size, 0,
-               reinterpret_cast<struct sockaddr*>(&fromAddr), &fromLen);
-  if (recvLen < 0) {
-    freePacket(pkt);
-    return false;
+  return receivePackets(socket, packet, 1) == 1;
+}
+
+size_t xbot::service::sock::receivePackets(SocketPtr socket,
+                                           PacketPtr* packets,
+                                           size_t max_packets) {
+  if (max_packets > config::service::io_batch_size) {
+    max_packets = config::service::io_batch_size;
   }
-  pkt->used_data = recvLen;
-  *packet = pkt;
-  return true;
+
+  // Wait for data, but wake up in time to flush pending TX packets.
+  const std::chrono::nanoseconds timeout = flushIfDue(socket);
+  timespec ts{};
+  ts.tv_sec = timeout.count() / 1000000000;
+  ts.tv_nsec = timeout.count() % 1000000000;
+  pollfd fds[2]{{socket->fd, POLLIN, 0}, {socket->wake_fd, POLLIN, 0}};
+  const int ready = ppoll(fds, 2, &ts, nullptr);
+  if (fds[1].revents & POLLIN) {
+    // Someone started a TX batch, just reset the event. The deadline is
+    // checked on the next call.
+    uint64_t value;
+    (void)read(socket->wake_fd, &value, sizeof(value));
+  }
+  flushIfDue(socket);
+  if (ready <= 0 || !(fds[0].revents & POLLIN)) {
+    return 0;
+  }
+
+  // Never block on the pool here: we are the thread which sends the TX batch,
+  // so waiting for a free packet could wait for ourselves. Receive into as
+  // many packets as are available, the rest stays in the socket buffer.
+  size_t allocated = 0;
+  mmsghdr msgs[config::service::io_batch_size]{};
+  iovec iovs[config::service::io_batch_size]{};
+  for (; allocated < max_packets; allocated++) {
+    packets[allocated] = tryAllocatePacket();
+    if (packets[allocated] == nullptr && allocated == 0) {
+      // Free the packets held by the TX batch and try again
+      flushPackets(socket);
+      packets[allocated] = tryAllocatePacket();
+    }
+    if (packets[allocated] == nullptr) {
+      break;
+    }
+    iovs[allocated].iov_base = packets[allocated]->buffer;
+    iovs[allocated].iov_len = config::max_packet_size;
+    msgs[allocated].msg_hdr.msg_iov = &iovs[allocated];
+    msgs[allocated].msg_hdr.msg_iovlen = 1;
+  }
+  if (allocated == 0) {
+    // All packets are queued for the services, give them time to process
+    // some. The data would wake us right away again.
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+    return 0;
+  }
+  max_packets = allocated;
+  int received = recvmmsg(socket->fd, msgs, max_packets, MSG_DONTWAIT, nullptr);
+  if (received < 0) {
+    received = 0;
+  }
+  for (size_t i = 0; i < max_packets; i++) {
+    if (i < static_cast<size_t>(received)) {
+      packets[i]->used_data = msgs[i].msg_len;
+    } else {
+      freePacket(packets[i]);
+      packets[i] = nullptr;
+    }
+  }
+  if (received > 0) {
+    std::unique_lock lk{socket->tx_mutex};
+    socket->stats.rx_calls++;
+    socket->stats.rx_packets += received;
+  }
+  return received;
 }
 
 bool xbot::service::sock::transmitPacket(SocketPtr socket, PacketPtr packet,
@@ -174,14 +269,172 @@ bool xbot::service::sock::transmitPacket(SocketPtr socket, PacketPtr packet,
   addr.sin_port = htons(port);
   addr.sin_addr.s_addr = htonl(ip);
 
-  sendto(*static_cast<int*>(socket), packet->buffer, packet->used_data, 0,
-         reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+  if (socket->tx_max_latency_micros == 0) {
+    const bool success =
+        sendto(socket->fd, packet->buffer, packet->used_data, 0,
+               reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) >= 0;
+    freePacket(packet);
+    std::unique_lock lk{socket->tx_mutex};
+    socket->stats.tx_calls++;
+    if (success) {
+      socket->stats.tx_packets++;
+    }
+    return success;
+  }
 
-  freePacket(packet);
+  bool batch_full;
+  bool batch_started;
+  {
+    std::unique_lock lk{socket->tx_mutex};
+    if (socket->tx_coalesce) {
+      for (size_t i = 0; i < socket->tx_count; i++) {
+        if (socket->tx_addresses[i].sin_addr.s_addr == addr.sin_addr.s_addr &&
+            socket->tx_addresses[i].sin_port == addr.sin_port &&
+            packetAppendData(socket->tx_packets[i], packet->buffer,
+                             packet->used_data)) {
+          // Will be sent as part of the pending datagram
+          freePacket(packet);
+          socket->stats.tx_coalesced++;
+          return true;
+        }
+      }
+    }
+    batch_started = socket->tx_count == 0;
+    if (batch_started) {
+      socket->tx_batch_started = std::chrono::steady_clock::now();
+    }
+    socket->tx_packets[socket->tx_count] = packet;
+    socket->tx_addresses[socket->tx_count] = addr;
+    socket->tx_count++;
+    batch_full = socket->tx_count >= config::service::io_batch_size;
+  }
+  if (batch_full) {
+    // A failure is counted in tx_batch_failures, the packet itself was
+    // accepted
+    flushPackets(socket);
+    return true;
+  }
+  if (batch_started) {
+    // Wake the receiving thread, so that it flushes the batch in time
+    const uint64_t value = 1;
+    (void)write(socket->wake_fd, &value, sizeof(value));
+  }
+  return true;
+}
+
+bool xbot::service::sock::transmitSegments(SocketPtr socket,
+                                           const PacketSegment* segments,
+                                           size_t segment_count, uint32_t ip,
+                                           uint16_t port) {
+  if (segment_count > config::service::max_packet_segments) {
+    return false;
+  }
+  size_t size = 0;
+  for (size_t i = 0; i < segment_count; i++) {
+    size += segments[i].size;
+  }
+  if (size > config::max_packet_size) {
+    return false;
+  }
+
+  if (socket->tx_max_latency_micros > 0 &&
+      size < config::service::scatter_gather_min_size) {
+    // Small packets are cheap to copy, batching them saves a lot more.
+    // Without a free packet, send them right away instead of waiting for one.
+    if (PacketPtr packet = tryAllocatePacket()) {
+      for (size_t i = 0; i < segment_count; i++) {
+        packetAppendData(packet, segments[i].data, segments[i].size);
+      }
+      return transmitPacket(socket, packet, ip, port);
+    }
+  }
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(ip);
 
+  iovec iovs[config::service::max_packet_segments]{};
+  for (size_t i = 0; i < segment_count; i++) {
+    iovs[i].iov_base = const_cast<void*>(segments[i].data);
+    iovs[i].iov_len = segments[i].size;
+  }
+  msghdr msg{};
+  msg.msg_name = &addr;
+  msg.msg_namelen = sizeof(addr);
+  msg.msg_iov = iovs;
+  msg.msg_iovlen = segment_count;
+
+  // Send what is already batched first, so that packets stay in order.
+  flushPackets(socket);
+  const bool success = sendmsg(socket->fd, &msg, 0) >= 0;
+
+  std::unique_lock lk{socket->tx_mutex};
+  socket->stats.tx_calls++;
+  if (success) {
+    socket->stats.tx_packets++;
+    socket->stats.tx_scatter_gather++;
+  }
+  return success;
+}
+
+bool xbot::service::sock::flushPackets(SocketPtr socket) {
+  std::unique_lock lk{socket->tx_mutex};
+  if (socket->tx_count == 0) {
+    return true;
+  }
+  mmsghdr msgs[config::service::io_batch_size]{};
+  iovec iovs[config::service::io_batch_size]{};
+  for (size_t i = 0; i < socket->tx_count; i++) {
+    iovs[i].iov_base = socket->tx_packets[i]->buffer;
+    iovs[i].iov_len = socket->tx_packets[i]->used_data;
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_name = &socket->tx_addresses[i];
+    msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+  }
+  bool success = true;
+  size_t sent = 0;
+  while (sent < socket->tx_count) {
+    // sendmmsg might not send all of them at once
+    const int result =
+        sendmmsg(socket->fd, msgs + sent, socket->tx_count - sent, 0);
+    socket->stats.tx_calls++;
+    if (result <= 0) {
+      // Drop the rest
+      success = false;
+      break;
+    }
+    sent += result;
+  }
+  socket->stats.tx_packets += sent;
+  socket->stats.tx_batch_failures += socket->tx_count - sent;
+  for (size_t i = 0; i < socket->tx_count; i++) {
+    freePacket(socket->tx_packets[i]);
+    socket->tx_packets[i] = nullptr;
+  }
+  socket->tx_count = 0;
+  return success;
+}
+
+bool xbot::service::sock::setTxBatching(SocketPtr socket,
+                                        uint32_t max_latency_micros,
+                                        bool coalesce) {
+  if (max_latency_micros == 0) {
+    // Don't keep anything in the batch
+    flushPackets(socket);
+  }
+  std::unique_lock lk{socket->tx_mutex};
+  socket->tx_max_latency_micros = max_latency_micros;
+  socket->tx_coalesce = coalesce;
   return true;
 }
 
+SocketStats xbot::service::sock::getSocketStats(SocketPtr socket) {
+  std::unique_lock lk{socket->tx_mutex};
+  return socket->stats;
+}
+
 bool xbot::service::sock::transmitPacket(SocketPtr socket, PacketPtr packet,
                                          const char* ip, uint16_t port) {
   return transmitPacket(socket, packet, ntohl(inet_addr(ip)), port);
@@ -194,7 +447,7 @@ bool xbot::service::sock::getEndpoint(SocketPtr socket, char* ip, size_t ip_len,
   sockaddr_in addr{};
   socklen_t addrLen = sizeof(addr);
 
-  if (getsockname(*static_cast<int*>(socket),
+  if (getsockname(socket->fd,
                   reinterpret_cast<sockaddr*>(&addr), &addrLen) < 0)
     return false;
 
@@ -218,8 +471,10 @@ bool xbot::service::sock::getEndpoint(SocketPtr socket, char* ip, size_t ip_len,
 
 bool xbot::service::sock::closeSocket(SocketPtr socket) {
   if (socket == nullptr) return true;
-  if (close(*socket) < 0) {
+  flushPackets(socket);
+  if (close(socket->fd) < 0) {
     return false;
   }
+  socket->fd = -1;
   return true;
 }
@@ -12,6 +12,7 @@
 
 #include <chrono>
 #include <cstdint>
+#include <ctime>
 #include <cstdlib>
 #include <cstring>
 #include <xbot-service/portable/system.hpp>
@@ -112,6 +113,20 @@ uint32_t getTimeMicros() {
       .count();
 }
 
+uint64_t getTimeNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t getThreadCpuTimeMicros() {
+  timespec ts{};
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
 bool getNodeId(uint8_t *id, size_t id_len) {
   if (id_len != sizeof(node_id_)) return false;
   memcpy(id, node_id_, id_len);
@@ -1,18 +1,149 @@
 #include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <ulog.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
 
 #include <xbot-service/portable/thread.hpp>
 
 using namespace xbot::service::thread;
 
+namespace {
+struct ThreadStart {
+  void (*threadfunc)(void*);
+  void* arg;
+  // Linux limits thread names to 15 chars
+  char name[16];
+  int nice;
+};
+
+void* runThread(void* arg) {
+  const auto start = static_cast<ThreadStart*>(arg);
+  const auto threadfunc = start->threadfunc;
+  void* const threadarg = start->arg;
+  if (start->name[0] != 0) {
+    pthread_setname_np(pthread_self(), start->name);
+  }
+  // On Linux, this only applies to the calling thread
+  if (start->nice != 0 && setpriority(PRIO_PROCESS, 0, start->nice) != 0) {
+    ULOG_WARNING("Thread %s: Could not set nice value: %s", start->name,
+                 strerror(errno));
+  }
+  delete start;
+  threadfunc(threadarg);
+  return nullptr;
+}
+
+const char* getName(const ThreadAttributes& attributes) {
+  return attributes.name != nullptr ? attributes.name : "";
+}
+
+// Applies everything except the real-time scheduling.
+bool initAttributes(pthread_attr_t* attr, const ThreadAttributes& attributes) {
+  if (pthread_attr_init(attr) != 0) {
+    return false;
+  }
+  // Nobody joins our threads
+  pthread_attr_setdetachstate(attr, PTHREAD_CREATE_DETACHED);
+  // Smaller stacks are meant for microcontrollers, use the default here
+  const auto min_stack_size = static_cast<size_t>(PTHREAD_STACK_MIN);
+  if (attributes.stack != nullptr && attributes.stack_size >= min_stack_size) {
+    if (pthread_attr_setstack(attr, attributes.stack, attributes.stack_size) !=
+        0) {
+      ULOG_WARNING("Thread %s: Invalid stack buffer, using default stack",
+                   getName(attributes));
+    }
+  } else if (attributes.stack_size >= min_stack_size) {
+    pthread_attr_setstacksize(attr, attributes.stack_size);
+  }
+  if (attributes.cpu_mask != 0) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu = 0; cpu < 64; cpu++) {
+      if (attributes.cpu_mask & (1ULL << cpu)) {
+        CPU_SET(cpu, &cpu_set);
+      }
+    }
+    pthread_attr_setaffinity_np(attr, sizeof(cpu_set), &cpu_set);
+  }
+  return true;
+}
+
+bool setRealtimeAttributes(pthread_attr_t* attr,
+                           const ThreadAttributes& attributes) {
+  const int policy = attributes.policy == SchedulingPolicy::FIFO ? SCHED_FIFO
+                                                                 : SCHED_RR;
+  sched_param param{};
+  param.sched_priority = attributes.priority;
+  return pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED) == 0 &&
+         pthread_attr_setschedpolicy(attr, policy) == 0 &&
+         pthread_attr_setschedparam(attr, &param) == 0;
+}
+}  // namespace
+
+bool xbot::service::thread::initialize(ThreadPtr thread,
+                                       void (*threadfunc)(void*), void* arg,
+                                       const ThreadAttributes& attributes) {
+  if (attributes.lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    ULOG_WARNING("Thread %s: Could not lock memory: %s", getName(attributes),
+                 strerror(errno));
+  }
+
+  const auto start = new ThreadStart{threadfunc, arg, {}, 0};
+  strncpy(start->name, getName(attributes), sizeof(start->name) - 1);
+  if (attributes.policy == SchedulingPolicy::DEFAULT) {
+    start->nice = attributes.nice;
+  }
+
+  pthread_attr_t attr;
+  if (!initAttributes(&attr, attributes)) {
+    delete start;
+    return false;
+  }
+  int result = EPERM;
+  if (attributes.policy != SchedulingPolicy::DEFAULT &&
+      setRealtimeAttributes(&attr, attributes)) {
+    result = pthread_create(thread, &attr, runThread, start);
+  }
+  if (result != 0) {
+    if (attributes.policy != SchedulingPolicy::DEFAULT) {
+      // Usually missing CAP_SYS_NICE, still run the thread but without
+      // real-time guarantees.
+      ULOG_WARNING(
+          "Thread %s: Could not set real-time priority, using default "
+          "scheduling",
+          getName(attributes));
+    }
+    pthread_attr_destroy(&attr);
+    initAttributes(&attr, attributes);
+    result = pthread_create(thread, &attr, runThread, start);
+  }
+  pthread_attr_destroy(&attr);
+  if (result != 0) {
+    delete start;
+    return false;
+  }
+  return true;
+}
+
 bool xbot::service::thread::initialize(ThreadPtr thread,
                                        void (*threadfunc)(void*), void* arg,
                                        void* stackbuf, size_t buflen,
                                        const char* name) {
-  (void)stackbuf;
-  (void)buflen;
-  (void)name;
-  *thread = new std::thread(threadfunc, arg);
-  return true;
+  ThreadAttributes attributes{};
+  attributes.name = name;
+  attributes.stack = stackbuf;
+  attributes.stack_size = buflen;
+  return initialize(thread, threadfunc, arg, attributes);
 }
 
 void xbot::service::thread::deinitialize(ThreadPtr thread) { (void)thread; }
+
+void xbot::service::thread::sleepMicros(uint32_t micros) {
+  std::this_thread::sleep_for(std::chrono::microseconds(micros));
+}
@@ -0,0 +1,48 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot-service/ChangeDetector.hpp>
+
+#include "CppUTest/TestHarness.h"
+
+using namespace xbot::service;
+
+TEST_GROUP(ChangeDetectorTests){
+
+};
+
+TEST(ChangeDetectorTests, SendsOnlyChanges) {
+  ChangeDetector<sizeof(uint32_t)> detector{};
+  uint32_t value = 42;
+  CHECK_TRUE(detector.needsSend(&value, sizeof(value), 0, 0));
+  detector.markSent(&value, sizeof(value), 0);
+  CHECK_FALSE(detector.needsSend(&value, sizeof(value), 1000, 0));
+  value = 43;
+  CHECK_TRUE(detector.needsSend(&value, sizeof(value), 2000, 0));
+}
+
+TEST(ChangeDetectorTests, SendsKeyframes) {
+  ChangeDetector<sizeof(float)> detector{};
+  const float value = 1.5f;
+  const uint32_t start = UINT32_MAX - 100;
+  detector.markSent(&value, sizeof(value), start);
+  CHECK_FALSE(detector.needsSend(&value, sizeof(value), start + 999, 1000));
+  CHECK_TRUE(detector.needsSend(&value, sizeof(value), start + 1000, 1000));
+}
+
+TEST(ChangeDetectorTests, ComparesArrayLength) {
+  ChangeDetector<8> detector{};
+  const char text[] = "abcd";
+  detector.markSent(text, 4, 0);
+  CHECK_FALSE(detector.needsSend(text, 4, 0, 0));
+  CHECK_TRUE(detector.needsSend(text, 3, 0, 0));
+}
+
+TEST(ChangeDetectorTests, InvalidateForcesSend) {
+  ChangeDetector<sizeof(uint8_t)> detector{};
+  const uint8_t value = 1;
+  detector.markSent(&value, sizeof(value), 0);
+  detector.invalidate();
+  CHECK_TRUE(detector.needsSend(&value, sizeof(value), 0, 0));
+}
@@ -0,0 +1,96 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot-service/ClockSync.hpp>
+
+#include "CppUTest/TestHarness.h"
+
+using namespace xbot::service;
+
+namespace {
+constexpr uint64_t SECOND = 1000000000ULL;
+
+/**
+ * Simulates an exchange with a reference clock which is ahead by offset and
+ * runs faster by drift.
+ */
+void exchange(ClockSync &sync, uint64_t local_start, int64_t offset, double drift, uint64_t delay_to,
+              uint64_t delay_back) {
+  const auto to_reference = [&](uint64_t local) {
+    return local + offset + static_cast<int64_t>(static_cast<double>(local) * drift);
+  };
+  const uint64_t processing = 1000;
+  sync.addSample(local_start, to_reference(local_start + delay_to),
+                 to_reference(local_start + delay_to + processing),
+                 local_start + delay_to + processing + delay_back);
+}
+}  // namespace
+
+TEST_GROUP(ClockSyncTests){
+
+};
+
+TEST(ClockSyncTests, NotSynchronizedWithoutSamples) {
+  ClockSync sync{};
+  CHECK_FALSE(sync.isSynchronized());
+  CHECK_EQUAL(1234, sync.toReference(1234));
+}
+
+TEST(ClockSyncTests, EstimatesOffset) {
+  ClockSync sync{};
+  const int64_t offset = 1700000000LL * SECOND;
+  for (uint32_t i = 0; i < xbot::config::time_sync_min_samples; i++) {
+    exchange(sync, SECOND + i * SECOND / 10, offset, 0, 50000, 50000);
+  }
+  CHECK_TRUE(sync.isSynchronized());
+  CHECK_EQUAL(offset, sync.getOffsetNanos());
+  CHECK_EQUAL(100000, sync.getRoundTripNanos());
+  CHECK_EQUAL(10 * SECOND + offset, sync.toReference(10 * SECOND));
+}
+
+TEST(ClockSyncTests, PrefersShortestRoundTrip) {
+  ClockSync sync{};
+  const int64_t offset = 5 * SECOND;
+  // Asymmetric queuing delays would skew the offset by half their difference
+  exchange(sync, SECOND, offset, 0, 2000000, 10000);
+  exchange(sync, 2 * SECOND, offset, 0, 10000, 10000);
+  exchange(sync, 3 * SECOND, offset, 0, 10000, 3000000);
+  exchange(sync, 4 * SECOND, offset, 0, 500000, 10000);
+  CHECK_TRUE(sync.isSynchronized());
+  CHECK_EQUAL(offset, sync.getOffsetNanos());
+}
+
+TEST(ClockSyncTests, EstimatesDrift) {
+  ClockSync sync{};
+  // Reference runs 50 ppm faster
+  const double drift = 50e-6;
+  for (uint64_t t = 0; t <= 60; t++) {
+    exchange(sync, (t + 1) * SECOND, SECOND, drift, 20000, 20000);
+  }
+  DOUBLES_EQUAL(drift, sync.getDrift(), 1e-6);
+  // Extrapolate 10 seconds, which should be accurate to a few micros
+  const uint64_t local = 71 * SECOND;
+  const uint64_t expected = local + SECOND + static_cast<uint64_t>(local * drift);
+  const int64_t error = static_cast<int64_t>(sync.toReference(local) - expected);
+  CHECK_TRUE(error < 10000 && error > -10000);
+}
+
+TEST(ClockSyncTests, IgnoresBrokenExchanges) {
+  ClockSync sync{};
+  // Response received before the request was sent
+  sync.addSample(1000, 5000, 6000, 500);
+  CHECK_FALSE(sync.isSynchronized());
+  CHECK_EQUAL(0, sync.getRoundTripNanos());
+}
+
+TEST(ClockSyncTests, ResetForgetsEstimate) {
+  ClockSync sync{};
+  for (uint32_t i = 0; i < xbot::config::time_sync_min_samples; i++) {
+    exchange(sync, SECOND + i * SECOND, SECOND, 0, 1000, 1000);
+  }
+  CHECK_TRUE(sync.isSynchronized());
+  sync.reset();
+  CHECK_FALSE(sync.isSynchronized());
+  CHECK_EQUAL(42, sync.toReference(42));
+}
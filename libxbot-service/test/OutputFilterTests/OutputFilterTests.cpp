@@ -0,0 +1,93 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot-service/OutputFilter.hpp>
+
+#include "CppUTest/TestHarness.h"
+
+using namespace xbot::service;
+using xbot::datatypes::OutputPolicyMode;
+
+TEST_GROUP(OutputFilterTests){
+
+};
+
+TEST(OutputFilterTests, FullRateByDefault) {
+  OutputFilter filter{};
+  float value = 1.5f;
+  for (uint32_t i = 0; i < 10; i++) {
+    CHECK_TRUE(filter.filter(&value, i));
+  }
+  DOUBLES_EQUAL(1.5, value, 0);
+}
+
+TEST(OutputFilterTests, EveryNth) {
+  OutputFilter filter{};
+  filter.setPolicy(OutputPolicyMode::EVERY_NTH, 3);
+  uint32_t sent = 0;
+  for (uint32_t i = 0; i < 9; i++) {
+    uint32_t value = i;
+    if (filter.filter(&value, 0)) {
+      CHECK_EQUAL(0, i % 3);
+      sent++;
+    }
+  }
+  CHECK_EQUAL(3, sent);
+}
+
+TEST(OutputFilterTests, MaxRate) {
+  OutputFilter filter{};
+  filter.setPolicy(OutputPolicyMode::MAX_RATE, 100000);
+  // 1 kHz for one second, close to the wrap around
+  const uint32_t start = UINT32_MAX - 500000;
+  uint32_t sent = 0;
+  for (uint32_t i = 0; i < 1000; i++) {
+    if (filter.accept(start + i * 1000)) {
+      sent++;
+    }
+  }
+  CHECK_EQUAL(10, sent);
+}
+
+TEST(OutputFilterTests, WindowAggregates) {
+  OutputFilter min_filter{}, max_filter{}, mean_filter{};
+  min_filter.setPolicy(OutputPolicyMode::WINDOW_MIN, 1000);
+  max_filter.setPolicy(OutputPolicyMode::WINDOW_MAX, 1000);
+  mean_filter.setPolicy(OutputPolicyMode::WINDOW_MEAN, 1000);
+  const int16_t samples[] = {4, -2, 7, 3};
+  for (uint32_t i = 0; i < 4; i++) {
+    int16_t min = samples[i], max = samples[i], mean = samples[i];
+    const bool last = i == 3;
+    CHECK_EQUAL(last, min_filter.filter(&min, i * 334));
+    CHECK_EQUAL(last, max_filter.filter(&max, i * 334));
+    CHECK_EQUAL(last, mean_filter.filter(&mean, i * 334));
+    if (last) {
+      CHECK_EQUAL(-2, min);
+      CHECK_EQUAL(7, max);
+      // 12 / 4
+      CHECK_EQUAL(3, mean);
+    }
+  }
+  // The next window starts with the next sample
+  float value = 10;
+  CHECK_FALSE(mean_filter.filter(&value, 2000));
+}
+
+TEST(OutputFilterTests, WindowLimitsRateOfArrays) {
+  OutputFilter filter{};
+  filter.setPolicy(OutputPolicyMode::WINDOW_MEAN, 1000);
+  CHECK_TRUE(filter.accept(0));
+  CHECK_FALSE(filter.accept(999));
+  CHECK_TRUE(filter.accept(1000));
+}
+
+TEST(OutputFilterTests, ResetToFullRate) {
+  OutputFilter filter{};
+  filter.setPolicy(OutputPolicyMode::EVERY_NTH, 100);
+  CHECK_TRUE(filter.accept(0));
+  CHECK_FALSE(filter.accept(0));
+  filter.reset();
+  CHECK_TRUE(filter.accept(0));
+  CHECK_TRUE(filter.accept(0));
+}
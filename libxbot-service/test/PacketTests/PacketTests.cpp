@@ -0,0 +1,74 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot-service/portable/packet.hpp>
+
+#include "CppUTest/TestHarness.h"
+
+using namespace xbot::service::packet;
+
+TEST_GROUP(PacketTests){
+
+};
+
+TEST(PacketTests, AllocateIsEmpty) {
+  PacketPtr packet = allocatePacket();
+  CHECK_TRUE(packet != nullptr);
+  void* buffer = nullptr;
+  size_t size = 42;
+  CHECK_TRUE(packetGetData(packet, &buffer, &size));
+  CHECK_EQUAL(0, size);
+  freePacket(packet);
+}
+
+TEST(PacketTests, AppendData) {
+  PacketPtr packet = allocatePacket();
+  uint8_t data[xbot::config::max_packet_size]{};
+  CHECK_TRUE(packetAppendData(packet, data, 100));
+  CHECK_TRUE(packetAppendData(packet, data, xbot::config::max_packet_size - 100));
+  CHECK_FALSE(packetAppendData(packet, data, 1));
+  freePacket(packet);
+}
+
+TEST(PacketTests, PoolReusesPackets) {
+  const PacketPoolStats before = getPacketPoolStats();
+  PacketPtr packets[xbot::config::service::packet_pool_size];
+  for (auto& packet : packets) {
+    packet = allocatePacket();
+    CHECK_TRUE(packet != nullptr);
+  }
+  CHECK_EQUAL(before.in_use + xbot::config::service::packet_pool_size, getPacketPoolStats().in_use);
+  for (auto& packet : packets) {
+    freePacket(packet);
+  }
+  // All packets are back in the pool, allocating again must not run into exhaustion.
+  for (auto& packet : packets) {
+    packet = allocatePacket();
+  }
+  for (auto& packet : packets) {
+    freePacket(packet);
+  }
+  const PacketPoolStats after = getPacketPoolStats();
+  CHECK_EQUAL(before.in_use, after.in_use);
+  CHECK_EQUAL(before.exhausted_count, after.exhausted_count);
+  CHECK_EQUAL(xbot::config::service::packet_pool_size, after.high_water_mark);
+}
+
+TEST(PacketTests, TryAllocateDoesNotBlock) {
+  PacketPtr packets[xbot::config::service::packet_pool_size];
+  size_t allocated = 0;
+  for (auto& packet : packets) {
+    packet = tryAllocatePacket();
+    if (packet == nullptr) break;
+    allocated++;
+  }
+  // Other tests might still hold packets, but the pool has to run empty.
+  CHECK_TRUE(tryAllocatePacket() == nullptr);
+  for (size_t i = 0; i < allocated; i++) {
+    freePacket(packets[i]);
+  }
+  PacketPtr packet = tryAllocatePacket();
+  CHECK_TRUE(packet != nullptr);
+  freePacket(packet);
+}
@@ -2,58 +2,129 @@
 // Created by clemens on 3/22/24.
 //
 
-#include <portable/queue.hpp>
+#include <thread>
+#include <xbot-service/portable/queue.hpp>
 
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/TestHarness_c.h"
 
-using namespace xbot::service;
+using namespace xbot::service::queue;
 
 TEST_GROUP(QueueTests){
 
 };
 
 TEST(QueueTests, LeakTest) {
-  QueuePtr queue = createQueue(10);
-  destroyQueue(queue);
-  // STRCMP_EQUAL("yo", "yo");
+  XBOT_QUEUE_TYPEDEF queue{};
+  void* buffer[10];
+  CHECK_TRUE(initialize(&queue, 10, buffer, sizeof(buffer)));
+  deinitialize(&queue);
 }
 
 TEST(QueueTests, CapacityTest) {
-  QueuePtr queue = createQueue(100);
+  XBOT_QUEUE_TYPEDEF queue{};
+  void* buffer[100];
+  initialize(&queue, 100, buffer, sizeof(buffer));
   uint32_t items[100];
   for (int i = 0; i < 100; i++) {
     items[i] = i;
   }
 
   for (int i = 0; i < 100; i++) {
-    CHECK_TRUE(queuePushItem(queue, items + i));
+    CHECK_TRUE(queuePushItem(&queue, items + i));
   }
-  CHECK_FALSE(queuePushItem(queue, items));
-  destroyQueue(queue);
+  CHECK_FALSE(queuePushItem(&queue, items));
+  deinitialize(&queue);
 }
 
 TEST(QueueTests, CorrectOrder) {
-  QueuePtr queue = createQueue(100);
+  XBOT_QUEUE_TYPEDEF queue{};
+  void* buffer[100];
+  initialize(&queue, 100, buffer, sizeof(buffer));
   uint32_t items[100];
   for (int i = 0; i < 100; i++) {
     items[i] = i;
-    queuePushItem(queue, items + i);
+    queuePushItem(&queue, items + i);
   }
 
   for (int i = 0; i < 100; i++) {
     void* result;
-    CHECK_TRUE(queuePopItem(queue, &result, 0));
+    CHECK_TRUE(queuePopItem(&queue, &result, 0));
     CHECK_TRUE(result != nullptr);
     CHECK_EQUAL_C_POINTER(items + i, result);
   }
-  destroyQueue(queue);
+  deinitialize(&queue);
 }
 
 TEST(QueueTests, PopEmptyQueue) {
-  QueuePtr queue = createQueue(100);
+  XBOT_QUEUE_TYPEDEF queue{};
+  void* buffer[100];
+  initialize(&queue, 100, buffer, sizeof(buffer));
   void* dummy;
-  CHECK_FALSE(queuePopItem(queue, &dummy, 0));
-  CHECK_FALSE(queuePopItem(queue, &dummy, 10));
-  destroyQueue(queue);
+  CHECK_FALSE(queuePopItem(&queue, &dummy, 0));
+  CHECK_FALSE(queuePopItem(&queue, &dummy, 10));
+  deinitialize(&queue);
+}
+
+TEST(QueueTests, WrapAround) {
+  XBOT_QUEUE_TYPEDEF queue{};
+  void* buffer[3];
+  initialize(&queue, 3, buffer, sizeof(buffer));
+  uint32_t items[10];
+  for (int i = 0; i < 10; i++) {
+    void* result;
+    CHECK_TRUE(queuePushItem(&queue, items + i));
+    CHECK_TRUE(queuePopItem(&queue, &result, 0));
+    CHECK_EQUAL_C_POINTER(items + i, result);
+  }
+  deinitialize(&queue);
+}
+
+TEST(QueueTests, PopWakesOnPush) {
+  XBOT_QUEUE_TYPEDEF queue{};
+  void* buffer[10];
+  initialize(&queue, 10, buffer, sizeof(buffer));
+  uint32_t item = 42;
+  std::thread producer{[&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queuePushItem(&queue, &item);
+  }};
+  void* result = nullptr;
+  // Timeout is way longer than the producer's delay
+  CHECK_TRUE(queuePopItem(&queue, &result, 5000000));
+  CHECK_EQUAL_C_POINTER(&item, result);
+  producer.join();
+  deinitialize(&queue);
+}
+
+TEST(QueueTests, ConcurrentProducers) {
+  XBOT_QUEUE_TYPEDEF queue{};
+  void* buffer[8];
+  initialize(&queue, 8, buffer, sizeof(buffer));
+  static constexpr int items_per_producer = 10000;
+  uint32_t items[2][items_per_producer];
+  auto produce = [&](int producer) {
+    for (int i = 0; i < items_per_producer; i++) {
+      items[producer][i] = i;
+      while (!queuePushItem(&queue, &items[producer][i])) {
+        std::this_thread::yield();
+      }
+    }
+  };
+  std::thread p1{produce, 0};
+  std::thread p2{produce, 1};
+
+  // Items of each producer need to arrive in order
+  uint32_t expected[2]{0, 0};
+  for (int i = 0; i < 2 * items_per_producer; i++) {
+    void* result = nullptr;
+    CHECK_TRUE(queuePopItem(&queue, &result, 1000000));
+    const auto item = static_cast<uint32_t*>(result);
+    const int producer = (item >= items[0] && item < items[0] + items_per_producer) ? 0 : 1;
+    CHECK_EQUAL(expected[producer], *item);
+    expected[producer]++;
+  }
+  p1.join();
+  p2.join();
+  deinitialize(&queue);
 }
@@ -0,0 +1,111 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot-service/ReliableSender.hpp>
+
+#include "CppUTest/TestHarness.h"
+
+using namespace xbot::service;
+
+namespace {
+struct Retransmissions {
+  size_t count = 0;
+  uint8_t last_first_byte = 0;
+};
+
+void recordRetransmit(packet::PacketPtr packet, void *arg) {
+  auto retransmissions = static_cast<Retransmissions *>(arg);
+  void *buffer = nullptr;
+  size_t size = 0;
+  packet::packetGetData(packet, &buffer, &size);
+  retransmissions->count++;
+  retransmissions->last_first_byte = static_cast<uint8_t *>(buffer)[0];
+}
+
+packet::PacketPtr makePacket(uint8_t content) {
+  packet::PacketPtr packet = packet::allocatePacket();
+  packet::packetAppendData(packet, &content, 1);
+  return packet;
+}
+}  // namespace
+
+TEST_GROUP(ReliableSenderTests){
+
+};
+
+TEST(ReliableSenderTests, NothingInFlight) {
+  ReliableSender sender{};
+  Retransmissions retransmissions{};
+  CHECK_EQUAL(ReliableSender::NOTHING_IN_FLIGHT, sender.poll(0, recordRetransmit, &retransmissions));
+  CHECK_FALSE(sender.acknowledge(1, 0));
+}
+
+TEST(ReliableSenderTests, AcknowledgedPacketIsNotRetransmitted) {
+  ReliableSender sender{};
+  Retransmissions retransmissions{};
+  CHECK_TRUE(sender.track(5, makePacket(42), 1000));
+  CHECK_EQUAL(xbot::config::reliable_initial_timeout_micros, sender.poll(1000, recordRetransmit, &retransmissions));
+  CHECK_TRUE(sender.acknowledge(5, 3000));
+  CHECK_EQUAL(0, sender.getInFlight());
+  CHECK_EQUAL(2000, sender.getRttMicros());
+  CHECK_FALSE(sender.acknowledge(5, 3000));
+  CHECK_EQUAL(ReliableSender::NOTHING_IN_FLIGHT, sender.poll(1000000, recordRetransmit, &retransmissions));
+  CHECK_EQUAL(0, retransmissions.count);
+}
+
+TEST(ReliableSenderTests, RetransmitsWithBackoff) {
+  ReliableSender sender{};
+  Retransmissions retransmissions{};
+  const uint32_t timeout = xbot::config::reliable_initial_timeout_micros;
+  sender.track(1, makePacket(42), 0);
+  CHECK_EQUAL(1, sender.poll(timeout - 1, recordRetransmit, &retransmissions));
+  CHECK_EQUAL(0, retransmissions.count);
+  CHECK_EQUAL(2 * timeout, sender.poll(timeout, recordRetransmit, &retransmissions));
+  CHECK_EQUAL(1, retransmissions.count);
+  CHECK_EQUAL(42, retransmissions.last_first_byte);
+  CHECK_EQUAL(1, sender.getRetransmits());
+  // The round trip of a retransmitted packet is ambiguous
+  sender.acknowledge(1, timeout + 10);
+  CHECK_EQUAL(0, sender.getRttMicros());
+}
+
+TEST(ReliableSenderTests, GivesUpAfterMaxRetransmits) {
+  ReliableSender sender{};
+  Retransmissions retransmissions{};
+  sender.track(1, makePacket(1), 0);
+  uint32_t now = 0;
+  while (sender.getInFlight() > 0) {
+    now += xbot::config::reliable_max_timeout_micros;
+    sender.poll(now, recordRetransmit, &retransmissions);
+  }
+  CHECK_EQUAL(xbot::config::reliable_max_retransmits, retransmissions.count);
+  CHECK_EQUAL(1, sender.getFailures());
+}
+
+TEST(ReliableSenderTests, LimitsPacketsInFlight) {
+  ReliableSender sender{};
+  for (uint16_t i = 0; i < xbot::config::service::reliable_max_in_flight; i++) {
+    CHECK_TRUE(sender.track(i, makePacket(i), 0));
+  }
+  CHECK_FALSE(sender.track(100, makePacket(100), 0));
+  CHECK_EQUAL(1, sender.getFailures());
+  // Acknowledge out of order
+  CHECK_TRUE(sender.acknowledge(0, 10));
+  CHECK_TRUE(sender.acknowledge(3, 10));
+  CHECK_EQUAL(xbot::config::service::reliable_max_in_flight - 2, sender.getInFlight());
+  sender.reset();
+  CHECK_EQUAL(0, sender.getInFlight());
+}
+
+TEST(ReliableSenderTests, TimeoutFollowsRoundTrip) {
+  xbot::RttEstimator rtt{};
+  for (int i = 0; i < 20; i++) {
+    rtt.addSample(10000);
+  }
+  CHECK_EQUAL(10000, rtt.getRttMicros());
+  CHECK_TRUE(rtt.getTimeoutMicros() >= 10000 && rtt.getTimeoutMicros() < 12000);
+  CHECK_EQUAL(xbot::config::reliable_max_timeout_micros, rtt.getTimeoutMicros(30));
+  rtt.addSample(0);
+  CHECK_TRUE(rtt.getTimeoutMicros() >= xbot::config::reliable_min_timeout_micros);
+}
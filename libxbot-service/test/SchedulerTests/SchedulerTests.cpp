@@ -0,0 +1,121 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot-service/Scheduler.hpp>
+
+#include "CppUTest/TestHarness.h"
+
+using namespace xbot::service;
+
+namespace {
+void countCall(void* arg) { (*static_cast<int*>(arg))++; }
+}  // namespace
+
+TEST_GROUP(SchedulerTests){
+
+};
+
+TEST(SchedulerTests, EmptySchedulerIsIdle) {
+  Scheduler scheduler{};
+  CHECK_EQUAL(Scheduler::NO_TASK_DUE, scheduler.run(1000));
+}
+
+TEST(SchedulerTests, DisabledTaskDoesNotRun) {
+  Scheduler scheduler{};
+  int calls = 0;
+  const int task = scheduler.addTask(countCall, &calls);
+  CHECK_TRUE(task != Scheduler::INVALID_TASK);
+  CHECK_EQUAL(Scheduler::NO_TASK_DUE, scheduler.run(1000));
+  CHECK_EQUAL(0, calls);
+}
+
+TEST(SchedulerTests, RunsDueTasksAndReturnsSleepTime) {
+  Scheduler scheduler{};
+  int fast_calls = 0;
+  int slow_calls = 0;
+  const int fast = scheduler.addTask(countCall, &fast_calls);
+  const int slow = scheduler.addTask(countCall, &slow_calls);
+  scheduler.setInterval(slow, 1000, 1000);
+  scheduler.setInterval(fast, 100, 100);
+
+  CHECK_EQUAL(100, scheduler.run(0));
+  CHECK_EQUAL(100, scheduler.run(100));
+  CHECK_EQUAL(1, fast_calls);
+  CHECK_EQUAL(0, slow_calls);
+
+  // Both are due at 1000, fast is due again at 1100
+  CHECK_EQUAL(100, scheduler.run(1000));
+  CHECK_EQUAL(2, fast_calls);
+  CHECK_EQUAL(1, slow_calls);
+}
+
+TEST(SchedulerTests, KeepsPhaseWhenSlightlyLate) {
+  Scheduler scheduler{};
+  int calls = 0;
+  const int task = scheduler.addTask(countCall, &calls);
+  scheduler.setInterval(task, 100, 100);
+  CHECK_EQUAL(90, scheduler.run(110));
+  CHECK_EQUAL(0, scheduler.getOverruns(task));
+}
+
+TEST(SchedulerTests, CountsOverruns) {
+  Scheduler scheduler{};
+  int calls = 0;
+  const int task = scheduler.addTask(countCall, &calls);
+  scheduler.setInterval(task, 100, 100);
+  // More than a whole interval late, only run once and start over from now
+  CHECK_EQUAL(100, scheduler.run(350));
+  CHECK_EQUAL(1, calls);
+  CHECK_EQUAL(1, scheduler.getOverruns(task));
+}
+
+TEST(SchedulerTests, HandlesTimerWrapAround) {
+  Scheduler scheduler{};
+  int calls = 0;
+  const int task = scheduler.addTask(countCall, &calls);
+  scheduler.setInterval(task, 100, UINT32_MAX - 49);
+  CHECK_EQUAL(50, scheduler.run(UINT32_MAX - 99));
+  CHECK_EQUAL(0, calls);
+  CHECK_EQUAL(100, scheduler.run(UINT32_MAX - 49));
+  CHECK_EQUAL(1, calls);
+  // Due again at 50 after the timer wrapped
+  CHECK_EQUAL(100, scheduler.run(50));
+  CHECK_EQUAL(2, calls);
+  CHECK_EQUAL(0, scheduler.getOverruns(task));
+}
+
+TEST(SchedulerTests, DisableAndReschedule) {
+  Scheduler scheduler{};
+  int calls_a = 0;
+  int calls_b = 0;
+  int calls_c = 0;
+  const int a = scheduler.addTask(countCall, &calls_a);
+  const int b = scheduler.addTask(countCall, &calls_b);
+  const int c = scheduler.addTask(countCall, &calls_c);
+  scheduler.setInterval(a, 100, 100);
+  scheduler.setInterval(b, 200, 200);
+  scheduler.setInterval(c, 300, 300);
+
+  // Removing the first task makes the next one due first
+  scheduler.setInterval(a, 0, 0);
+  CHECK_EQUAL(200, scheduler.getMicrosUntilNextTask(0));
+
+  // Moving a task to the front
+  scheduler.setInterval(c, 300, 50);
+  CHECK_EQUAL(50, scheduler.getMicrosUntilNextTask(0));
+  scheduler.run(50);
+  CHECK_EQUAL(0, calls_a);
+  CHECK_EQUAL(0, calls_b);
+  CHECK_EQUAL(1, calls_c);
+}
+
+TEST(SchedulerTests, RejectsTooManyTasks) {
+  Scheduler scheduler{};
+  int calls = 0;
+  for (uint32_t i = 0; i < xbot::config::service::max_scheduled_tasks; i++) {
+    CHECK_TRUE(scheduler.addTask(countCall, &calls) != Scheduler::INVALID_TASK);
+  }
+  CHECK_EQUAL(Scheduler::INVALID_TASK, scheduler.addTask(countCall, &calls));
+  CHECK_FALSE(scheduler.setInterval(Scheduler::INVALID_TASK, 100, 0));
+}
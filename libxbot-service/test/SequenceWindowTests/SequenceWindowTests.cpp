@@ -0,0 +1,49 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot/SequenceWindow.hpp>
+
+#include "CppUTest/TestHarness.h"
+
+using namespace xbot;
+
+TEST_GROUP(SequenceWindowTests){
+
+};
+
+TEST(SequenceWindowTests, DropsDuplicates) {
+  SequenceWindow window{};
+  CHECK_TRUE(window.accept(65530));
+  CHECK_TRUE(window.accept(65532));
+  CHECK_FALSE(window.accept(65532));
+  // Reordered, but not seen before
+  CHECK_TRUE(window.accept(65531));
+  CHECK_FALSE(window.accept(65530));
+  // Roll over
+  CHECK_TRUE(window.accept(2));
+  CHECK_FALSE(window.accept(65531));
+  CHECK_TRUE(window.accept(65535));
+  // Too old to tell
+  CHECK_TRUE(window.accept(200));
+  CHECK_FALSE(window.accept(100));
+  window.reset();
+  CHECK_TRUE(window.accept(100));
+}
+
+TEST(SequenceWindowTests, ClassifiesArrivals) {
+  using Arrival = SequenceWindow::Arrival;
+  SequenceWindow window{};
+  uint16_t skipped = 42;
+  CHECK_TRUE(window.receive(10, &skipped) == Arrival::IN_ORDER);
+  CHECK_EQUAL(0, skipped);
+  CHECK_TRUE(window.receive(14, &skipped) == Arrival::IN_ORDER);
+  CHECK_EQUAL(3, skipped);
+  CHECK_TRUE(window.receive(12, &skipped) == Arrival::LATE);
+  CHECK_EQUAL(0, skipped);
+  CHECK_TRUE(window.receive(12) == Arrival::DUPLICATE);
+  CHECK_TRUE(window.receive(14) == Arrival::DUPLICATE);
+  CHECK_TRUE(window.receive(200, &skipped) == Arrival::IN_ORDER);
+  CHECK_EQUAL(185, skipped);
+  CHECK_TRUE(window.receive(13) == Arrival::TOO_OLD);
+}
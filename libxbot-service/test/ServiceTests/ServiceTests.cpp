@@ -0,0 +1,74 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include <xbot-service/Service.hpp>
+#include <xbot-service/portable/thread.hpp>
+
+#include <atomic>
+
+#include "CppUTest/TestHarness.h"
+
+using namespace xbot::service;
+
+namespace {
+/**
+ * Service without any outputs, which starts running right away.
+ */
+class IdleService : public Service {
+ public:
+  IdleService() : Service(4242, 1000, nullptr, 0) { SetOutputCoalescing(true); }
+
+  std::atomic<uint32_t> ticks{0};
+  std::atomic<uint16_t> first_sequence_no{0};
+  std::atomic<uint16_t> last_sequence_no{0};
+
+ protected:
+  bool Configure() override { return true; }
+  void OnStart() override {}
+  void OnCreate() override {}
+  void OnStop() override {}
+  const char *GetName() override { return "IdleService"; }
+
+  void tick() override {
+    // Called with the state mutex held, so we can look at the header.
+    if (ticks == 0) {
+      first_sequence_no = header_.sequence_no;
+    }
+    last_sequence_no = header_.sequence_no;
+    ticks++;
+  }
+
+  bool advertiseService() override { return true; }
+  bool sendServiceDescription() override { return true; }
+  bool isConfigured() override { return true; }
+  void clearConfiguration() override {}
+  bool handleData(uint16_t, const void *, size_t) override { return true; }
+  bool setRegister(uint16_t, const void *, size_t) override { return true; }
+  bool stageRegister(uint16_t, const void *, size_t) override { return true; }
+  bool commitStagedRegisters() override { return true; }
+  void discardStagedRegisters() override {}
+  void clearOutputPolicies() override {}
+  bool setOutputPolicy(const xbot::datatypes::OutputPolicy &) override { return true; }
+  void invalidateSentOutputs() override {}
+};
+}  // namespace
+
+TEST_GROUP(ServiceTests){
+
+};
+
+TEST(ServiceTests, IdleTickDoesNotUseSequenceNumbers) {
+  IdleService service{};
+  CHECK_TRUE(service.start());
+  for (int i = 0; i < 1000 && service.ticks < 10; i++) {
+    thread::sleepMicros(1000);
+  }
+  service.stopped = true;
+  // Let the processing thread see it before the service is destroyed
+  thread::sleepMicros(50000);
+
+  CHECK_TRUE(service.ticks >= 10);
+  // The coalesced transaction of a tick without outputs is never sent
+  CHECK_EQUAL(service.first_sequence_no.load(), service.last_sequence_no.load());
+}
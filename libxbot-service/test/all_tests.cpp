@@ -4,5 +4,11 @@
 #include "CppUTest/CommandLineTestRunner.h"
 
 IMPORT_TEST_GROUP(QueueTests);
+IMPORT_TEST_GROUP(PacketTests);
+IMPORT_TEST_GROUP(SchedulerTests);
+IMPORT_TEST_GROUP(ClockSyncTests);
+IMPORT_TEST_GROUP(OutputFilterTests);
+IMPORT_TEST_GROUP(ChangeDetectorTests);
+IMPORT_TEST_GROUP(ReliableSenderTests);
 
 int main(int argc, char** argv) { return RUN_ALL_TESTS(argc, argv); }